@@ -0,0 +1,236 @@
+/*
+Native benchmarks for the real-valued inverse (inverse_real_valued.cpp).
+
+1) Compares the blocked LU/inverse built on the gemm_kernels.h microkernels against the
+   plain unblocked algorithm (block size = n), and reports GFLOP/s for both. An LU-based
+   inverse is counted as 2n^3 floating point operations.
+2) Reports matrices/second for matrix_inverse_batch() on 2x2 to 8x8 matrices, against
+   calling matrix_inverse() once per matrix.
+3) Reports matrices/second for the generated closed-form kernels in closed_form_kernels/
+   (inverse_2x2() to inverse_6x6()), against the general invert() path.
+4) Times the structure-aware paths of matrix_inverse() (Cholesky, banded, triangular,
+   sparse) against the dense LU on the same matrices.
+5) Times the mixed-precision inverse against the double-precision LU, with the
+   residual |A X - I| each reaches.
+
+Build (natively, not with emcc):
+
+    g++ -O2 -pthread benchmark.cpp -o benchmark
+
+Usage: ./benchmark [largest dimension, default 2000]
+
+Author: Evan Lauer
+*/
+
+#define MATRIX_INVERSE_NO_MAIN
+#include "inverse_real_valued.cpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+#include "closed_form_kernels/inverse_kernels.h"
+
+/**
+ * @brief Returns `count` random doubles in [-1, 1].
+ *
+ * @param count size_t
+ * @param seed unsigned
+ * @return vector<double>
+ */
+vector<double> random_entries(size_t count, unsigned seed)
+{
+    mt19937_64 generator(seed);
+    uniform_real_distribution<double> entry(-1.0, 1.0);
+    vector<double> entries(count);
+    for (double& x : entries) x = entry(generator);
+    return entries;
+}
+
+/**
+ * @brief Returns a random dense n x n matrix with entries in [-1, 1].
+ *
+ * @param n int
+ * @param seed unsigned
+ * @return Matrix*
+ */
+Matrix* random_matrix(int n, unsigned seed) { return new Matrix(n, random_entries((size_t)n * n, seed)); }
+
+/**
+ * @brief Times one full inversion (factor + substitute) with the given block size.
+ *
+ * @return double Seconds
+ */
+double time_inverse(Matrix* m, int block_size)
+{
+    auto start = chrono::steady_clock::now();
+    LUDecomposition* decomposition = lu_decompose(m, block_size);
+    Matrix* inverse = lu_inverse(decomposition, block_size);
+    auto end = chrono::steady_clock::now();
+    delete inverse;
+    delete decomposition;
+    return chrono::duration<double>(end - start).count();
+}
+
+void benchmark_dense_inverse(int largest)
+{
+    printf("microkernel: %s\n", gemm_select_kernel().name);
+    printf("%8s %14s %10s %14s %10s %8s\n", "n", "unblocked (s)", "GFLOP/s", "blocked (s)", "GFLOP/s", "speedup");
+    for (int n = 250; n <= largest; n *= 2)
+    {
+        Matrix* m = random_matrix(n, n);
+        double flops = 2.0 * n * n * n;
+        double unblocked = time_inverse(m, n);
+        double blocked = time_inverse(m, LU_BLOCK_SIZE);
+        printf("%8d %14.3f %10.2f %14.3f %10.2f %7.1fx\n", n, unblocked, flops / unblocked * 1e-9,
+               blocked, flops / blocked * 1e-9, unblocked / blocked);
+        delete m;
+    }
+}
+
+void benchmark_batch_inverse()
+{
+    const int count = 1 << 16;
+    printf("\n%4s %10s %18s %18s %8s\n", "n", "batch", "batched (mat/s)", "one-by-one (mat/s)", "speedup");
+    for (int n = 2; n <= 8; ++n)
+    {
+        vector<double> input = random_entries((size_t)n * n * count, n);
+        vector<double> output(input.size());
+        vector<unsigned char> singular(count);
+
+        auto start = chrono::steady_clock::now();
+        matrix_inverse_batch(n, count, input.data(), output.data(), singular.data());
+        double batched = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        int sample = count / 16; // the per-matrix path is much slower, so time a subset
+        start = chrono::steady_clock::now();
+        for (int b = 0; b < sample; ++b)
+        {
+            Matrix m(n, vector<double>(n * n));
+            for (int e = 0; e < n * n; ++e) m.matrix[e] = input[e * count + b];
+            delete matrix_inverse(&m);
+        }
+        double one_by_one = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        printf("%4d %10d %18.3g %18.3g %7.1fx\n", n, count, count / batched, sample / one_by_one,
+               (count / batched) / (sample / one_by_one));
+    }
+}
+
+/**
+ * @brief Inverts `count` row-major n x n matrices stored back to back with `kernel`
+ * and returns matrices/second.
+ *
+ */
+double time_kernel(void (*kernel)(const double*, double*), int n, int count, const vector<double>& input, vector<double>& output)
+{
+    auto start = chrono::steady_clock::now();
+    for (int b = 0; b < count; ++b) kernel(input.data() + (size_t)b * n * n, output.data() + (size_t)b * n * n);
+    return count / chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * @brief invert() with the signature of a generated kernel, so both can be timed alike.
+ *
+ */
+template<int N>
+void general_inverse(const double* matrix, double* inverse) { invert(matrix, N, inverse); }
+
+void benchmark_generated_kernels()
+{
+    const int count = 1 << 16;
+    typedef void (*kernel)(const double*, double*);
+    const kernel generated[] = { inverse_2x2, inverse_3x3, inverse_4x4, inverse_5x5, inverse_6x6 };
+    const kernel general[] = { general_inverse<2>, general_inverse<3>, general_inverse<4>, general_inverse<5>, general_inverse<6> };
+    printf("\n%4s %20s %18s %8s %12s\n", "n", "generated (mat/s)", "invert() (mat/s)", "speedup", "max diff");
+    for (int n = 2; n <= 6; ++n)
+    {
+        vector<double> input = random_entries((size_t)n * n * count, n);
+        vector<double> fast(input.size());
+        vector<double> reference(input.size());
+        double generated_rate = time_kernel(generated[n - 2], n, count, input, fast);
+        double general_rate = time_kernel(general[n - 2], n, count, input, reference);
+        double difference = 0; // relative to the entry size, random matrices can be badly conditioned
+        for (size_t e = 0; e < input.size(); ++e) difference = max(difference, fabs(fast[e] - reference[e]) / max(1.0, fabs(reference[e])));
+        printf("%4d %20.3g %18.3g %7.1fx %12.2g\n", n, generated_rate, general_rate, generated_rate / general_rate, difference);
+    }
+}
+
+/**
+ * @brief Fills `entries` (n x n) with a matrix of the given kind.
+ *
+ */
+void structured_entries(int kind, int n, vector<double>& entries)
+{
+    vector<double> random = random_entries((size_t)n * n, kind);
+    fill(entries.begin(), entries.end(), 0.0);
+    for (int i = 0; i < n; ++i)
+    {
+        for (int j = 0; j < n; ++j)
+        {
+            double r = random[(size_t)i * n + j];
+            bool nonzero = kind == MATRIX_STRUCTURE_SPD ? j <= i
+                         : kind == MATRIX_STRUCTURE_BANDED ? j >= i - 4 && j <= i + 4
+                         : kind == MATRIX_STRUCTURE_TRIANGULAR ? j <= i
+                         : i % 64 == j % 64; // sparse: 64 independent systems, interleaved
+            if (!nonzero) continue;
+            entries[(size_t)i * n + j] = kind == MATRIX_STRUCTURE_TRIANGULAR ? r / n : r;
+            if (kind == MATRIX_STRUCTURE_SPD) entries[(size_t)j * n + i] = r;
+        }
+        entries[(size_t)i * n + i] = n; // keeps every kind well conditioned, and the SPD one definite
+    }
+}
+
+void benchmark_structured_inverse(int largest)
+{
+    const char* names[] = { "", "", "spd", "banded", "triangular", "sparse" };
+    printf("\n%12s %8s %14s %14s %8s\n", "structure", "n", "dense LU (s)", "detected (s)", "speedup");
+    for (int kind = MATRIX_STRUCTURE_SPD; kind <= MATRIX_STRUCTURE_SPARSE; ++kind)
+    {
+        int n = largest;
+        vector<double> entries((size_t)n * n);
+        vector<double> inverse((size_t)n * n);
+        structured_entries(kind, n, entries);
+        auto start = chrono::steady_clock::now();
+        structured_inverse_into(entries.data(), n, inverse.data(), MATRIX_STRUCTURE_GENERAL);
+        double dense = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        start = chrono::steady_clock::now();
+        structured_inverse_into(entries.data(), n, inverse.data(), MATRIX_STRUCTURE_AUTO);
+        double detected = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        printf("%12s %8d %14.3f %14.3f %7.1fx\n", names[kind], n, dense, detected, dense / detected);
+    }
+}
+
+void benchmark_mixed_precision(int largest)
+{
+    printf("\nsingle-precision microkernel: %s\n", gemm_select_kernel_single().name);
+    printf("%8s %12s %12s %12s %12s\n", "n", "double (s)", "residual", "mixed (s)", "residual");
+    for (int n = 250; n <= largest; n *= 2)
+    {
+        Matrix* m = random_matrix(n, n);
+        vector<double> inverse((size_t)n * n);
+        vector<double> r((size_t)n * n);
+        auto start = chrono::steady_clock::now();
+        structured_inverse_into(matrix_data(m), n, inverse.data(), MATRIX_STRUCTURE_GENERAL);
+        double full = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        double full_residual = identity_residual_into(matrix_data(m), inverse.data(), n, r.data());
+        double mixed_residual;
+        start = chrono::steady_clock::now();
+        mixed_precision_inverse_into(matrix_data(m), n, inverse.data(), &mixed_residual);
+        double mixed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        printf("%8d %12.3f %12.2e %12.3f %12.2e\n", n, full, full_residual, mixed, mixed_residual);
+        delete m;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    int largest = argc > 1 ? atoi(argv[1]) : 2000;
+    benchmark_dense_inverse(largest);
+    benchmark_batch_inverse();
+    benchmark_generated_kernels();
+    benchmark_structured_inverse(largest);
+    benchmark_mixed_precision(largest);
+    return 0;
+}
@@ -0,0 +1,554 @@
+/*
+Regression benchmarks for all three engines, with machine-readable output.
+
+Sweeps matrix size, conditioning and batch count over
+ - matrix_inverse() and matrix_inverse_batch() (inverse_real_valued.cpp),
+ - inverse()                                    (matrix_inverse_web.cpp),
+ - the closed-form generator, and its inverse compiled to a FormulaProgram and
+   evaluated over a batch                       (inverse_closed_form.cpp),
+and reports, for every case, latency percentiles, throughput, heap allocations per
+operation, peak resident memory and (for numeric engines) the worst residual
+max |A * inv(A) - I|. The results are written as JSON so runs from different releases
+can be compared; a readable table goes to stderr.
+
+Build (natively, not with emcc):
+
+    g++ -O2 -pthread benchmark_suite.cpp -o benchmark_suite
+
+Usage: ./benchmark_suite [--quick] [--json results.json]
+
+Author: Evan Lauer
+*/
+
+// Shared headers first, at global scope, so the engines below reuse them.
+#include <vector>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <climits>
+#include <memory>
+#include <tuple>
+#include <unordered_map>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <new>
+#include <sys/resource.h>
+
+#define PROFILE_COUNT_ALLOCATIONS // profiling.h replaces operator new; the suite counts through its hook
+#include "profiling.h"
+#include "gemm_kernels.h"
+#include "thread_pool.h"
+#include "expression.h"
+#include "formula_sink.h"
+#include "formula_cache.h"
+#include "matrix_file.h"
+#include "exact_inverse.h"
+#include "formula_program.h"
+#include "matrix_text.h"
+
+// The engines are separate programs that reuse names (Matrix, populate_matrix, ...),
+// so each one is compiled into its own namespace.
+#define MATRIX_INVERSE_NO_MAIN
+namespace real_valued
+{
+#include "inverse_real_valued.cpp"
+}
+namespace web
+{
+#include "matrix_inverse_web.cpp"
+}
+namespace closed_form
+{
+#include "inverse_closed_form.cpp"
+}
+
+using namespace std;
+
+// Every heap allocation in the process goes through profiling.h's operator new, which
+// calls count_allocation().
+atomic<long long> allocation_count(0);
+atomic<long long> allocated_bytes(0);
+
+void count_allocation(size_t size)
+{
+    allocation_count++;
+    allocated_bytes += size;
+}
+
+// Installs count_allocation() before main() runs.
+const bool allocation_counting_installed = (profile_allocation_hook = count_allocation, true);
+
+/**
+ * @brief Resets the kernel's peak-RSS counter for this process where that is supported
+ * (Linux), so the next peak_rss_kb() covers only what runs after it.
+ *
+ */
+void reset_peak_rss()
+{
+    FILE* file = fopen("/proc/self/clear_refs", "w");
+    if (!file) return;
+    fputs("5", file);
+    fclose(file);
+}
+
+/**
+ * @brief Peak resident memory in KiB: since the last reset_peak_rss() on Linux, since
+ * the process started elsewhere.
+ *
+ */
+long peak_rss_kb()
+{
+    FILE* file = fopen("/proc/self/status", "r");
+    if (file)
+    {
+        char line[256];
+        long peak = -1;
+        while (fgets(line, sizeof(line), file))
+        {
+            if (strncmp(line, "VmHWM:", 6) == 0) peak = atol(line + 6);
+        }
+        fclose(file);
+        if (peak >= 0) return peak;
+    }
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+/**
+ * @brief Measurements for one benchmark case.
+ *
+ */
+class CaseResult
+{
+    public:
+    string engine;
+    string operation;
+    int n;
+    double condition; // 0 when not applicable
+    int batch;
+    vector<double> latencies; // seconds per sample
+    double items_per_sample; // matrices (or bytes) handled by one sample
+    string unit;
+    double allocations_per_op;
+    double bytes_allocated_per_op;
+    long peak_rss_kb;
+    double max_residual; // negative when not applicable
+};
+
+/**
+ * @brief Runs `sample` repeatedly (at least 3 times, until about `budget` seconds have
+ * passed or 1000 samples were taken) and fills in timings, allocations and peak RSS.
+ *
+ */
+void measure(CaseResult& result, double budget, const function<void()>& sample)
+{
+    sample(); // warm up caches, thread pool and lazily built tables
+    reset_peak_rss();
+    long long allocations_before = allocation_count.load();
+    long long bytes_before = allocated_bytes.load();
+    double total = 0;
+    while (result.latencies.size() < 3 || (total < budget && result.latencies.size() < 1000))
+    {
+        auto start = chrono::steady_clock::now();
+        sample();
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        result.latencies.push_back(seconds);
+        total += seconds;
+    }
+    double samples = (double)result.latencies.size();
+    result.allocations_per_op = (allocation_count.load() - allocations_before) / samples / max(1, result.batch);
+    result.bytes_allocated_per_op = (allocated_bytes.load() - bytes_before) / samples / max(1, result.batch);
+    result.peak_rss_kb = peak_rss_kb();
+}
+
+double percentile(vector<double> values, double fraction)
+{
+    sort(values.begin(), values.end());
+    size_t index = (size_t)min((double)values.size() - 1, floor(fraction * values.size()));
+    return values[index];
+}
+
+/**
+ * @brief A random n x n matrix with 2-norm condition number `condition`: singular values
+ * spaced geometrically from 1 to 1/condition, rotated by n random Householder
+ * reflections on each side.
+ *
+ */
+vector<double> conditioned_matrix(int n, double condition, unsigned seed)
+{
+    mt19937_64 generator(seed);
+    normal_distribution<double> gaussian(0.0, 1.0);
+    vector<double> a((size_t)n * n, 0.0);
+    for (int i = 0; i < n; ++i) a[(size_t)i * n + i] = n == 1 ? 1.0 : pow(condition, -(double)i / (n - 1));
+    vector<double> v(n);
+    vector<double> w(n);
+    for (int reflection = 0; reflection < 2 * n; ++reflection)
+    {
+        bool left = reflection % 2 == 0;
+        double norm = 0;
+        for (double& x : v) { x = gaussian(generator); norm += x * x; }
+        double scale = 2.0 / norm;
+        // A := (I - scale v v^T) A on the left, A (I - scale v v^T) on the right
+        for (int i = 0; i < n; ++i)
+        {
+            double sum = 0;
+            for (int k = 0; k < n; ++k) sum += left ? v[k] * a[(size_t)k * n + i] : a[(size_t)i * n + k] * v[k];
+            w[i] = scale * sum;
+        }
+        for (int i = 0; i < n; ++i)
+        {
+            for (int j = 0; j < n; ++j) a[(size_t)i * n + j] -= left ? v[i] * w[j] : w[i] * v[j];
+        }
+    }
+    return a;
+}
+
+/**
+ * @brief max |A * X - I| over all entries.
+ *
+ */
+double residual(const double* a, const double* x, int n)
+{
+    double worst = 0;
+    for (int i = 0; i < n; ++i)
+    {
+        for (int j = 0; j < n; ++j)
+        {
+            double sum = 0;
+            for (int k = 0; k < n; ++k) sum += a[(size_t)i * n + k] * x[(size_t)k * n + j];
+            worst = max(worst, fabs(sum - (i == j ? 1.0 : 0.0)));
+        }
+    }
+    return worst;
+}
+
+CaseResult new_case(const string& engine, const string& operation, int n, double condition, int batch, const string& unit)
+{
+    CaseResult result;
+    result.engine = engine;
+    result.operation = operation;
+    result.n = n;
+    result.condition = condition;
+    result.batch = batch;
+    result.items_per_sample = batch;
+    result.unit = unit;
+    result.max_residual = -1;
+    return result;
+}
+
+CaseResult benchmark_real_valued(int n, double condition, double budget)
+{
+    CaseResult result = new_case("real_valued", "matrix_inverse", n, condition, 1, "matrices");
+    vector<double> entries = conditioned_matrix(n, condition, 1000 + n);
+    real_valued::Matrix matrix(n, entries);
+    measure(result, budget, [&]() { delete real_valued::matrix_inverse(&matrix); });
+    real_valued::Matrix* inverse = real_valued::matrix_inverse(&matrix);
+    if (inverse) result.max_residual = residual(entries.data(), inverse->matrix.data(), n);
+    delete inverse;
+    return result;
+}
+
+/**
+ * @brief Writes an n x n matrix in the text format of the JS interfaces and reads it
+ * back (matrix_text.h). The residual is the largest change of an entry, so 0 when the
+ * text round trips exactly.
+ *
+ */
+CaseResult benchmark_text_round_trip(int n, double budget)
+{
+    CaseResult result = new_case("real_valued", "text_round_trip", n, 0, 1, "matrices");
+    vector<double> entries = conditioned_matrix(n, 10.0, 3000 + n);
+    string text;
+    vector<double> decoded;
+    measure(result, budget, [&]()
+    {
+        matrix_text_format(entries.data(), n, text);
+        matrix_text_parse(text.data(), text.size(), decoded);
+    });
+    if (decoded.size() == entries.size())
+    {
+        result.max_residual = 0;
+        for (size_t i = 0; i < entries.size(); ++i) result.max_residual = max(result.max_residual, fabs(decoded[i] - entries[i]));
+    }
+    return result;
+}
+
+/**
+ * @brief `count` well-conditioned n x n matrices, entry-major (structure-of-arrays).
+ *
+ */
+vector<double> batch_input(int n, int count)
+{
+    vector<double> input((size_t)n * n * count);
+    for (int b = 0; b < count; ++b)
+    {
+        vector<double> entries = conditioned_matrix(n, 10.0, 2000 + b);
+        for (int e = 0; e < n * n; ++e) input[(size_t)e * count + b] = entries[e];
+    }
+    return input;
+}
+
+/**
+ * @brief The worst residual over a batch of matrices and inverses stored as batch_input().
+ *
+ */
+double batch_residual(int n, int count, const vector<double>& input, const vector<double>& output)
+{
+    double worst = 0;
+    vector<double> a((size_t)n * n);
+    vector<double> x((size_t)n * n);
+    for (int b = 0; b < count; ++b)
+    {
+        for (int e = 0; e < n * n; ++e) { a[e] = input[(size_t)e * count + b]; x[e] = output[(size_t)e * count + b]; }
+        worst = max(worst, residual(a.data(), x.data(), n));
+    }
+    return worst;
+}
+
+CaseResult benchmark_real_valued_batch(int n, int count, double budget)
+{
+    CaseResult result = new_case("real_valued", "matrix_inverse_batch", n, 0, count, "matrices");
+    vector<double> input = batch_input(n, count);
+    vector<double> output(input.size());
+    vector<unsigned char> singular(count);
+    measure(result, budget, [&]() { real_valued::matrix_inverse_batch(n, count, input.data(), output.data(), singular.data()); });
+    result.max_residual = batch_residual(n, count, input, output);
+    return result;
+}
+
+CaseResult benchmark_closed_form_program(int n, int count, double budget)
+{
+    CaseResult result = new_case("closed_form", "evaluate_inverse", n, 0, count, "matrices");
+    vector<double> input = batch_input(n, count);
+    vector<double> output(input.size());
+    closed_form::inverse_program(n); // compiled once, outside the timing
+    measure(result, budget, [&]() { closed_form::evaluate_inverse_closed_form(n, count, input.data(), output.data()); });
+    result.max_residual = batch_residual(n, count, input, output);
+    return result;
+}
+
+CaseResult benchmark_web(int n, double condition, double budget)
+{
+    CaseResult result = new_case("web", "inverse", n, condition, 1, "matrices");
+    vector<double> entries = conditioned_matrix(n, condition, 3000 + n);
+    typedef vector<vector<tuple<VariableId, double>>*> WebMatrix;
+    WebMatrix matrix;
+    vector<vector<tuple<VariableId, double>>> rows(n);
+    for (int i = 0; i < n; ++i)
+    {
+        for (int j = 0; j < n; ++j) rows[i].push_back(make_tuple(web::get_entry_name(i, j), entries[(size_t)i * n + j]));
+        matrix.push_back(&rows[i]);
+    }
+    vector<double> inverse((size_t)n * n);
+    measure(result, budget, [&]()
+    {
+        PolynomialArena* formulas = web::formulas();
+        formulas->polynomials.clear();
+        formulas->variables.clear();
+        formulas->coefficients.clear();
+        vector<vector<tuple<int, double>>*>* computed = web::inverse(&matrix);
+        if (!computed) return;
+        for (int i = 0; i < n; ++i)
+        {
+            for (int j = 0; j < n; ++j) inverse[(size_t)i * n + j] = get<1>(computed->at(i)->at(j));
+        }
+        web::delete_matrix(computed);
+    });
+    result.max_residual = residual(entries.data(), inverse.data(), n);
+    return result;
+}
+
+/**
+ * @brief inverse_from_input_string() on 3 x 3 matrices whose entries span the whole range
+ * of a double, so their inverses have entries near 1e300 and 1e-300. The text path goes
+ * through the exact inverse, and these check that its conversion back to double neither
+ * overflows nor underflows. The residual is the worst over the three.
+ *
+ */
+CaseResult benchmark_web_scaled(double budget)
+{
+    const char* inputs[] = { "1,1e40,0,\n,0,1,0,\n,0,0,1,", "1e-300,0,0,\n,0,1,0,\n,0,0,1,",
+                             "1e200,1,0,\n,0,1e-200,0,\n,0,0,1e-308," }; // the web page's format, with no final newline
+    CaseResult result = new_case("web", "inverse_text_scaled", 3, 0, 3, "matrices");
+    vector<string> outputs(3);
+    measure(result, budget, [&]()
+    {
+        for (int i = 0; i < 3; ++i) outputs[i] = web::inverse_from_input_string(inputs[i]);
+    });
+    result.max_residual = 0;
+    for (int i = 0; i < 3; ++i)
+    {
+        string input = string(inputs[i]) + "\n,";
+        vector<double> a;
+        vector<double> x;
+        if (matrix_text_parse(input.data(), input.size(), a) != 3 || matrix_text_parse(outputs[i].data(), outputs[i].size(), x) != 3)
+        {
+            result.max_residual = numeric_limits<double>::infinity();
+            continue;
+        }
+        result.max_residual = max(result.max_residual, residual(a.data(), x.data(), 3));
+    }
+    return result;
+}
+
+/**
+ * @brief Counts the bytes written to it and drops them.
+ *
+ */
+class DiscardSink : public FormulaSink
+{
+    public:
+    size_t written;
+
+    DiscardSink() { written = 0; }
+
+    protected:
+    void flush(const char*, size_t length) { written += length; }
+};
+
+CaseResult benchmark_closed_form(const string& variant, int n, double budget)
+{
+    CaseResult result = new_case("closed_form", variant, n, 0, 1, "bytes");
+    size_t bytes = 0;
+    measure(result, budget, [&]()
+    {
+        DiscardSink sink;
+        if (variant == "inverse") closed_form::write_inverse_closed_form(n, sink);
+        else if (variant == "inverse_dag") closed_form::write_inverse_closed_form_dag(n, sink);
+        else closed_form::write_determinant_closed_form(n, sink);
+        bytes = sink.written;
+    });
+    result.items_per_sample = (double)bytes;
+    return result;
+}
+
+void print_case(const CaseResult& result)
+{
+    double p50 = percentile(result.latencies, 0.5);
+    char condition[16] = "-";
+    char residual_text[16] = "-";
+    if (result.condition > 0) snprintf(condition, sizeof(condition), "%.0e", result.condition);
+    if (result.max_residual >= 0) snprintf(residual_text, sizeof(residual_text), "%.2g", result.max_residual);
+    fprintf(stderr, "%-12s %-21s %4d %8s %6d %12.3g %12.3g %12.3g %10.3g %12.3g %10ld %10s\n", result.engine.c_str(),
+            result.operation.c_str(), result.n, condition, result.batch, p50 * 1e6, percentile(result.latencies, 0.99) * 1e6,
+            result.items_per_sample / p50, result.allocations_per_op, result.bytes_allocated_per_op, result.peak_rss_kb,
+            residual_text);
+}
+
+/**
+ * @brief Writes `value` as a JSON number (JSON has no inf/nan, so those become null).
+ *
+ */
+string json_number(double value)
+{
+    if (!isfinite(value)) return "null";
+    char text[32];
+    snprintf(text, sizeof(text), "%.6g", value);
+    return text;
+}
+
+void write_json(FILE* file, const vector<CaseResult>& results)
+{
+    fprintf(file, "{\n  \"suite\": \"matrix_inverse_calculator\",\n  \"format\": 1,\n  \"threads\": %d,\n  \"microkernel\": \"%s\",\n  \"results\": [\n",
+            shared_thread_pool().size(), gemm_select_kernel().name);
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        const CaseResult& r = results[i];
+        double p50 = percentile(r.latencies, 0.5);
+        fprintf(file, "    {\"engine\": \"%s\", \"operation\": \"%s\", \"n\": %d, \"condition\": %s, \"batch\": %d, \"samples\": %zu, ",
+                r.engine.c_str(), r.operation.c_str(), r.n, r.condition > 0 ? json_number(r.condition).c_str() : "null", r.batch,
+                r.latencies.size());
+        fprintf(file, "\"latency_us\": {\"min\": %s, \"p50\": %s, \"p90\": %s, \"p99\": %s, \"max\": %s}, ",
+                json_number(percentile(r.latencies, 0) * 1e6).c_str(), json_number(p50 * 1e6).c_str(),
+                json_number(percentile(r.latencies, 0.9) * 1e6).c_str(), json_number(percentile(r.latencies, 0.99) * 1e6).c_str(),
+                json_number(percentile(r.latencies, 1) * 1e6).c_str());
+        fprintf(file, "\"throughput\": {\"per_second\": %s, \"unit\": \"%s\"}, ", json_number(r.items_per_sample / p50).c_str(), r.unit.c_str());
+        fprintf(file, "\"allocations_per_op\": %s, \"bytes_allocated_per_op\": %s, \"peak_rss_kb\": %ld, \"max_residual\": %s}%s\n",
+                json_number(r.allocations_per_op).c_str(), json_number(r.bytes_allocated_per_op).c_str(), r.peak_rss_kb,
+                r.max_residual >= 0 ? json_number(r.max_residual).c_str() : "null", i + 1 < results.size() ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+}
+
+int main(int argc, char** argv)
+{
+    bool quick = false;
+    const char* json_path = nullptr;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (string(argv[i]) == "--quick") quick = true;
+        else if (string(argv[i]) == "--json" && i + 1 < argc) json_path = argv[++i];
+        else
+        {
+            fprintf(stderr, "usage: %s [--quick] [--json results.json]\n", argv[0]);
+            return 2;
+        }
+    }
+    double budget = quick ? 0.05 : 0.5; // seconds of samples per case
+
+    vector<int> dense_sizes = quick ? vector<int>{ 4, 32, 128 } : vector<int>{ 4, 8, 32, 128, 512, 1024 };
+    vector<double> conditions = { 1e1, 1e6, 1e12 };
+    vector<int> batch_counts = quick ? vector<int>{ 1, 1024 } : vector<int>{ 1, 64, 4096 };
+    int largest_web = quick ? 6 : 8;
+    int largest_closed_form = quick ? 7 : 9;
+
+    fprintf(stderr, "%-12s %-21s %4s %8s %6s %12s %12s %12s %10s %12s %10s %10s\n", "engine", "operation", "n", "cond", "batch",
+            "p50 (us)", "p99 (us)", "per second", "allocs/op", "bytes/op", "peak KiB", "residual");
+    vector<CaseResult> results;
+    for (int n : dense_sizes)
+    {
+        for (double condition : conditions)
+        {
+            results.push_back(benchmark_real_valued(n, condition, budget));
+            print_case(results.back());
+        }
+        results.push_back(benchmark_text_round_trip(n, budget));
+        print_case(results.back());
+    }
+    for (int n = 2; n <= 8; n += quick ? 3 : 1)
+    {
+        for (int count : batch_counts)
+        {
+            results.push_back(benchmark_real_valued_batch(n, count, budget));
+            print_case(results.back());
+            results.push_back(benchmark_closed_form_program(n, count, budget));
+            print_case(results.back());
+        }
+    }
+    for (int n = 3; n <= largest_web; ++n)
+    {
+        for (double condition : conditions)
+        {
+            results.push_back(benchmark_web(n, condition, budget));
+            print_case(results.back());
+        }
+    }
+    results.push_back(benchmark_web_scaled(budget));
+    print_case(results.back());
+    for (int n = 3; n <= largest_closed_form; ++n)
+    {
+        for (const char* variant : { "determinant", "inverse", "inverse_dag" })
+        {
+            results.push_back(benchmark_closed_form(variant, n, budget));
+            print_case(results.back());
+        }
+    }
+
+    FILE* out = json_path ? fopen(json_path, "w") : stdout;
+    if (!out)
+    {
+        fprintf(stderr, "cannot write %s\n", json_path);
+        return 1;
+    }
+    write_json(out, results);
+    if (json_path) fclose(out);
+    return 0;
+}
@@ -0,0 +1,604 @@
+/*
+Arbitrary-precision integers and exact rationals, for the exact inverse
+(exact_inverse.h).
+
+A BigInt whose value fits in 63 bits is held directly in an int64_t and handled with
+machine arithmetic, checked for overflow; only larger values use a vector of 32-bit
+limbs. Entries of integer matrices, and most intermediate values of the elimination on
+small matrices, never leave the fast path. Larger values use schoolbook multiplication
+and Knuth's long division (The Art of Computer Programming, vol. 2, 4.3.1, algorithm D).
+
+A Rational is a BigInt numerator and a positive BigInt denominator with no common
+factor, so equal values always have equal representations.
+
+Author: Evan Lauer
+*/
+
+#ifndef BIGINT_H
+#define BIGINT_H
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+using namespace std;
+
+/**
+ * @brief An integer of any size. When `limbs` is empty the value is `small`; otherwise
+ * it is the magnitude in `limbs` (least significant first, no leading zero limbs, too
+ * large for an int64_t) with the sign `negative`.
+ *
+ */
+class BigInt
+{
+    public:
+    int64_t small;
+    bool negative;
+    vector<uint32_t> limbs;
+
+    BigInt(int64_t value = 0)
+    {
+        small = value;
+        negative = false;
+    }
+};
+
+typedef vector<uint32_t> Magnitude; // least significant limb first
+
+bool bigint_is_zero(const BigInt& a) { return a.limbs.empty() && a.small == 0; }
+
+bool bigint_is_negative(const BigInt& a) { return a.limbs.empty() ? a.small < 0 : a.negative; }
+
+/**
+ * @brief The magnitude of a as limbs.
+ *
+ */
+Magnitude bigint_magnitude(const BigInt& a)
+{
+    if (!a.limbs.empty()) return a.limbs;
+    uint64_t value = a.small < 0 ? 0 - (uint64_t)a.small : (uint64_t)a.small;
+    Magnitude magnitude;
+    while (value)
+    {
+        magnitude.push_back((uint32_t)value);
+        value >>= 32;
+    }
+    return magnitude;
+}
+
+/**
+ * @brief Builds a BigInt from a sign and a magnitude, using the small form when the
+ * value fits in 63 bits.
+ *
+ */
+BigInt bigint_from_magnitude(bool negative, Magnitude magnitude)
+{
+    while (!magnitude.empty() && magnitude.back() == 0) magnitude.pop_back();
+    BigInt result;
+    if (magnitude.size() <= 2)
+    {
+        uint64_t value = magnitude.empty() ? 0 : magnitude[0];
+        if (magnitude.size() == 2) value |= (uint64_t)magnitude[1] << 32;
+        if (value <= (uint64_t)INT64_MAX)
+        {
+            result.small = negative ? -(int64_t)value : (int64_t)value;
+            return result;
+        }
+    }
+    result.small = 0;
+    result.negative = negative;
+    result.limbs = magnitude;
+    return result;
+}
+
+int magnitude_compare(const Magnitude& a, const Magnitude& b)
+{
+    if (a.size() != b.size()) return a.size() < b.size() ? -1 : 1;
+    for (size_t i = a.size(); i-- > 0;)
+    {
+        if (a[i] != b[i]) return a[i] < b[i] ? -1 : 1;
+    }
+    return 0;
+}
+
+Magnitude magnitude_add(const Magnitude& a, const Magnitude& b)
+{
+    const Magnitude& longer = a.size() >= b.size() ? a : b;
+    const Magnitude& shorter = a.size() >= b.size() ? b : a;
+    Magnitude sum(longer.size() + 1);
+    uint64_t carry = 0;
+    for (size_t i = 0; i < longer.size(); ++i)
+    {
+        carry += (uint64_t)longer[i] + (i < shorter.size() ? shorter[i] : 0);
+        sum[i] = (uint32_t)carry;
+        carry >>= 32;
+    }
+    sum[longer.size()] = (uint32_t)carry;
+    return sum;
+}
+
+/**
+ * @brief a - b, for a >= b.
+ *
+ */
+Magnitude magnitude_subtract(const Magnitude& a, const Magnitude& b)
+{
+    Magnitude difference(a.size());
+    int64_t borrow = 0;
+    for (size_t i = 0; i < a.size(); ++i)
+    {
+        int64_t value = (int64_t)a[i] - (i < b.size() ? b[i] : 0) - borrow;
+        borrow = value < 0;
+        difference[i] = (uint32_t)(value + (borrow << 32));
+    }
+    return difference;
+}
+
+Magnitude magnitude_multiply(const Magnitude& a, const Magnitude& b)
+{
+    if (a.empty() || b.empty()) return Magnitude();
+    Magnitude product(a.size() + b.size(), 0);
+    for (size_t i = 0; i < a.size(); ++i)
+    {
+        uint64_t carry = 0;
+        for (size_t j = 0; j < b.size(); ++j)
+        {
+            carry += (uint64_t)a[i] * b[j] + product[i + j];
+            product[i + j] = (uint32_t)carry;
+            carry >>= 32;
+        }
+        product[i + b.size()] = (uint32_t)carry;
+    }
+    return product;
+}
+
+/**
+ * @brief Divides a by a single limb d, returning the quotient; the remainder goes to
+ * `remainder`.
+ *
+ */
+Magnitude magnitude_divide_limb(const Magnitude& a, uint32_t d, uint32_t& remainder)
+{
+    Magnitude quotient(a.size());
+    uint64_t rest = 0;
+    for (size_t i = a.size(); i-- > 0;)
+    {
+        rest = (rest << 32) | a[i];
+        quotient[i] = (uint32_t)(rest / d);
+        rest %= d;
+    }
+    remainder = (uint32_t)rest;
+    return quotient;
+}
+
+/**
+ * @brief Long division of magnitudes, b not zero: quotient and remainder.
+ *
+ */
+void magnitude_divide(const Magnitude& a, const Magnitude& b, Magnitude& quotient, Magnitude& remainder)
+{
+    if (magnitude_compare(a, b) < 0)
+    {
+        quotient.clear();
+        remainder = a;
+        return;
+    }
+    if (b.size() == 1)
+    {
+        uint32_t rest;
+        quotient = magnitude_divide_limb(a, b[0], rest);
+        remainder = Magnitude(1, rest);
+        return;
+    }
+    // Normalize so the top limb of the divisor has its high bit set; then each quotient
+    // limb estimated from the top two limbs is at most two too large.
+    int shift = __builtin_clz(b.back());
+    size_t n = b.size();
+    size_t m = a.size() - n;
+    Magnitude v(n);
+    Magnitude u(a.size() + 1);
+    for (size_t i = n; i-- > 0;) v[i] = (b[i] << shift) | (shift && i ? b[i - 1] >> (32 - shift) : 0);
+    u[a.size()] = shift ? a.back() >> (32 - shift) : 0;
+    for (size_t i = a.size(); i-- > 0;) u[i] = (a[i] << shift) | (shift && i ? a[i - 1] >> (32 - shift) : 0);
+
+    quotient.assign(m + 1, 0);
+    for (size_t j = m + 1; j-- > 0;)
+    {
+        uint64_t top = ((uint64_t)u[j + n] << 32) | u[j + n - 1];
+        uint64_t estimate = top / v[n - 1];
+        uint64_t rest = top % v[n - 1];
+        while (estimate > 0xffffffffull || estimate * v[n - 2] > ((rest << 32) | u[j + n - 2]))
+        {
+            --estimate;
+            rest += v[n - 1];
+            if (rest > 0xffffffffull) break;
+        }
+        int64_t borrow = 0;
+        uint64_t carry = 0;
+        for (size_t i = 0; i < n; ++i) // u[j..j+n] -= estimate * v
+        {
+            carry += estimate * v[i];
+            int64_t value = (int64_t)u[i + j] - (int64_t)(uint32_t)carry - borrow;
+            carry >>= 32;
+            borrow = value < 0;
+            u[i + j] = (uint32_t)(value + (borrow << 32));
+        }
+        int64_t value = (int64_t)u[j + n] - (int64_t)carry - borrow;
+        borrow = value < 0;
+        u[j + n] = (uint32_t)value;
+        if (borrow) // the estimate was one too large: add v back
+        {
+            --estimate;
+            uint64_t sum = 0;
+            for (size_t i = 0; i < n; ++i)
+            {
+                sum += (uint64_t)u[i + j] + v[i];
+                u[i + j] = (uint32_t)sum;
+                sum >>= 32;
+            }
+            u[j + n] += (uint32_t)sum;
+        }
+        quotient[j] = (uint32_t)estimate;
+    }
+    remainder.assign(n, 0);
+    for (size_t i = 0; i < n; ++i) remainder[i] = (u[i] >> shift) | (shift && i + 1 < u.size() ? (uint32_t)((uint64_t)u[i + 1] << (32 - shift)) : 0);
+}
+
+BigInt operator-(const BigInt& a)
+{
+    if (a.limbs.empty() && a.small != INT64_MIN) return BigInt(-a.small);
+    return bigint_from_magnitude(!bigint_is_negative(a), bigint_magnitude(a));
+}
+
+BigInt operator+(const BigInt& a, const BigInt& b)
+{
+    int64_t sum;
+    if (a.limbs.empty() && b.limbs.empty() && !__builtin_add_overflow(a.small, b.small, &sum)) return BigInt(sum);
+    bool a_negative = bigint_is_negative(a);
+    bool b_negative = bigint_is_negative(b);
+    Magnitude x = bigint_magnitude(a);
+    Magnitude y = bigint_magnitude(b);
+    if (a_negative == b_negative) return bigint_from_magnitude(a_negative, magnitude_add(x, y));
+    if (magnitude_compare(x, y) >= 0) return bigint_from_magnitude(a_negative, magnitude_subtract(x, y));
+    return bigint_from_magnitude(b_negative, magnitude_subtract(y, x));
+}
+
+BigInt operator-(const BigInt& a, const BigInt& b)
+{
+    int64_t difference;
+    if (a.limbs.empty() && b.limbs.empty() && !__builtin_sub_overflow(a.small, b.small, &difference)) return BigInt(difference);
+    return a + (-b);
+}
+
+BigInt operator*(const BigInt& a, const BigInt& b)
+{
+    int64_t product;
+    if (a.limbs.empty() && b.limbs.empty() && !__builtin_mul_overflow(a.small, b.small, &product)) return BigInt(product);
+    return bigint_from_magnitude(bigint_is_negative(a) != bigint_is_negative(b), magnitude_multiply(bigint_magnitude(a), bigint_magnitude(b)));
+}
+
+/**
+ * @brief Truncating division, as for C integers: a = quotient * b + remainder, with the
+ * remainder taking the sign of a. b must not be zero.
+ *
+ */
+void bigint_divide(const BigInt& a, const BigInt& b, BigInt& quotient, BigInt& remainder)
+{
+    if (a.limbs.empty() && b.limbs.empty() && !(a.small == INT64_MIN && b.small == -1))
+    {
+        quotient = BigInt(a.small / b.small);
+        remainder = BigInt(a.small % b.small);
+        return;
+    }
+    Magnitude q;
+    Magnitude r;
+    magnitude_divide(bigint_magnitude(a), bigint_magnitude(b), q, r);
+    quotient = bigint_from_magnitude(bigint_is_negative(a) != bigint_is_negative(b), q);
+    remainder = bigint_from_magnitude(bigint_is_negative(a), r);
+}
+
+BigInt operator/(const BigInt& a, const BigInt& b)
+{
+    BigInt quotient;
+    BigInt remainder;
+    bigint_divide(a, b, quotient, remainder);
+    return quotient;
+}
+
+BigInt operator%(const BigInt& a, const BigInt& b)
+{
+    BigInt quotient;
+    BigInt remainder;
+    bigint_divide(a, b, quotient, remainder);
+    return remainder;
+}
+
+bool operator==(const BigInt& a, const BigInt& b)
+{
+    if (a.limbs.empty() || b.limbs.empty()) return a.limbs.empty() && b.limbs.empty() && a.small == b.small;
+    return a.negative == b.negative && a.limbs == b.limbs;
+}
+
+bool operator!=(const BigInt& a, const BigInt& b) { return !(a == b); }
+
+/**
+ * @brief -1, 0 or 1 as a is less than, equal to or greater than b.
+ *
+ */
+int bigint_compare(const BigInt& a, const BigInt& b)
+{
+    if (a.limbs.empty() && b.limbs.empty()) return a.small < b.small ? -1 : a.small > b.small ? 1 : 0;
+    bool a_negative = bigint_is_negative(a);
+    if (a_negative != bigint_is_negative(b)) return a_negative ? -1 : 1;
+    int order = magnitude_compare(bigint_magnitude(a), bigint_magnitude(b));
+    return a_negative ? -order : order;
+}
+
+BigInt bigint_abs(const BigInt& a) { return bigint_is_negative(a) ? -a : a; }
+
+/**
+ * @brief Greatest common divisor, always non-negative; gcd(0, 0) = 0.
+ *
+ */
+BigInt bigint_gcd(BigInt a, BigInt b)
+{
+    a = bigint_abs(a);
+    b = bigint_abs(b);
+    while (!bigint_is_zero(b))
+    {
+        if (a.limbs.empty() && b.limbs.empty())
+        {
+            uint64_t x = (uint64_t)a.small;
+            uint64_t y = (uint64_t)b.small;
+            while (y)
+            {
+                uint64_t t = x % y;
+                x = y;
+                y = t;
+            }
+            return BigInt((int64_t)x);
+        }
+        BigInt t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+/**
+ * @brief a * 2^bits, for bits >= 0.
+ *
+ */
+BigInt bigint_shift_left(const BigInt& a, int bits)
+{
+    Magnitude magnitude = bigint_magnitude(a);
+    if (magnitude.empty()) return BigInt(0);
+    Magnitude shifted(bits / 32, 0);
+    int shift = bits % 32;
+    uint32_t carry = 0;
+    for (uint32_t limb : magnitude)
+    {
+        shifted.push_back((limb << shift) | carry);
+        carry = shift ? limb >> (32 - shift) : 0;
+    }
+    shifted.push_back(carry);
+    return bigint_from_magnitude(bigint_is_negative(a), shifted);
+}
+
+/**
+ * @brief Decimal text, e.g. "-1234".
+ *
+ */
+string bigint_to_string(const BigInt& a)
+{
+    if (a.limbs.empty()) return to_string(a.small);
+    Magnitude magnitude = a.limbs;
+    vector<uint32_t> groups; // base 10^9, least significant first
+    while (!magnitude.empty())
+    {
+        uint32_t group;
+        magnitude = magnitude_divide_limb(magnitude, 1000000000u, group);
+        while (!magnitude.empty() && magnitude.back() == 0) magnitude.pop_back();
+        groups.push_back(group);
+    }
+    string text = a.negative ? "-" : "";
+    text += to_string(groups.back());
+    char digits[16];
+    for (size_t i = groups.size() - 1; i-- > 0;)
+    {
+        snprintf(digits, sizeof(digits), "%09u", groups[i]);
+        text += digits;
+    }
+    return text;
+}
+
+/**
+ * @brief Parses an optionally signed run of decimal digits. Returns false if `text` is
+ * not one.
+ *
+ */
+bool bigint_parse(const char* text, size_t length, BigInt& out)
+{
+    size_t i = 0;
+    bool negative = length > 0 && text[0] == '-';
+    if (length > 0 && (text[0] == '-' || text[0] == '+')) i = 1;
+    if (i == length) return false;
+    BigInt value(0);
+    while (i < length)
+    {
+        int64_t group = 0;
+        int64_t scale = 1;
+        for (int d = 0; d < 18 && i < length; ++d, ++i)
+        {
+            if (text[i] < '0' || text[i] > '9') return false;
+            group = group * 10 + (text[i] - '0');
+            scale *= 10;
+        }
+        value = value * BigInt(scale) + BigInt(group);
+    }
+    out = negative ? -value : value;
+    return true;
+}
+
+/**
+ * @brief The nearest double, approximately (the top 64 bits are used).
+ *
+ */
+double bigint_to_double(const BigInt& a)
+{
+    if (a.limbs.empty()) return (double)a.small;
+    size_t n = a.limbs.size();
+    double value = ldexp((double)a.limbs[n - 1], 32) + a.limbs[n - 2];
+    value = ldexp(value, 32 * (int)(n - 2));
+    return a.negative ? -value : value;
+}
+
+/**
+ * @brief An exact fraction: den > 0 and gcd(num, den) = 1 (see rational()).
+ *
+ */
+class Rational
+{
+    public:
+    BigInt num;
+    BigInt den;
+
+    Rational() : num(0), den(1) {}
+};
+
+/**
+ * @brief num / den in lowest terms, with a positive denominator. den must not be zero.
+ *
+ */
+Rational rational(const BigInt& num, const BigInt& den)
+{
+    Rational r;
+    BigInt divisor = bigint_gcd(num, den);
+    if (bigint_is_negative(den)) divisor = -divisor;
+    if (divisor.limbs.empty() && divisor.small == 1)
+    {
+        r.num = num;
+        r.den = den;
+        return r;
+    }
+    r.num = num / divisor;
+    r.den = den / divisor;
+    return r;
+}
+
+bool rational_is_zero(const Rational& r) { return bigint_is_zero(r.num); }
+
+/**
+ * @brief "p/q", or just "p" for an integer.
+ *
+ */
+string rational_to_string(const Rational& r)
+{
+    if (r.den.limbs.empty() && r.den.small == 1) return bigint_to_string(r.num);
+    return bigint_to_string(r.num) + "/" + bigint_to_string(r.den);
+}
+
+/**
+ * @brief The top 64 bits of |a|, with the highest bit set, and the exponent for which
+ * |a| = top * 2^exponent up to the bits below them. a must not be zero.
+ *
+ */
+uint64_t bigint_top_bits(const BigInt& a, int& exponent)
+{
+    Magnitude magnitude = bigint_magnitude(a);
+    int n = (int)magnitude.size();
+    uint64_t top = (uint64_t)magnitude[n - 1] << 32 | (n >= 2 ? magnitude[n - 2] : 0);
+    uint64_t next = n >= 3 ? magnitude[n - 3] : 0;
+    int shift = __builtin_clzll(top); // below 32, as the top limb is not zero
+    if (shift) top = top << shift | next >> (32 - shift);
+    exponent = 32 * (n - 2) - shift;
+    return top;
+}
+
+/**
+ * @brief num / den as the nearest double, approximately, without reducing the fraction
+ * first. The top 64 bits of each are divided and the quotient scaled by the difference
+ * in length, so only answers outside the range of a double overflow or underflow. den
+ * must not be zero.
+ *
+ */
+double bigint_ratio_to_double(const BigInt& num, const BigInt& den)
+{
+    if (bigint_is_zero(num)) return 0;
+    if (num.limbs.empty() && den.limbs.empty()) return (double)num.small / (double)den.small;
+    int num_exponent;
+    int den_exponent;
+    double quotient = (double)bigint_top_bits(num, num_exponent) / (double)bigint_top_bits(den, den_exponent);
+    double value = ldexp(quotient, num_exponent - den_exponent);
+    return bigint_is_negative(num) != bigint_is_negative(den) ? -value : value;
+}
+
+double rational_to_double(const Rational& r) { return bigint_ratio_to_double(r.num, r.den); }
+
+/**
+ * @brief The exact value of a finite double.
+ *
+ */
+Rational rational_from_double(double value)
+{
+    int exponent;
+    double mantissa = frexp(value, &exponent); // value = mantissa * 2^exponent, 0.5 <= |mantissa| < 1
+    BigInt integer((int64_t)ldexp(mantissa, 53));
+    exponent -= 53;
+    if (exponent >= 0) return rational(bigint_shift_left(integer, exponent), BigInt(1));
+    return rational(integer, bigint_shift_left(BigInt(1), -exponent));
+}
+
+/**
+ * @brief Parses an exact number: an integer ("-12"), a fraction ("3/4") or a decimal
+ * with an optional exponent ("0.125", "-1.5e-3"), all read exactly. Surrounding spaces
+ * are ignored. Returns false if `text` is none of these.
+ *
+ * @param text const char*
+ * @param length size_t
+ * @param out Rational&
+ * @return bool
+ */
+bool rational_parse(const char* text, size_t length, Rational& out)
+{
+    while (length > 0 && (*text == ' ' || *text == '\t')) { ++text; --length; }
+    while (length > 0 && (text[length - 1] == ' ' || text[length - 1] == '\t' || text[length - 1] == '\r')) --length;
+    const char* slash = (const char*)memchr(text, '/', length);
+    if (slash)
+    {
+        BigInt num;
+        BigInt den;
+        if (!bigint_parse(text, slash - text, num) || !bigint_parse(slash + 1, text + length - slash - 1, den) || bigint_is_zero(den)) return false;
+        out = rational(num, den);
+        return true;
+    }
+    size_t mantissa_end = 0;
+    while (mantissa_end < length && text[mantissa_end] != 'e' && text[mantissa_end] != 'E') ++mantissa_end;
+    long exponent = 0;
+    if (mantissa_end < length)
+    {
+        BigInt parsed;
+        if (!bigint_parse(text + mantissa_end + 1, length - mantissa_end - 1, parsed) || !parsed.limbs.empty()) return false;
+        if (parsed.small > 100000 || parsed.small < -100000) return false;
+        exponent = (long)parsed.small;
+    }
+    string digits(text, mantissa_end); // sign and digits, with the point removed
+    size_t point = digits.find('.');
+    if (point != string::npos)
+    {
+        exponent -= (long)(digits.size() - point - 1);
+        digits.erase(point, 1);
+        if (digits.empty() || digits == "-" || digits == "+") return false;
+    }
+    BigInt num;
+    if (!bigint_parse(digits.data(), digits.size(), num)) return false;
+    BigInt ten_power(1);
+    for (long e = 0; e < labs(exponent); ++e) ten_power = ten_power * BigInt(10);
+    out = exponent >= 0 ? rational(num * ten_power, BigInt(1)) : rational(num, ten_power);
+    return true;
+}
+
+#endif
@@ -0,0 +1,19 @@
+// Generated by `inverse_closed_form --header 2`. Do not edit.
+#ifndef INVERSE_2X2_H
+#define INVERSE_2X2_H
+
+inline void inverse_2x2(const double* matrix, double* inverse)
+{
+    const double a0 = matrix[0];
+    const double a1 = matrix[1];
+    const double a2 = matrix[2];
+    const double a3 = matrix[3];
+    const double det = a0 * a3 - a1 * a2;
+    const double r = 1.0 / det;
+    inverse[0] = a3 * r;
+    inverse[1] = -a1 * r;
+    inverse[2] = -a2 * r;
+    inverse[3] = a0 * r;
+}
+
+#endif
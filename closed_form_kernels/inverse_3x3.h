@@ -0,0 +1,38 @@
+// Generated by `inverse_closed_form --header 3`. Do not edit.
+#ifndef INVERSE_3X3_H
+#define INVERSE_3X3_H
+
+inline void inverse_3x3(const double* matrix, double* inverse)
+{
+    const double a0 = matrix[0];
+    const double a1 = matrix[1];
+    const double a2 = matrix[2];
+    const double a3 = matrix[3];
+    const double a4 = matrix[4];
+    const double a5 = matrix[5];
+    const double a6 = matrix[6];
+    const double a7 = matrix[7];
+    const double a8 = matrix[8];
+    const double m0 = a4 * a8 - a5 * a7;
+    const double m1 = a3 * a8 - a5 * a6;
+    const double m2 = a3 * a7 - a4 * a6;
+    const double m3 = a1 * a8 - a2 * a7;
+    const double m4 = a0 * a8 - a2 * a6;
+    const double m5 = a0 * a7 - a1 * a6;
+    const double m6 = a1 * a5 - a2 * a4;
+    const double m7 = a0 * a5 - a2 * a3;
+    const double m8 = a0 * a4 - a1 * a3;
+    const double det = a0 * m0 - a1 * m1 + a2 * m2;
+    const double r = 1.0 / det;
+    inverse[0] = m0 * r;
+    inverse[1] = -m3 * r;
+    inverse[2] = m6 * r;
+    inverse[3] = -m1 * r;
+    inverse[4] = m4 * r;
+    inverse[5] = -m7 * r;
+    inverse[6] = m2 * r;
+    inverse[7] = -m5 * r;
+    inverse[8] = m8 * r;
+}
+
+#endif
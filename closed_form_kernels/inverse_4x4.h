@@ -0,0 +1,77 @@
+// Generated by `inverse_closed_form --header 4`. Do not edit.
+#ifndef INVERSE_4X4_H
+#define INVERSE_4X4_H
+
+inline void inverse_4x4(const double* matrix, double* inverse)
+{
+    const double a0 = matrix[0];
+    const double a1 = matrix[1];
+    const double a2 = matrix[2];
+    const double a3 = matrix[3];
+    const double a4 = matrix[4];
+    const double a5 = matrix[5];
+    const double a6 = matrix[6];
+    const double a7 = matrix[7];
+    const double a8 = matrix[8];
+    const double a9 = matrix[9];
+    const double a10 = matrix[10];
+    const double a11 = matrix[11];
+    const double a12 = matrix[12];
+    const double a13 = matrix[13];
+    const double a14 = matrix[14];
+    const double a15 = matrix[15];
+    const double m0 = a10 * a15 - a11 * a14;
+    const double m1 = a9 * a15 - a11 * a13;
+    const double m2 = a9 * a14 - a10 * a13;
+    const double m3 = a5 * m0 - a6 * m1 + a7 * m2;
+    const double m4 = a8 * a15 - a11 * a12;
+    const double m5 = a8 * a14 - a10 * a12;
+    const double m6 = a4 * m0 - a6 * m4 + a7 * m5;
+    const double m7 = a8 * a13 - a9 * a12;
+    const double m8 = a4 * m1 - a5 * m4 + a7 * m7;
+    const double m9 = a4 * m2 - a5 * m5 + a6 * m7;
+    const double m10 = a1 * m0 - a2 * m1 + a3 * m2;
+    const double m11 = a0 * m0 - a2 * m4 + a3 * m5;
+    const double m12 = a0 * m1 - a1 * m4 + a3 * m7;
+    const double m13 = a0 * m2 - a1 * m5 + a2 * m7;
+    const double m14 = a6 * a15 - a7 * a14;
+    const double m15 = a5 * a15 - a7 * a13;
+    const double m16 = a5 * a14 - a6 * a13;
+    const double m17 = a1 * m14 - a2 * m15 + a3 * m16;
+    const double m18 = a4 * a15 - a7 * a12;
+    const double m19 = a4 * a14 - a6 * a12;
+    const double m20 = a0 * m14 - a2 * m18 + a3 * m19;
+    const double m21 = a4 * a13 - a5 * a12;
+    const double m22 = a0 * m15 - a1 * m18 + a3 * m21;
+    const double m23 = a0 * m16 - a1 * m19 + a2 * m21;
+    const double m24 = a6 * a11 - a7 * a10;
+    const double m25 = a5 * a11 - a7 * a9;
+    const double m26 = a5 * a10 - a6 * a9;
+    const double m27 = a1 * m24 - a2 * m25 + a3 * m26;
+    const double m28 = a4 * a11 - a7 * a8;
+    const double m29 = a4 * a10 - a6 * a8;
+    const double m30 = a0 * m24 - a2 * m28 + a3 * m29;
+    const double m31 = a4 * a9 - a5 * a8;
+    const double m32 = a0 * m25 - a1 * m28 + a3 * m31;
+    const double m33 = a0 * m26 - a1 * m29 + a2 * m31;
+    const double det = a0 * m3 - a1 * m6 + a2 * m8 - a3 * m9;
+    const double r = 1.0 / det;
+    inverse[0] = m3 * r;
+    inverse[1] = -m10 * r;
+    inverse[2] = m17 * r;
+    inverse[3] = -m27 * r;
+    inverse[4] = -m6 * r;
+    inverse[5] = m11 * r;
+    inverse[6] = -m20 * r;
+    inverse[7] = m30 * r;
+    inverse[8] = m8 * r;
+    inverse[9] = -m12 * r;
+    inverse[10] = m22 * r;
+    inverse[11] = -m32 * r;
+    inverse[12] = -m9 * r;
+    inverse[13] = m13 * r;
+    inverse[14] = -m23 * r;
+    inverse[15] = m33 * r;
+}
+
+#endif
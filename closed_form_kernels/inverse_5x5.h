@@ -0,0 +1,156 @@
+// Generated by `inverse_closed_form --header 5`. Do not edit.
+#ifndef INVERSE_5X5_H
+#define INVERSE_5X5_H
+
+inline void inverse_5x5(const double* matrix, double* inverse)
+{
+    const double a0 = matrix[0];
+    const double a1 = matrix[1];
+    const double a2 = matrix[2];
+    const double a3 = matrix[3];
+    const double a4 = matrix[4];
+    const double a5 = matrix[5];
+    const double a6 = matrix[6];
+    const double a7 = matrix[7];
+    const double a8 = matrix[8];
+    const double a9 = matrix[9];
+    const double a10 = matrix[10];
+    const double a11 = matrix[11];
+    const double a12 = matrix[12];
+    const double a13 = matrix[13];
+    const double a14 = matrix[14];
+    const double a15 = matrix[15];
+    const double a16 = matrix[16];
+    const double a17 = matrix[17];
+    const double a18 = matrix[18];
+    const double a19 = matrix[19];
+    const double a20 = matrix[20];
+    const double a21 = matrix[21];
+    const double a22 = matrix[22];
+    const double a23 = matrix[23];
+    const double a24 = matrix[24];
+    const double m0 = a18 * a24 - a19 * a23;
+    const double m1 = a17 * a24 - a19 * a22;
+    const double m2 = a17 * a23 - a18 * a22;
+    const double m3 = a12 * m0 - a13 * m1 + a14 * m2;
+    const double m4 = a16 * a24 - a19 * a21;
+    const double m5 = a16 * a23 - a18 * a21;
+    const double m6 = a11 * m0 - a13 * m4 + a14 * m5;
+    const double m7 = a16 * a22 - a17 * a21;
+    const double m8 = a11 * m1 - a12 * m4 + a14 * m7;
+    const double m9 = a11 * m2 - a12 * m5 + a13 * m7;
+    const double m10 = a6 * m3 - a7 * m6 + a8 * m8 - a9 * m9;
+    const double m11 = a15 * a24 - a19 * a20;
+    const double m12 = a15 * a23 - a18 * a20;
+    const double m13 = a10 * m0 - a13 * m11 + a14 * m12;
+    const double m14 = a15 * a22 - a17 * a20;
+    const double m15 = a10 * m1 - a12 * m11 + a14 * m14;
+    const double m16 = a10 * m2 - a12 * m12 + a13 * m14;
+    const double m17 = a5 * m3 - a7 * m13 + a8 * m15 - a9 * m16;
+    const double m18 = a15 * a21 - a16 * a20;
+    const double m19 = a10 * m4 - a11 * m11 + a14 * m18;
+    const double m20 = a10 * m5 - a11 * m12 + a13 * m18;
+    const double m21 = a5 * m6 - a6 * m13 + a8 * m19 - a9 * m20;
+    const double m22 = a10 * m7 - a11 * m14 + a12 * m18;
+    const double m23 = a5 * m8 - a6 * m15 + a7 * m19 - a9 * m22;
+    const double m24 = a5 * m9 - a6 * m16 + a7 * m20 - a8 * m22;
+    const double m25 = a1 * m3 - a2 * m6 + a3 * m8 - a4 * m9;
+    const double m26 = a0 * m3 - a2 * m13 + a3 * m15 - a4 * m16;
+    const double m27 = a0 * m6 - a1 * m13 + a3 * m19 - a4 * m20;
+    const double m28 = a0 * m8 - a1 * m15 + a2 * m19 - a4 * m22;
+    const double m29 = a0 * m9 - a1 * m16 + a2 * m20 - a3 * m22;
+    const double m30 = a7 * m0 - a8 * m1 + a9 * m2;
+    const double m31 = a6 * m0 - a8 * m4 + a9 * m5;
+    const double m32 = a6 * m1 - a7 * m4 + a9 * m7;
+    const double m33 = a6 * m2 - a7 * m5 + a8 * m7;
+    const double m34 = a1 * m30 - a2 * m31 + a3 * m32 - a4 * m33;
+    const double m35 = a5 * m0 - a8 * m11 + a9 * m12;
+    const double m36 = a5 * m1 - a7 * m11 + a9 * m14;
+    const double m37 = a5 * m2 - a7 * m12 + a8 * m14;
+    const double m38 = a0 * m30 - a2 * m35 + a3 * m36 - a4 * m37;
+    const double m39 = a5 * m4 - a6 * m11 + a9 * m18;
+    const double m40 = a5 * m5 - a6 * m12 + a8 * m18;
+    const double m41 = a0 * m31 - a1 * m35 + a3 * m39 - a4 * m40;
+    const double m42 = a5 * m7 - a6 * m14 + a7 * m18;
+    const double m43 = a0 * m32 - a1 * m36 + a2 * m39 - a4 * m42;
+    const double m44 = a0 * m33 - a1 * m37 + a2 * m40 - a3 * m42;
+    const double m45 = a13 * a24 - a14 * a23;
+    const double m46 = a12 * a24 - a14 * a22;
+    const double m47 = a12 * a23 - a13 * a22;
+    const double m48 = a7 * m45 - a8 * m46 + a9 * m47;
+    const double m49 = a11 * a24 - a14 * a21;
+    const double m50 = a11 * a23 - a13 * a21;
+    const double m51 = a6 * m45 - a8 * m49 + a9 * m50;
+    const double m52 = a11 * a22 - a12 * a21;
+    const double m53 = a6 * m46 - a7 * m49 + a9 * m52;
+    const double m54 = a6 * m47 - a7 * m50 + a8 * m52;
+    const double m55 = a1 * m48 - a2 * m51 + a3 * m53 - a4 * m54;
+    const double m56 = a10 * a24 - a14 * a20;
+    const double m57 = a10 * a23 - a13 * a20;
+    const double m58 = a5 * m45 - a8 * m56 + a9 * m57;
+    const double m59 = a10 * a22 - a12 * a20;
+    const double m60 = a5 * m46 - a7 * m56 + a9 * m59;
+    const double m61 = a5 * m47 - a7 * m57 + a8 * m59;
+    const double m62 = a0 * m48 - a2 * m58 + a3 * m60 - a4 * m61;
+    const double m63 = a10 * a21 - a11 * a20;
+    const double m64 = a5 * m49 - a6 * m56 + a9 * m63;
+    const double m65 = a5 * m50 - a6 * m57 + a8 * m63;
+    const double m66 = a0 * m51 - a1 * m58 + a3 * m64 - a4 * m65;
+    const double m67 = a5 * m52 - a6 * m59 + a7 * m63;
+    const double m68 = a0 * m53 - a1 * m60 + a2 * m64 - a4 * m67;
+    const double m69 = a0 * m54 - a1 * m61 + a2 * m65 - a3 * m67;
+    const double m70 = a13 * a19 - a14 * a18;
+    const double m71 = a12 * a19 - a14 * a17;
+    const double m72 = a12 * a18 - a13 * a17;
+    const double m73 = a7 * m70 - a8 * m71 + a9 * m72;
+    const double m74 = a11 * a19 - a14 * a16;
+    const double m75 = a11 * a18 - a13 * a16;
+    const double m76 = a6 * m70 - a8 * m74 + a9 * m75;
+    const double m77 = a11 * a17 - a12 * a16;
+    const double m78 = a6 * m71 - a7 * m74 + a9 * m77;
+    const double m79 = a6 * m72 - a7 * m75 + a8 * m77;
+    const double m80 = a1 * m73 - a2 * m76 + a3 * m78 - a4 * m79;
+    const double m81 = a10 * a19 - a14 * a15;
+    const double m82 = a10 * a18 - a13 * a15;
+    const double m83 = a5 * m70 - a8 * m81 + a9 * m82;
+    const double m84 = a10 * a17 - a12 * a15;
+    const double m85 = a5 * m71 - a7 * m81 + a9 * m84;
+    const double m86 = a5 * m72 - a7 * m82 + a8 * m84;
+    const double m87 = a0 * m73 - a2 * m83 + a3 * m85 - a4 * m86;
+    const double m88 = a10 * a16 - a11 * a15;
+    const double m89 = a5 * m74 - a6 * m81 + a9 * m88;
+    const double m90 = a5 * m75 - a6 * m82 + a8 * m88;
+    const double m91 = a0 * m76 - a1 * m83 + a3 * m89 - a4 * m90;
+    const double m92 = a5 * m77 - a6 * m84 + a7 * m88;
+    const double m93 = a0 * m78 - a1 * m85 + a2 * m89 - a4 * m92;
+    const double m94 = a0 * m79 - a1 * m86 + a2 * m90 - a3 * m92;
+    const double det = a0 * m10 - a1 * m17 + a2 * m21 - a3 * m23 + a4 * m24;
+    const double r = 1.0 / det;
+    inverse[0] = m10 * r;
+    inverse[1] = -m25 * r;
+    inverse[2] = m34 * r;
+    inverse[3] = -m55 * r;
+    inverse[4] = m80 * r;
+    inverse[5] = -m17 * r;
+    inverse[6] = m26 * r;
+    inverse[7] = -m38 * r;
+    inverse[8] = m62 * r;
+    inverse[9] = -m87 * r;
+    inverse[10] = m21 * r;
+    inverse[11] = -m27 * r;
+    inverse[12] = m41 * r;
+    inverse[13] = -m66 * r;
+    inverse[14] = m91 * r;
+    inverse[15] = -m23 * r;
+    inverse[16] = m28 * r;
+    inverse[17] = -m43 * r;
+    inverse[18] = m68 * r;
+    inverse[19] = -m93 * r;
+    inverse[20] = m24 * r;
+    inverse[21] = -m29 * r;
+    inverse[22] = m44 * r;
+    inverse[23] = -m69 * r;
+    inverse[24] = m94 * r;
+}
+
+#endif
@@ -0,0 +1,319 @@
+// Generated by `inverse_closed_form --header 6`. Do not edit.
+#ifndef INVERSE_6X6_H
+#define INVERSE_6X6_H
+
+inline void inverse_6x6(const double* matrix, double* inverse)
+{
+    const double a0 = matrix[0];
+    const double a1 = matrix[1];
+    const double a2 = matrix[2];
+    const double a3 = matrix[3];
+    const double a4 = matrix[4];
+    const double a5 = matrix[5];
+    const double a6 = matrix[6];
+    const double a7 = matrix[7];
+    const double a8 = matrix[8];
+    const double a9 = matrix[9];
+    const double a10 = matrix[10];
+    const double a11 = matrix[11];
+    const double a12 = matrix[12];
+    const double a13 = matrix[13];
+    const double a14 = matrix[14];
+    const double a15 = matrix[15];
+    const double a16 = matrix[16];
+    const double a17 = matrix[17];
+    const double a18 = matrix[18];
+    const double a19 = matrix[19];
+    const double a20 = matrix[20];
+    const double a21 = matrix[21];
+    const double a22 = matrix[22];
+    const double a23 = matrix[23];
+    const double a24 = matrix[24];
+    const double a25 = matrix[25];
+    const double a26 = matrix[26];
+    const double a27 = matrix[27];
+    const double a28 = matrix[28];
+    const double a29 = matrix[29];
+    const double a30 = matrix[30];
+    const double a31 = matrix[31];
+    const double a32 = matrix[32];
+    const double a33 = matrix[33];
+    const double a34 = matrix[34];
+    const double a35 = matrix[35];
+    const double m0 = a28 * a35 - a29 * a34;
+    const double m1 = a27 * a35 - a29 * a33;
+    const double m2 = a27 * a34 - a28 * a33;
+    const double m3 = a21 * m0 - a22 * m1 + a23 * m2;
+    const double m4 = a26 * a35 - a29 * a32;
+    const double m5 = a26 * a34 - a28 * a32;
+    const double m6 = a20 * m0 - a22 * m4 + a23 * m5;
+    const double m7 = a26 * a33 - a27 * a32;
+    const double m8 = a20 * m1 - a21 * m4 + a23 * m7;
+    const double m9 = a20 * m2 - a21 * m5 + a22 * m7;
+    const double m10 = a14 * m3 - a15 * m6 + a16 * m8 - a17 * m9;
+    const double m11 = a25 * a35 - a29 * a31;
+    const double m12 = a25 * a34 - a28 * a31;
+    const double m13 = a19 * m0 - a22 * m11 + a23 * m12;
+    const double m14 = a25 * a33 - a27 * a31;
+    const double m15 = a19 * m1 - a21 * m11 + a23 * m14;
+    const double m16 = a19 * m2 - a21 * m12 + a22 * m14;
+    const double m17 = a13 * m3 - a15 * m13 + a16 * m15 - a17 * m16;
+    const double m18 = a25 * a32 - a26 * a31;
+    const double m19 = a19 * m4 - a20 * m11 + a23 * m18;
+    const double m20 = a19 * m5 - a20 * m12 + a22 * m18;
+    const double m21 = a13 * m6 - a14 * m13 + a16 * m19 - a17 * m20;
+    const double m22 = a19 * m7 - a20 * m14 + a21 * m18;
+    const double m23 = a13 * m8 - a14 * m15 + a15 * m19 - a17 * m22;
+    const double m24 = a13 * m9 - a14 * m16 + a15 * m20 - a16 * m22;
+    const double m25 = a7 * m10 - a8 * m17 + a9 * m21 - a10 * m23 + a11 * m24;
+    const double m26 = a24 * a35 - a29 * a30;
+    const double m27 = a24 * a34 - a28 * a30;
+    const double m28 = a18 * m0 - a22 * m26 + a23 * m27;
+    const double m29 = a24 * a33 - a27 * a30;
+    const double m30 = a18 * m1 - a21 * m26 + a23 * m29;
+    const double m31 = a18 * m2 - a21 * m27 + a22 * m29;
+    const double m32 = a12 * m3 - a15 * m28 + a16 * m30 - a17 * m31;
+    const double m33 = a24 * a32 - a26 * a30;
+    const double m34 = a18 * m4 - a20 * m26 + a23 * m33;
+    const double m35 = a18 * m5 - a20 * m27 + a22 * m33;
+    const double m36 = a12 * m6 - a14 * m28 + a16 * m34 - a17 * m35;
+    const double m37 = a18 * m7 - a20 * m29 + a21 * m33;
+    const double m38 = a12 * m8 - a14 * m30 + a15 * m34 - a17 * m37;
+    const double m39 = a12 * m9 - a14 * m31 + a15 * m35 - a16 * m37;
+    const double m40 = a6 * m10 - a8 * m32 + a9 * m36 - a10 * m38 + a11 * m39;
+    const double m41 = a24 * a31 - a25 * a30;
+    const double m42 = a18 * m11 - a19 * m26 + a23 * m41;
+    const double m43 = a18 * m12 - a19 * m27 + a22 * m41;
+    const double m44 = a12 * m13 - a13 * m28 + a16 * m42 - a17 * m43;
+    const double m45 = a18 * m14 - a19 * m29 + a21 * m41;
+    const double m46 = a12 * m15 - a13 * m30 + a15 * m42 - a17 * m45;
+    const double m47 = a12 * m16 - a13 * m31 + a15 * m43 - a16 * m45;
+    const double m48 = a6 * m17 - a7 * m32 + a9 * m44 - a10 * m46 + a11 * m47;
+    const double m49 = a18 * m18 - a19 * m33 + a20 * m41;
+    const double m50 = a12 * m19 - a13 * m34 + a14 * m42 - a17 * m49;
+    const double m51 = a12 * m20 - a13 * m35 + a14 * m43 - a16 * m49;
+    const double m52 = a6 * m21 - a7 * m36 + a8 * m44 - a10 * m50 + a11 * m51;
+    const double m53 = a12 * m22 - a13 * m37 + a14 * m45 - a15 * m49;
+    const double m54 = a6 * m23 - a7 * m38 + a8 * m46 - a9 * m50 + a11 * m53;
+    const double m55 = a6 * m24 - a7 * m39 + a8 * m47 - a9 * m51 + a10 * m53;
+    const double m56 = a1 * m10 - a2 * m17 + a3 * m21 - a4 * m23 + a5 * m24;
+    const double m57 = a0 * m10 - a2 * m32 + a3 * m36 - a4 * m38 + a5 * m39;
+    const double m58 = a0 * m17 - a1 * m32 + a3 * m44 - a4 * m46 + a5 * m47;
+    const double m59 = a0 * m21 - a1 * m36 + a2 * m44 - a4 * m50 + a5 * m51;
+    const double m60 = a0 * m23 - a1 * m38 + a2 * m46 - a3 * m50 + a5 * m53;
+    const double m61 = a0 * m24 - a1 * m39 + a2 * m47 - a3 * m51 + a4 * m53;
+    const double m62 = a8 * m3 - a9 * m6 + a10 * m8 - a11 * m9;
+    const double m63 = a7 * m3 - a9 * m13 + a10 * m15 - a11 * m16;
+    const double m64 = a7 * m6 - a8 * m13 + a10 * m19 - a11 * m20;
+    const double m65 = a7 * m8 - a8 * m15 + a9 * m19 - a11 * m22;
+    const double m66 = a7 * m9 - a8 * m16 + a9 * m20 - a10 * m22;
+    const double m67 = a1 * m62 - a2 * m63 + a3 * m64 - a4 * m65 + a5 * m66;
+    const double m68 = a6 * m3 - a9 * m28 + a10 * m30 - a11 * m31;
+    const double m69 = a6 * m6 - a8 * m28 + a10 * m34 - a11 * m35;
+    const double m70 = a6 * m8 - a8 * m30 + a9 * m34 - a11 * m37;
+    const double m71 = a6 * m9 - a8 * m31 + a9 * m35 - a10 * m37;
+    const double m72 = a0 * m62 - a2 * m68 + a3 * m69 - a4 * m70 + a5 * m71;
+    const double m73 = a6 * m13 - a7 * m28 + a10 * m42 - a11 * m43;
+    const double m74 = a6 * m15 - a7 * m30 + a9 * m42 - a11 * m45;
+    const double m75 = a6 * m16 - a7 * m31 + a9 * m43 - a10 * m45;
+    const double m76 = a0 * m63 - a1 * m68 + a3 * m73 - a4 * m74 + a5 * m75;
+    const double m77 = a6 * m19 - a7 * m34 + a8 * m42 - a11 * m49;
+    const double m78 = a6 * m20 - a7 * m35 + a8 * m43 - a10 * m49;
+    const double m79 = a0 * m64 - a1 * m69 + a2 * m73 - a4 * m77 + a5 * m78;
+    const double m80 = a6 * m22 - a7 * m37 + a8 * m45 - a9 * m49;
+    const double m81 = a0 * m65 - a1 * m70 + a2 * m74 - a3 * m77 + a5 * m80;
+    const double m82 = a0 * m66 - a1 * m71 + a2 * m75 - a3 * m78 + a4 * m80;
+    const double m83 = a15 * m0 - a16 * m1 + a17 * m2;
+    const double m84 = a14 * m0 - a16 * m4 + a17 * m5;
+    const double m85 = a14 * m1 - a15 * m4 + a17 * m7;
+    const double m86 = a14 * m2 - a15 * m5 + a16 * m7;
+    const double m87 = a8 * m83 - a9 * m84 + a10 * m85 - a11 * m86;
+    const double m88 = a13 * m0 - a16 * m11 + a17 * m12;
+    const double m89 = a13 * m1 - a15 * m11 + a17 * m14;
+    const double m90 = a13 * m2 - a15 * m12 + a16 * m14;
+    const double m91 = a7 * m83 - a9 * m88 + a10 * m89 - a11 * m90;
+    const double m92 = a13 * m4 - a14 * m11 + a17 * m18;
+    const double m93 = a13 * m5 - a14 * m12 + a16 * m18;
+    const double m94 = a7 * m84 - a8 * m88 + a10 * m92 - a11 * m93;
+    const double m95 = a13 * m7 - a14 * m14 + a15 * m18;
+    const double m96 = a7 * m85 - a8 * m89 + a9 * m92 - a11 * m95;
+    const double m97 = a7 * m86 - a8 * m90 + a9 * m93 - a10 * m95;
+    const double m98 = a1 * m87 - a2 * m91 + a3 * m94 - a4 * m96 + a5 * m97;
+    const double m99 = a12 * m0 - a16 * m26 + a17 * m27;
+    const double m100 = a12 * m1 - a15 * m26 + a17 * m29;
+    const double m101 = a12 * m2 - a15 * m27 + a16 * m29;
+    const double m102 = a6 * m83 - a9 * m99 + a10 * m100 - a11 * m101;
+    const double m103 = a12 * m4 - a14 * m26 + a17 * m33;
+    const double m104 = a12 * m5 - a14 * m27 + a16 * m33;
+    const double m105 = a6 * m84 - a8 * m99 + a10 * m103 - a11 * m104;
+    const double m106 = a12 * m7 - a14 * m29 + a15 * m33;
+    const double m107 = a6 * m85 - a8 * m100 + a9 * m103 - a11 * m106;
+    const double m108 = a6 * m86 - a8 * m101 + a9 * m104 - a10 * m106;
+    const double m109 = a0 * m87 - a2 * m102 + a3 * m105 - a4 * m107 + a5 * m108;
+    const double m110 = a12 * m11 - a13 * m26 + a17 * m41;
+    const double m111 = a12 * m12 - a13 * m27 + a16 * m41;
+    const double m112 = a6 * m88 - a7 * m99 + a10 * m110 - a11 * m111;
+    const double m113 = a12 * m14 - a13 * m29 + a15 * m41;
+    const double m114 = a6 * m89 - a7 * m100 + a9 * m110 - a11 * m113;
+    const double m115 = a6 * m90 - a7 * m101 + a9 * m111 - a10 * m113;
+    const double m116 = a0 * m91 - a1 * m102 + a3 * m112 - a4 * m114 + a5 * m115;
+    const double m117 = a12 * m18 - a13 * m33 + a14 * m41;
+    const double m118 = a6 * m92 - a7 * m103 + a8 * m110 - a11 * m117;
+    const double m119 = a6 * m93 - a7 * m104 + a8 * m111 - a10 * m117;
+    const double m120 = a0 * m94 - a1 * m105 + a2 * m112 - a4 * m118 + a5 * m119;
+    const double m121 = a6 * m95 - a7 * m106 + a8 * m113 - a9 * m117;
+    const double m122 = a0 * m96 - a1 * m107 + a2 * m114 - a3 * m118 + a5 * m121;
+    const double m123 = a0 * m97 - a1 * m108 + a2 * m115 - a3 * m119 + a4 * m121;
+    const double m124 = a22 * a35 - a23 * a34;
+    const double m125 = a21 * a35 - a23 * a33;
+    const double m126 = a21 * a34 - a22 * a33;
+    const double m127 = a15 * m124 - a16 * m125 + a17 * m126;
+    const double m128 = a20 * a35 - a23 * a32;
+    const double m129 = a20 * a34 - a22 * a32;
+    const double m130 = a14 * m124 - a16 * m128 + a17 * m129;
+    const double m131 = a20 * a33 - a21 * a32;
+    const double m132 = a14 * m125 - a15 * m128 + a17 * m131;
+    const double m133 = a14 * m126 - a15 * m129 + a16 * m131;
+    const double m134 = a8 * m127 - a9 * m130 + a10 * m132 - a11 * m133;
+    const double m135 = a19 * a35 - a23 * a31;
+    const double m136 = a19 * a34 - a22 * a31;
+    const double m137 = a13 * m124 - a16 * m135 + a17 * m136;
+    const double m138 = a19 * a33 - a21 * a31;
+    const double m139 = a13 * m125 - a15 * m135 + a17 * m138;
+    const double m140 = a13 * m126 - a15 * m136 + a16 * m138;
+    const double m141 = a7 * m127 - a9 * m137 + a10 * m139 - a11 * m140;
+    const double m142 = a19 * a32 - a20 * a31;
+    const double m143 = a13 * m128 - a14 * m135 + a17 * m142;
+    const double m144 = a13 * m129 - a14 * m136 + a16 * m142;
+    const double m145 = a7 * m130 - a8 * m137 + a10 * m143 - a11 * m144;
+    const double m146 = a13 * m131 - a14 * m138 + a15 * m142;
+    const double m147 = a7 * m132 - a8 * m139 + a9 * m143 - a11 * m146;
+    const double m148 = a7 * m133 - a8 * m140 + a9 * m144 - a10 * m146;
+    const double m149 = a1 * m134 - a2 * m141 + a3 * m145 - a4 * m147 + a5 * m148;
+    const double m150 = a18 * a35 - a23 * a30;
+    const double m151 = a18 * a34 - a22 * a30;
+    const double m152 = a12 * m124 - a16 * m150 + a17 * m151;
+    const double m153 = a18 * a33 - a21 * a30;
+    const double m154 = a12 * m125 - a15 * m150 + a17 * m153;
+    const double m155 = a12 * m126 - a15 * m151 + a16 * m153;
+    const double m156 = a6 * m127 - a9 * m152 + a10 * m154 - a11 * m155;
+    const double m157 = a18 * a32 - a20 * a30;
+    const double m158 = a12 * m128 - a14 * m150 + a17 * m157;
+    const double m159 = a12 * m129 - a14 * m151 + a16 * m157;
+    const double m160 = a6 * m130 - a8 * m152 + a10 * m158 - a11 * m159;
+    const double m161 = a12 * m131 - a14 * m153 + a15 * m157;
+    const double m162 = a6 * m132 - a8 * m154 + a9 * m158 - a11 * m161;
+    const double m163 = a6 * m133 - a8 * m155 + a9 * m159 - a10 * m161;
+    const double m164 = a0 * m134 - a2 * m156 + a3 * m160 - a4 * m162 + a5 * m163;
+    const double m165 = a18 * a31 - a19 * a30;
+    const double m166 = a12 * m135 - a13 * m150 + a17 * m165;
+    const double m167 = a12 * m136 - a13 * m151 + a16 * m165;
+    const double m168 = a6 * m137 - a7 * m152 + a10 * m166 - a11 * m167;
+    const double m169 = a12 * m138 - a13 * m153 + a15 * m165;
+    const double m170 = a6 * m139 - a7 * m154 + a9 * m166 - a11 * m169;
+    const double m171 = a6 * m140 - a7 * m155 + a9 * m167 - a10 * m169;
+    const double m172 = a0 * m141 - a1 * m156 + a3 * m168 - a4 * m170 + a5 * m171;
+    const double m173 = a12 * m142 - a13 * m157 + a14 * m165;
+    const double m174 = a6 * m143 - a7 * m158 + a8 * m166 - a11 * m173;
+    const double m175 = a6 * m144 - a7 * m159 + a8 * m167 - a10 * m173;
+    const double m176 = a0 * m145 - a1 * m160 + a2 * m168 - a4 * m174 + a5 * m175;
+    const double m177 = a6 * m146 - a7 * m161 + a8 * m169 - a9 * m173;
+    const double m178 = a0 * m147 - a1 * m162 + a2 * m170 - a3 * m174 + a5 * m177;
+    const double m179 = a0 * m148 - a1 * m163 + a2 * m171 - a3 * m175 + a4 * m177;
+    const double m180 = a22 * a29 - a23 * a28;
+    const double m181 = a21 * a29 - a23 * a27;
+    const double m182 = a21 * a28 - a22 * a27;
+    const double m183 = a15 * m180 - a16 * m181 + a17 * m182;
+    const double m184 = a20 * a29 - a23 * a26;
+    const double m185 = a20 * a28 - a22 * a26;
+    const double m186 = a14 * m180 - a16 * m184 + a17 * m185;
+    const double m187 = a20 * a27 - a21 * a26;
+    const double m188 = a14 * m181 - a15 * m184 + a17 * m187;
+    const double m189 = a14 * m182 - a15 * m185 + a16 * m187;
+    const double m190 = a8 * m183 - a9 * m186 + a10 * m188 - a11 * m189;
+    const double m191 = a19 * a29 - a23 * a25;
+    const double m192 = a19 * a28 - a22 * a25;
+    const double m193 = a13 * m180 - a16 * m191 + a17 * m192;
+    const double m194 = a19 * a27 - a21 * a25;
+    const double m195 = a13 * m181 - a15 * m191 + a17 * m194;
+    const double m196 = a13 * m182 - a15 * m192 + a16 * m194;
+    const double m197 = a7 * m183 - a9 * m193 + a10 * m195 - a11 * m196;
+    const double m198 = a19 * a26 - a20 * a25;
+    const double m199 = a13 * m184 - a14 * m191 + a17 * m198;
+    const double m200 = a13 * m185 - a14 * m192 + a16 * m198;
+    const double m201 = a7 * m186 - a8 * m193 + a10 * m199 - a11 * m200;
+    const double m202 = a13 * m187 - a14 * m194 + a15 * m198;
+    const double m203 = a7 * m188 - a8 * m195 + a9 * m199 - a11 * m202;
+    const double m204 = a7 * m189 - a8 * m196 + a9 * m200 - a10 * m202;
+    const double m205 = a1 * m190 - a2 * m197 + a3 * m201 - a4 * m203 + a5 * m204;
+    const double m206 = a18 * a29 - a23 * a24;
+    const double m207 = a18 * a28 - a22 * a24;
+    const double m208 = a12 * m180 - a16 * m206 + a17 * m207;
+    const double m209 = a18 * a27 - a21 * a24;
+    const double m210 = a12 * m181 - a15 * m206 + a17 * m209;
+    const double m211 = a12 * m182 - a15 * m207 + a16 * m209;
+    const double m212 = a6 * m183 - a9 * m208 + a10 * m210 - a11 * m211;
+    const double m213 = a18 * a26 - a20 * a24;
+    const double m214 = a12 * m184 - a14 * m206 + a17 * m213;
+    const double m215 = a12 * m185 - a14 * m207 + a16 * m213;
+    const double m216 = a6 * m186 - a8 * m208 + a10 * m214 - a11 * m215;
+    const double m217 = a12 * m187 - a14 * m209 + a15 * m213;
+    const double m218 = a6 * m188 - a8 * m210 + a9 * m214 - a11 * m217;
+    const double m219 = a6 * m189 - a8 * m211 + a9 * m215 - a10 * m217;
+    const double m220 = a0 * m190 - a2 * m212 + a3 * m216 - a4 * m218 + a5 * m219;
+    const double m221 = a18 * a25 - a19 * a24;
+    const double m222 = a12 * m191 - a13 * m206 + a17 * m221;
+    const double m223 = a12 * m192 - a13 * m207 + a16 * m221;
+    const double m224 = a6 * m193 - a7 * m208 + a10 * m222 - a11 * m223;
+    const double m225 = a12 * m194 - a13 * m209 + a15 * m221;
+    const double m226 = a6 * m195 - a7 * m210 + a9 * m222 - a11 * m225;
+    const double m227 = a6 * m196 - a7 * m211 + a9 * m223 - a10 * m225;
+    const double m228 = a0 * m197 - a1 * m212 + a3 * m224 - a4 * m226 + a5 * m227;
+    const double m229 = a12 * m198 - a13 * m213 + a14 * m221;
+    const double m230 = a6 * m199 - a7 * m214 + a8 * m222 - a11 * m229;
+    const double m231 = a6 * m200 - a7 * m215 + a8 * m223 - a10 * m229;
+    const double m232 = a0 * m201 - a1 * m216 + a2 * m224 - a4 * m230 + a5 * m231;
+    const double m233 = a6 * m202 - a7 * m217 + a8 * m225 - a9 * m229;
+    const double m234 = a0 * m203 - a1 * m218 + a2 * m226 - a3 * m230 + a5 * m233;
+    const double m235 = a0 * m204 - a1 * m219 + a2 * m227 - a3 * m231 + a4 * m233;
+    const double det = a0 * m25 - a1 * m40 + a2 * m48 - a3 * m52 + a4 * m54 - a5 * m55;
+    const double r = 1.0 / det;
+    inverse[0] = m25 * r;
+    inverse[1] = -m56 * r;
+    inverse[2] = m67 * r;
+    inverse[3] = -m98 * r;
+    inverse[4] = m149 * r;
+    inverse[5] = -m205 * r;
+    inverse[6] = -m40 * r;
+    inverse[7] = m57 * r;
+    inverse[8] = -m72 * r;
+    inverse[9] = m109 * r;
+    inverse[10] = -m164 * r;
+    inverse[11] = m220 * r;
+    inverse[12] = m48 * r;
+    inverse[13] = -m58 * r;
+    inverse[14] = m76 * r;
+    inverse[15] = -m116 * r;
+    inverse[16] = m172 * r;
+    inverse[17] = -m228 * r;
+    inverse[18] = -m52 * r;
+    inverse[19] = m59 * r;
+    inverse[20] = -m79 * r;
+    inverse[21] = m120 * r;
+    inverse[22] = -m176 * r;
+    inverse[23] = m232 * r;
+    inverse[24] = m54 * r;
+    inverse[25] = -m60 * r;
+    inverse[26] = m81 * r;
+    inverse[27] = -m122 * r;
+    inverse[28] = m178 * r;
+    inverse[29] = -m234 * r;
+    inverse[30] = -m55 * r;
+    inverse[31] = m61 * r;
+    inverse[32] = -m82 * r;
+    inverse[33] = m123 * r;
+    inverse[34] = -m179 * r;
+    inverse[35] = m235 * r;
+}
+
+#endif
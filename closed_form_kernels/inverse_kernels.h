@@ -0,0 +1,25 @@
+/*
+Straight-line inverse kernels for small fixed sizes, generated from the closed-form
+formulas by inverse_closed_form.cpp:
+
+    g++ -O2 -pthread inverse_closed_form.cpp -o inverse_closed_form
+    for n in 2 3 4 5 6; do ./inverse_closed_form --header $n > closed_form_kernels/inverse_${n}x${n}.h; done
+
+Each header defines inline void inverse_NxN(const double* matrix, double* inverse), which
+computes every shared minor once and divides the adjugate by the determinant. There is no
+pivoting and no singularity check (a singular matrix gives inf/nan), so these are meant
+for hot loops over well-conditioned small matrices.
+
+Author: Evan Lauer
+*/
+
+#ifndef INVERSE_KERNELS_H
+#define INVERSE_KERNELS_H
+
+#include "inverse_2x2.h"
+#include "inverse_3x3.h"
+#include "inverse_4x4.h"
+#include "inverse_5x5.h"
+#include "inverse_6x6.h"
+
+#endif
@@ -0,0 +1,182 @@
+/*
+Exact inverse and determinant of integer and rational matrices.
+
+The floating point engines decide singularity by comparing a rounded determinant with
+zero, so a nearly singular integer matrix can be called singular (or a singular one
+invertible), and every entry of the inverse carries rounding error. Here every value
+is a BigInt or Rational (bigint.h) and the result is exact.
+
+Each row i of A is first multiplied by the least common multiple s_i of its
+denominators, giving an integer matrix B = SA with S = diag(s_i). Fraction-free
+Gauss-Jordan elimination (Bareiss) on [B | S] then keeps every intermediate value an
+integer: step k updates
+
+    M[i][j] = (M[k][k] * M[i][j] - M[i][k] * M[k][j]) / (previous pivot)
+
+for every row i other than k, and the division is always exact. At the end the left
+half is D * I, where D = ±det(B), and the right half is D * B^-1 * S = D * A^-1. The
+entries are minors of B, so they only grow linearly with n, not exponentially as in
+naive integer elimination.
+
+Work is O(n^3) operations on numbers of O(n) digits. The rows of each step are
+updated in parallel on the thread pool (thread_pool.h).
+
+Author: Evan Lauer
+*/
+
+#ifndef EXACT_INVERSE_H
+#define EXACT_INVERSE_H
+
+#include <vector>
+
+#include "bigint.h"
+#include "thread_pool.h"
+
+using namespace std;
+
+/**
+ * @brief Least common multiple of the denominators of row `row` of a.
+ *
+ */
+BigInt exact_row_scale(const Rational* a, int n, int row)
+{
+    BigInt scale(1);
+    for (int j = 0; j < n; ++j)
+    {
+        const BigInt& den = a[(size_t)row * n + j].den;
+        if (den.limbs.empty() && den.small == 1) continue;
+        scale = scale / bigint_gcd(scale, den) * den;
+    }
+    return scale;
+}
+
+/**
+ * @brief Fraction-free Gauss-Jordan elimination on `m`, n rows of `width` >= n integers.
+ * On return the first n columns are pivot * I and the other columns are scaled to
+ * match. `sign` is -1 if an odd number of rows were swapped.
+ *
+ * @return int 0, or 1 if the first n columns are singular.
+ */
+int exact_eliminate(vector<BigInt>& m, int n, int width, BigInt& pivot, int& sign)
+{
+    BigInt previous(1);
+    sign = 1;
+    for (int k = 0; k < n; ++k)
+    {
+        int p = k;
+        while (p < n && bigint_is_zero(m[(size_t)p * width + k])) ++p;
+        if (p == n) return 1;
+        if (p != k)
+        {
+            for (int j = 0; j < width; ++j) swap(m[(size_t)p * width + j], m[(size_t)k * width + j]);
+            sign = -sign;
+        }
+        const BigInt* pivot_row = &m[(size_t)k * width];
+        const BigInt pk = pivot_row[k];
+        parallel_for(0, n, 4, [&](int begin, int end) {
+            for (int i = begin; i < end; ++i)
+            {
+                if (i == k) continue;
+                BigInt* row = &m[(size_t)i * width];
+                const BigInt factor = row[k];
+                bool eliminated = bigint_is_zero(factor);
+                for (int j = k + 1; j < width; ++j)
+                {
+                    BigInt value = eliminated ? pk * row[j] : pk * row[j] - factor * pivot_row[j];
+                    row[j] = value / previous; // exact
+                }
+                row[k] = BigInt(0);
+                if (i < k) row[i] = pk; // the diagonal of finished rows was `previous`
+            }
+        });
+        previous = pk;
+    }
+    pivot = previous;
+    return 0;
+}
+
+/**
+ * @brief Exact inverse of a (n x n, row-major) as integers over one common denominator,
+ * A^-1 = numerators / denominator, not reduced to lowest terms. Cheaper than
+ * exact_inverse() when the entries are only wanted as doubles
+ * (bigint_ratio_to_double()).
+ *
+ * @param a const Rational*
+ * @param n int
+ * @param numerators BigInt*  n x n, row-major
+ * @param denominator BigInt&  Not zero, but may be negative
+ * @return int 0, or 1 if a is singular (the outputs are then unchanged).
+ */
+int exact_inverse_scaled(const Rational* a, int n, BigInt* numerators, BigInt& denominator)
+{
+    int width = 2 * n;
+    vector<BigInt> m((size_t)n * width);
+    for (int i = 0; i < n; ++i)
+    {
+        BigInt scale = exact_row_scale(a, n, i);
+        for (int j = 0; j < n; ++j)
+        {
+            const Rational& entry = a[(size_t)i * n + j];
+            m[(size_t)i * width + j] = entry.num * (scale / entry.den);
+        }
+        m[(size_t)i * width + n + i] = scale;
+    }
+    BigInt pivot;
+    int sign;
+    if (exact_eliminate(m, n, width, pivot, sign)) return 1;
+    for (int i = 0; i < n; ++i)
+    {
+        for (int j = 0; j < n; ++j) numerators[(size_t)i * n + j] = m[(size_t)i * width + n + j];
+    }
+    denominator = pivot;
+    return 0;
+}
+
+/**
+ * @brief Exact inverse of a (n x n, row-major) into x, in lowest terms.
+ *
+ * @param a const Rational*
+ * @param n int
+ * @param x Rational*  n x n, row-major
+ * @return int 0, or 1 if a is singular (x is then unchanged).
+ */
+int exact_inverse(const Rational* a, int n, Rational* x)
+{
+    vector<BigInt> numerators((size_t)n * n);
+    BigInt denominator;
+    if (exact_inverse_scaled(a, n, numerators.data(), denominator)) return 1;
+    parallel_for(0, n, 4, [&](int begin, int end) {
+        for (int i = begin; i < end; ++i)
+        {
+            for (int j = 0; j < n; ++j) x[(size_t)i * n + j] = rational(numerators[(size_t)i * n + j], denominator);
+        }
+    });
+    return 0;
+}
+
+/**
+ * @brief Exact determinant of a (n x n, row-major); zero exactly when a is singular.
+ *
+ */
+Rational exact_determinant(const Rational* a, int n)
+{
+    if (n == 0) return rational(BigInt(1), BigInt(1));
+    vector<BigInt> m((size_t)n * n);
+    BigInt scales(1);
+    for (int i = 0; i < n; ++i)
+    {
+        BigInt scale = exact_row_scale(a, n, i);
+        for (int j = 0; j < n; ++j)
+        {
+            const Rational& entry = a[(size_t)i * n + j];
+            m[(size_t)i * n + j] = entry.num * (scale / entry.den);
+        }
+        scales = scales * scale;
+    }
+    BigInt pivot;
+    int sign;
+    if (exact_eliminate(m, n, n, pivot, sign)) return Rational();
+    return rational(sign < 0 ? -pivot : pivot, scales); // det(A) = det(SA) / det(S)
+}
+
+#endif
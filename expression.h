@@ -0,0 +1,247 @@
+/*
+Compact closed-form expressions shared by inverse_closed_form.cpp and matrix_inverse_web.cpp.
+
+A closed-form determinant is a sum of signed products of matrix entries. Instead of
+text such as "(11*22-12*21)", entries are interned once as small integer ids in a
+VariableTable, and polynomials are stored back to back in a PolynomialArena: one flat
+array of variable ids (degree ids per term) and one flat array of coefficients (one per
+term). A term of a 9 x 9 determinant takes 9 ids, 18 bytes with the 2-byte VariableId,
+instead of a heap string per entry, and evaluating or hashing a polynomial is a walk
+over two arrays.
+
+Text is only produced on request, by render_polynomial().
+
+Author: Evan Lauer
+*/
+
+#ifndef EXPRESSION_H
+#define EXPRESSION_H
+
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+
+using namespace std;
+
+typedef unsigned short VariableId;
+
+/**
+ * @brief Interned variable names. Each distinct name is stored once; expressions refer
+ * to it by its id, which is its position in `names`.
+ *
+ */
+class VariableTable
+{
+    public:
+    vector<string> names;
+    unordered_map<string, VariableId> ids;
+};
+
+/**
+ * @brief Returns the id of `name`, adding it to the table the first time it is seen.
+ *
+ * @param table VariableTable*
+ * @param name const string&
+ * @return VariableId
+ */
+VariableId intern_variable(VariableTable* table, const string& name)
+{
+    unordered_map<string, VariableId>::iterator found = table->ids.find(name);
+    if (found != table->ids.end()) return found->second;
+    VariableId id = (VariableId)table->names.size();
+    table->names.push_back(name);
+    table->ids[name] = id;
+    return id;
+}
+
+/**
+ * @brief One polynomial in an arena: term_count terms, each the product of `degree`
+ * variables times an integer coefficient. Its coefficients start at first_term and its
+ * variable ids at first_variable.
+ *
+ */
+class Polynomial
+{
+    public:
+    int degree;
+    size_t first_term;
+    size_t first_variable;
+    size_t term_count;
+};
+
+/**
+ * @brief Storage for many polynomials. Terms are only ever appended to the last
+ * polynomial, so the arena can also be used as a stack: build the parts of an
+ * expression, combine them into a new polynomial, then drop the parts with
+ * polynomial_collapse().
+ *
+ */
+class PolynomialArena
+{
+    public:
+    vector<VariableId> variables; // degree ids per term, terms in order
+    vector<int> coefficients; // one per term
+    vector<Polynomial> polynomials;
+};
+
+/**
+ * @brief Starts a new, empty polynomial at the end of the arena and returns its id.
+ *
+ * @param arena PolynomialArena*
+ * @param degree int  Number of variables in every term
+ * @return int
+ */
+int polynomial_begin(PolynomialArena* arena, int degree)
+{
+    Polynomial polynomial;
+    polynomial.degree = degree;
+    polynomial.first_term = arena->coefficients.size();
+    polynomial.first_variable = arena->variables.size();
+    polynomial.term_count = 0;
+    arena->polynomials.push_back(polynomial);
+    return (int)arena->polynomials.size() - 1;
+}
+
+/**
+ * @brief Appends coefficient * term[0] * ... * term[degree - 1] to the last polynomial.
+ *
+ */
+void polynomial_add_term(PolynomialArena* arena, int coefficient, const VariableId* term)
+{
+    Polynomial& polynomial = arena->polynomials.back();
+    arena->variables.insert(arena->variables.end(), term, term + polynomial.degree);
+    arena->coefficients.push_back(coefficient);
+    polynomial.term_count++;
+}
+
+/**
+ * @brief Appends coefficient * variable * (every term of polynomial `source`) to the
+ * last polynomial, whose degree must be one more than the source's. This is one step
+ * of a cofactor expansion.
+ *
+ */
+void polynomial_add_product(PolynomialArena* arena, int coefficient, VariableId variable, int source)
+{
+    Polynomial from = arena->polynomials[source];
+    size_t terms = from.term_count;
+    int degree = from.degree;
+    arena->variables.reserve(arena->variables.size() + terms * (degree + 1));
+    for (size_t t = 0; t < terms; ++t)
+    {
+        arena->variables.push_back(variable);
+        size_t term = from.first_variable + t * degree;
+        for (int d = 0; d < degree; ++d) arena->variables.push_back(arena->variables[term + d]); // capacity reserved above
+        arena->coefficients.push_back(coefficient * arena->coefficients[from.first_term + t]);
+    }
+    arena->polynomials.back().term_count += terms;
+}
+
+/**
+ * @brief Copies polynomial `id` of another arena to the end of this one and returns its
+ * new id. Lets polynomials built separately (e.g. on different threads) be gathered
+ * into one arena in a fixed order.
+ *
+ */
+int polynomial_append(PolynomialArena* arena, const PolynomialArena* source, int id)
+{
+    const Polynomial& from = source->polynomials[id];
+    int copy = polynomial_begin(arena, from.degree);
+    const VariableId* variables = source->variables.data() + from.first_variable;
+    const int* coefficients = source->coefficients.data() + from.first_term;
+    arena->variables.insert(arena->variables.end(), variables, variables + from.term_count * from.degree);
+    arena->coefficients.insert(arena->coefficients.end(), coefficients, coefficients + from.term_count);
+    arena->polynomials.back().term_count = from.term_count;
+    return copy;
+}
+
+/**
+ * @brief Moves the last polynomial down to id `keep`, discarding every polynomial from
+ * `keep` up to it, and returns `keep`. Polynomials are stored in id order, so this
+ * frees the space they used.
+ *
+ */
+int polynomial_collapse(PolynomialArena* arena, int keep)
+{
+    Polynomial last = arena->polynomials.back();
+    const Polynomial& target = arena->polynomials[keep];
+    size_t first_term = target.first_term;
+    size_t first_variable = target.first_variable;
+    size_t variable_count = last.term_count * last.degree;
+    memmove(arena->variables.data() + first_variable, arena->variables.data() + last.first_variable, variable_count * sizeof(VariableId));
+    memmove(arena->coefficients.data() + first_term, arena->coefficients.data() + last.first_term, last.term_count * sizeof(int));
+    arena->variables.resize(first_variable + variable_count);
+    arena->coefficients.resize(first_term + last.term_count);
+    last.first_term = first_term;
+    last.first_variable = first_variable;
+    arena->polynomials.resize(keep + 1);
+    arena->polynomials[keep] = last;
+    return keep;
+}
+
+/**
+ * @brief Variable ids of term t of polynomial `id`.
+ *
+ */
+const VariableId* polynomial_term(const PolynomialArena* arena, int id, size_t t)
+{
+    const Polynomial& polynomial = arena->polynomials[id];
+    return arena->variables.data() + polynomial.first_variable + t * polynomial.degree;
+}
+
+/**
+ * @brief Evaluates polynomial `id` with variable v set to values[v].
+ *
+ * @return double
+ */
+double evaluate_polynomial(const PolynomialArena* arena, int id, const double* values)
+{
+    const Polynomial& polynomial = arena->polynomials[id];
+    double sum = 0;
+    for (size_t t = 0; t < polynomial.term_count; ++t)
+    {
+        const VariableId* term = polynomial_term(arena, id, t);
+        double product = arena->coefficients[polynomial.first_term + t];
+        for (int d = 0; d < polynomial.degree; ++d) product *= values[term[d]];
+        sum += product;
+    }
+    return sum;
+}
+
+/**
+ * @brief Appends polynomial `id` as text, e.g. "11*22-12*21", with variables named
+ * from the table. The empty polynomial is written "0".
+ *
+ * @param arena const PolynomialArena*
+ * @param id int
+ * @param table const VariableTable*
+ * @param out string&
+ */
+void render_polynomial(const PolynomialArena* arena, int id, const VariableTable* table, string& out)
+{
+    const Polynomial& polynomial = arena->polynomials[id];
+    if (polynomial.term_count == 0) { out += "0"; return; }
+    for (size_t t = 0; t < polynomial.term_count; ++t)
+    {
+        int coefficient = arena->coefficients[polynomial.first_term + t];
+        if (coefficient < 0) out += "-";
+        else if (t != 0) out += "+";
+        bool written = false;
+        if (abs(coefficient) != 1 || polynomial.degree == 0)
+        {
+            out += to_string(abs(coefficient));
+            written = true;
+        }
+        const VariableId* term = polynomial_term(arena, id, t);
+        for (int d = 0; d < polynomial.degree; ++d)
+        {
+            if (written) out += "*";
+            out += table->names[term[d]];
+            written = true;
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,264 @@
+/*
+An on-disk cache of closed-form formulas, used by inverse_closed_form.cpp.
+
+A formula depends only on what was asked for (e.g. "the inverse of an 11 x 11 matrix")
+and on the generator version, so each one is stored once under a name derived from
+that key: the file for key K is <directory>/<64-bit FNV-1a hash of K in hex>.formula.
+A file holds a short header (magic, key, text length) followed by the formula text
+and a terminating NUL, so a reader can memory-map it and hand out the text as a
+C string without copying or parsing anything.
+
+New files are written to a temporary name and renamed into place, so readers never
+see a partial file, and several processes can share one directory.
+
+Author: Evan Lauer
+*/
+
+#ifndef FORMULA_CACHE_H
+#define FORMULA_CACHE_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <mutex>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "formula_sink.h"
+
+using namespace std;
+
+// Bump when the file layout changes; files with another magic are ignored.
+const char FORMULA_CACHE_MAGIC[8] = { 'M', 'I', 'F', 'O', 'R', 'M', '0', '1' };
+
+/**
+ * @brief A cached formula mapped into memory. `text` is NUL-terminated and stays valid
+ * for the life of the process.
+ *
+ */
+class MappedFormula
+{
+    public:
+    const char* text;
+    size_t length;
+    void* mapping; // the whole file
+    size_t mapping_length;
+};
+
+/**
+ * @brief One cache directory and the formulas mapped from it so far. An empty
+ * directory disables the cache.
+ *
+ */
+class FormulaCache
+{
+    public:
+    string directory;
+    unordered_map<string, MappedFormula> mapped; // key -> mapping, all from `directory`
+    vector<unordered_map<string, MappedFormula>> retired; // from earlier directories; never looked up, never unmapped
+    mutex lock;
+};
+
+/**
+ * @brief 64-bit FNV-1a hash, used to name cache files.
+ *
+ */
+uint64_t formula_cache_hash(const string& key)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (unsigned char c : key)
+    {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+string formula_cache_path(FormulaCache* cache, const string& key)
+{
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.formula", (unsigned long long)formula_cache_hash(key));
+    return cache->directory + "/" + name;
+}
+
+/**
+ * @brief Maps the cache file at `path` and checks its header. On success returns true
+ * and fills in the key it was stored under and the mapped text.
+ *
+ */
+bool formula_cache_map_file(const string& path, string& key, MappedFormula& formula)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat info;
+    bool valid = fstat(fd, &info) == 0 && info.st_size >= 20;
+    void* mapping = valid ? mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+    close(fd); // the mapping keeps the file open
+    if (mapping == MAP_FAILED) return false;
+
+    const char* data = (const char*)mapping;
+    size_t size = info.st_size;
+    uint32_t key_length;
+    uint64_t text_length;
+    memcpy(&key_length, data + 8, sizeof(key_length));
+    memcpy(&text_length, data + 12, sizeof(text_length));
+    size_t text_offset = 20 + (size_t)key_length;
+    valid = memcmp(data, FORMULA_CACHE_MAGIC, 8) == 0 && text_offset < size && text_length == size - text_offset - 1
+            && data[size - 1] == '\0';
+    if (!valid)
+    {
+        munmap(mapping, size);
+        return false;
+    }
+    key.assign(data + 20, key_length);
+    formula.text = data + text_offset;
+    formula.length = text_length;
+    formula.mapping = mapping;
+    formula.mapping_length = size;
+    return true;
+}
+
+/**
+ * @brief Returns the cached formula for `key`, mapping its file on first use, or
+ * nullptr if there is none.
+ *
+ * @param cache FormulaCache*
+ * @param key const string&
+ * @return const MappedFormula*
+ */
+const MappedFormula* formula_cache_find(FormulaCache* cache, const string& key)
+{
+    lock_guard<mutex> guard(cache->lock);
+    if (cache->directory.empty()) return nullptr;
+    unordered_map<string, MappedFormula>::iterator found = cache->mapped.find(key);
+    if (found != cache->mapped.end()) return &found->second;
+
+    string stored_key;
+    MappedFormula formula;
+    if (!formula_cache_map_file(formula_cache_path(cache, key), stored_key, formula)) return nullptr;
+    if (stored_key != key) // two keys with the same hash; treat as a miss
+    {
+        munmap(formula.mapping, formula.mapping_length);
+        return nullptr;
+    }
+    return &(cache->mapped[key] = formula);
+}
+
+/**
+ * @brief Sink that writes to a file and counts what it wrote.
+ *
+ */
+class CountingFdSink : public FdSink
+{
+    public:
+    size_t written;
+
+    CountingFdSink(int _fd) : FdSink(_fd) { written = 0; }
+
+    protected:
+    void flush(const char* data, size_t length)
+    {
+        FdSink::flush(data, length);
+        written += length;
+    }
+};
+
+/**
+ * @brief Returns the cached formula for `key`, first generating it into the cache if
+ * it is not there. `generate` writes the text to the sink it is given (and calls
+ * finish()). Returns nullptr if the cache is disabled or the file could not be written.
+ *
+ * @param cache FormulaCache*
+ * @param key const string&
+ * @param generate function<void(FormulaSink&)>
+ * @return const MappedFormula*
+ */
+const MappedFormula* formula_cache_get(FormulaCache* cache, const string& key, const function<void(FormulaSink&)>& generate)
+{
+    const MappedFormula* found = formula_cache_find(cache, key);
+    if (found || cache->directory.empty()) return found;
+
+    string path = formula_cache_path(cache, key);
+    static atomic<int> writes(0); // keeps temporary names unique between threads
+    string temporary = path + ".tmp" + to_string(getpid()) + "." + to_string(writes++);
+    int fd = open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return nullptr;
+
+    uint32_t key_length = (uint32_t)key.size();
+    uint64_t text_length = 0; // filled in once the text is written
+    char header[20];
+    memcpy(header, FORMULA_CACHE_MAGIC, 8);
+    memcpy(header + 8, &key_length, sizeof(key_length));
+    memcpy(header + 12, &text_length, sizeof(text_length));
+    CountingFdSink sink(fd);
+    sink.write(header, sizeof(header));
+    sink.write(key);
+    sink.finish();
+    size_t text_offset = sink.written;
+    generate(sink);
+    sink.write("\0", 1);
+    sink.finish();
+    text_length = sink.written - text_offset - 1;
+    bool failed = sink.failed || pwrite(fd, &text_length, sizeof(text_length), 12) != (ssize_t)sizeof(text_length);
+    if (close(fd) != 0) failed = true;
+    if (failed || rename(temporary.c_str(), path.c_str()) != 0)
+    {
+        unlink(temporary.c_str());
+        return nullptr;
+    }
+    return formula_cache_find(cache, key);
+}
+
+/**
+ * @brief Points the cache at `directory` (created if missing) and maps every formula
+ * already stored there, so later requests are answered from memory. Formulas mapped from
+ * a different, earlier directory are no longer found (they stay mapped, as they may
+ * have been handed out). Returns the number of formulas mapped, or -1 if the directory
+ * cannot be used (the cache is then unchanged).
+ *
+ * @param cache FormulaCache*
+ * @param directory const string&
+ * @return int
+ */
+int formula_cache_warm_start(FormulaCache* cache, const string& directory)
+{
+    mkdir(directory.c_str(), 0755);
+    DIR* listing = opendir(directory.c_str());
+    if (!listing) return -1;
+    lock_guard<mutex> guard(cache->lock);
+    if (directory != cache->directory)
+    {
+        cache->retired.push_back(move(cache->mapped)); // moved whole, so handed-out MappedFormula pointers stay valid
+        cache->mapped.clear();
+        cache->directory = directory;
+    }
+    int count = 0;
+    while (dirent* entry = readdir(listing))
+    {
+        string name = entry->d_name;
+        const string suffix = ".formula";
+        if (name.size() <= suffix.size() || name.compare(name.size() - suffix.size(), suffix.size(), suffix) != 0) continue;
+        string key;
+        MappedFormula formula;
+        if (!formula_cache_map_file(directory + "/" + name, key, formula)) continue;
+        if (cache->mapped.count(key)) // already mapped, and handed-out text must stay valid
+        {
+            munmap(formula.mapping, formula.mapping_length);
+            continue;
+        }
+        cache->mapped[key] = formula;
+        ++count;
+    }
+    closedir(listing);
+    return count;
+}
+
+#endif
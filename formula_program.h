@@ -0,0 +1,278 @@
+/*
+Compiled closed-form formulas, evaluated over many inputs at once.
+
+A closed-form result (e.g. the cofactor DAG of inverse_closed_form.cpp) is compiled
+once into a FormulaProgram: a short list of register instructions such as
+r5 = r1 * r2 or r5 -= r3 * r4. Registers 0 to input_count - 1 hold the inputs (the
+matrix entries) and the next ones hold constants; every other register is a
+temporary, reused as soon as its value is dead, so even large programs need few
+registers.
+
+evaluate_formula_program() runs a program over a batch stored structure-of-arrays,
+the same layout as matrix_inverse_batch(): input k of item b at inputs[k * count + b].
+Each register holds FORMULA_PROGRAM_LANES items, so every instruction works on a whole
+tile of the batch with SIMD instructions (AVX-512, AVX2 or SSE2/WASM, chosen at run
+time), and the cost of decoding an instruction is shared by all of them. Tiles are
+spread over the thread pool (thread_pool.h).
+
+Author: Evan Lauer
+*/
+
+#ifndef FORMULA_PROGRAM_H
+#define FORMULA_PROGRAM_H
+
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+
+#include "thread_pool.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define FORMULA_PROGRAM_X86 1
+#endif
+
+using namespace std;
+
+const int FORMULA_OP_MUL = 0;     // r[dst] = r[a] * r[b]
+const int FORMULA_OP_NEG_MUL = 1; // r[dst] = -(r[a] * r[b])
+const int FORMULA_OP_MUL_ADD = 2; // r[dst] += r[a] * r[b]
+const int FORMULA_OP_MUL_SUB = 3; // r[dst] -= r[a] * r[b]
+const int FORMULA_OP_DIVIDE = 4;  // r[dst] = r[a] / r[b]
+
+// Items evaluated together by one pass over a program: four AVX-512 registers, eight
+// AVX2 registers or sixteen SSE2 registers per program register. Wider tiles share the
+// decoding of each instruction among more items; the 8 x 8 inverse then needs about
+// 80 KB of registers per thread.
+const int FORMULA_PROGRAM_LANES = 32;
+
+class FormulaInstruction
+{
+    public:
+    int op;
+    int dst;
+    int a;
+    int b;
+};
+
+/**
+ * @brief A compiled formula. Register i < input_count holds input i, register
+ * input_count + c holds constants[c], and output k is register outputs[k] once every
+ * instruction has run.
+ *
+ */
+class FormulaProgram
+{
+    public:
+    int input_count;
+    int register_count;
+    vector<double> constants;
+    vector<FormulaInstruction> instructions;
+    vector<int> outputs;
+
+    FormulaProgram()
+    {
+        input_count = 0;
+        register_count = 0;
+    }
+};
+
+/**
+ * @brief Starts an empty program over `input_count` inputs. Until
+ * formula_program_allocate() runs, every new value gets its own register.
+ *
+ */
+void formula_program_begin(FormulaProgram* program, int input_count)
+{
+    program->input_count = input_count;
+    program->register_count = input_count;
+    program->constants.clear();
+    program->instructions.clear();
+    program->outputs.clear();
+}
+
+/**
+ * @brief Adds a constant and returns its register. Call before any instruction is
+ * emitted, so constants sit right after the inputs.
+ *
+ */
+int formula_program_constant(FormulaProgram* program, double value)
+{
+    program->constants.push_back(value);
+    return program->register_count++;
+}
+
+/**
+ * @brief Appends an instruction. For the ops that define a new value (MUL, NEG_MUL,
+ * DIVIDE) `dst` is ignored and the new register is returned; MUL_ADD and MUL_SUB add to
+ * `dst` and return it.
+ *
+ */
+int formula_program_emit(FormulaProgram* program, int op, int dst, int a, int b)
+{
+    if (op == FORMULA_OP_MUL || op == FORMULA_OP_NEG_MUL || op == FORMULA_OP_DIVIDE) dst = program->register_count++;
+    FormulaInstruction instruction;
+    instruction.op = op;
+    instruction.dst = dst;
+    instruction.a = a;
+    instruction.b = b;
+    program->instructions.push_back(instruction);
+    return dst;
+}
+
+/**
+ * @brief Renumbers the temporaries so that a register is reused once the value in it
+ * is no longer read (linear scan over the instructions). Inputs, constants and outputs
+ * keep their registers to the end.
+ *
+ */
+void formula_program_allocate(FormulaProgram* program)
+{
+    int fixed = program->input_count + (int)program->constants.size();
+    int count = (int)program->instructions.size();
+    vector<int> last_use(program->register_count, -1);
+    for (int i = 0; i < count; ++i)
+    {
+        const FormulaInstruction& instruction = program->instructions[i];
+        last_use[instruction.a] = last_use[instruction.b] = last_use[instruction.dst] = i;
+    }
+    for (int output : program->outputs) last_use[output] = count;
+
+    vector<int> physical(program->register_count, -1);
+    for (int r = 0; r < fixed; ++r) physical[r] = r;
+    vector<int> free_registers;
+    int used = fixed;
+    for (int i = 0; i < count; ++i)
+    {
+        FormulaInstruction& instruction = program->instructions[i];
+        int a = instruction.a;
+        int b = instruction.b;
+        instruction.a = physical[a];
+        instruction.b = physical[b];
+        // Operands read for the last time are freed first: each lane is read before it
+        // is written, so the result may overwrite one of them.
+        if (a >= fixed && last_use[a] == i) free_registers.push_back(physical[a]);
+        if (b >= fixed && b != a && last_use[b] == i) free_registers.push_back(physical[b]);
+        if (physical[instruction.dst] < 0)
+        {
+            if (free_registers.empty()) physical[instruction.dst] = used++;
+            else
+            {
+                physical[instruction.dst] = free_registers.back();
+                free_registers.pop_back();
+            }
+        }
+        int dst = instruction.dst;
+        instruction.dst = physical[dst];
+        if (dst >= fixed && last_use[dst] == i) free_registers.push_back(physical[dst]); // dead store
+    }
+    for (int& output : program->outputs) output = physical[output];
+    program->register_count = used;
+}
+
+/**
+ * @brief Runs the program over one tile of FORMULA_PROGRAM_LANES items: loads the
+ * inputs from `inputs` (item l of input k at inputs[k * stride + l]), executes every
+ * instruction on whole registers and stores the outputs the same way.
+ *
+ * @param registers void*  program->register_count * FORMULA_PROGRAM_LANES doubles
+ */
+template <int L>
+inline __attribute__((always_inline)) void formula_program_tile_body(const FormulaProgram* program, const double* inputs, double* outputs, int stride, void* registers)
+{
+    typedef double lanes __attribute__((vector_size(L * sizeof(double))));
+    lanes* r = (lanes*)registers;
+    for (int k = 0; k < program->input_count; ++k) memcpy(&r[k], inputs + (size_t)k * stride, sizeof(lanes));
+    for (size_t c = 0; c < program->constants.size(); ++c) r[program->input_count + c] = (lanes){} + program->constants[c];
+
+    const FormulaInstruction* instruction = program->instructions.data();
+    const FormulaInstruction* end = instruction + program->instructions.size();
+    for (; instruction != end; ++instruction)
+    {
+        switch (instruction->op)
+        {
+            case FORMULA_OP_MUL: r[instruction->dst] = r[instruction->a] * r[instruction->b]; break;
+            case FORMULA_OP_NEG_MUL: r[instruction->dst] = -(r[instruction->a] * r[instruction->b]); break;
+            case FORMULA_OP_MUL_ADD: r[instruction->dst] += r[instruction->a] * r[instruction->b]; break;
+            case FORMULA_OP_MUL_SUB: r[instruction->dst] -= r[instruction->a] * r[instruction->b]; break;
+            case FORMULA_OP_DIVIDE: r[instruction->dst] = r[instruction->a] / r[instruction->b]; break;
+        }
+    }
+    for (size_t k = 0; k < program->outputs.size(); ++k) memcpy(outputs + k * stride, &r[program->outputs[k]], sizeof(lanes));
+}
+
+void formula_program_tile_portable(const FormulaProgram* program, const double* inputs, double* outputs, int stride, void* registers)
+{
+    formula_program_tile_body<FORMULA_PROGRAM_LANES>(program, inputs, outputs, stride, registers);
+}
+
+#ifdef FORMULA_PROGRAM_X86
+__attribute__((target("avx2")))
+void formula_program_tile_avx2(const FormulaProgram* program, const double* inputs, double* outputs, int stride, void* registers)
+{
+    formula_program_tile_body<FORMULA_PROGRAM_LANES>(program, inputs, outputs, stride, registers);
+}
+
+__attribute__((target("avx512f")))
+void formula_program_tile_avx512(const FormulaProgram* program, const double* inputs, double* outputs, int stride, void* registers)
+{
+    formula_program_tile_body<FORMULA_PROGRAM_LANES>(program, inputs, outputs, stride, registers);
+}
+#endif
+
+/**
+ * @brief Evaluates the program for `count` items stored structure-of-arrays: input k of
+ * item b at inputs[k * count + b], output k at outputs[k * count + b]. Where the CPU has
+ * fused multiply-add the compiler may use it, so results can differ from a scalar
+ * evaluation in the last bit.
+ *
+ * @param program const FormulaProgram*
+ * @param count int
+ * @param inputs const double*  program->input_count * count
+ * @param outputs double*  program->outputs.size() * count
+ */
+void evaluate_formula_program(const FormulaProgram* program, int count, const double* inputs, double* outputs)
+{
+    typedef void (*tile_kernel)(const FormulaProgram*, const double*, double*, int, void*);
+    tile_kernel kernel = formula_program_tile_portable;
+#ifdef FORMULA_PROGRAM_X86
+    if (__builtin_cpu_supports("avx512f")) kernel = formula_program_tile_avx512;
+    else if (__builtin_cpu_supports("avx2")) kernel = formula_program_tile_avx2;
+#endif
+    const int lanes = FORMULA_PROGRAM_LANES;
+    size_t register_doubles = (size_t)program->register_count * lanes;
+    int output_count = (int)program->outputs.size();
+
+    int full_tiles = count / lanes;
+    int grain = max(1, min(64, full_tiles / (4 * shared_thread_pool().size())));
+    parallel_for(0, full_tiles, grain, [&](int tile_begin, int tile_end)
+    {
+        vector<double> registers(register_doubles + lanes); // + lanes: room to align to 64 bytes
+        void* aligned = (void*)(((uintptr_t)registers.data() + 63) & ~(uintptr_t)63);
+        for (int tile = tile_begin; tile < tile_end; ++tile)
+        {
+            kernel(program, inputs + (size_t)tile * lanes, outputs + (size_t)tile * lanes, count, aligned);
+        }
+    });
+
+    int remaining = count - full_tiles * lanes;
+    if (remaining > 0) // pad the last tile by repeating its first item
+    {
+        vector<double> registers(register_doubles + lanes);
+        void* aligned = (void*)(((uintptr_t)registers.data() + 63) & ~(uintptr_t)63);
+        vector<double> padded_inputs((size_t)program->input_count * lanes);
+        vector<double> padded_outputs((size_t)output_count * lanes);
+        int first = full_tiles * lanes;
+        for (int k = 0; k < program->input_count; ++k)
+        {
+            for (int l = 0; l < lanes; ++l) padded_inputs[(size_t)k * lanes + l] = inputs[(size_t)k * count + first + (l < remaining ? l : 0)];
+        }
+        kernel(program, padded_inputs.data(), padded_outputs.data(), lanes, aligned);
+        for (int k = 0; k < output_count; ++k)
+        {
+            for (int l = 0; l < remaining; ++l) outputs[(size_t)k * count + first + l] = padded_outputs[(size_t)k * lanes + l];
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,146 @@
+/*
+Destinations for closed-form formula text (see inverse_closed_form.cpp). Formulas for
+large matrices run to gigabytes, so they are written through a FormulaSink in chunks
+instead of being built up as one string.
+
+Author: Evan Lauer
+*/
+
+#ifndef FORMULA_SINK_H
+#define FORMULA_SINK_H
+
+#include <string>
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+
+using namespace std;
+
+/**
+ * @brief Destination for formula text. Writes are collected in a fixed-size buffer and
+ * handed to flush() in chunks, so writing a formula never needs more memory than the
+ * buffer, however long the formula is.
+ * 
+ */
+class FormulaSink
+{
+    public:
+    bool failed; // set once a flush could not write everything
+
+    FormulaSink(size_t _capacity = 1 << 16)
+    {
+        capacity = _capacity;
+        buffer.reserve(capacity);
+        failed = false;
+    }
+
+    virtual ~FormulaSink() {}
+
+    void write(const char* text, size_t length)
+    {
+        if (buffer.size() + length > capacity) finish();
+        if (length >= capacity) { flush(text, length); return; }
+        buffer.append(text, length);
+    }
+
+    void write(const char* text) { write(text, strlen(text)); }
+
+    void write(const string& text) { write(text.data(), text.size()); }
+
+    /**
+     * @brief Hands everything still buffered to the destination. Call once the last
+     * piece has been written.
+     * 
+     */
+    void finish()
+    {
+        if (buffer.empty()) return;
+        flush(buffer.data(), buffer.size());
+        buffer.clear();
+    }
+
+    protected:
+    virtual void flush(const char* data, size_t length) = 0;
+
+    private:
+    size_t capacity;
+    string buffer;
+};
+
+/**
+ * @brief Appends to a string. Used where the caller really does want the whole text.
+ * 
+ */
+class StringSink : public FormulaSink
+{
+    public:
+    StringSink(string* _out) : FormulaSink(1 << 12) { out = _out; }
+
+    protected:
+    string* out;
+
+    void flush(const char* data, size_t length) { out->append(data, length); }
+};
+
+/**
+ * @brief Writes to a stdio stream, e.g. stdout or a file opened with fopen().
+ * 
+ */
+class FileSink : public FormulaSink
+{
+    public:
+    FileSink(FILE* _file) { file = _file; }
+
+    protected:
+    FILE* file;
+
+    void flush(const char* data, size_t length)
+    {
+        if (fwrite(data, 1, length, file) != length) failed = true;
+    }
+};
+
+/**
+ * @brief Writes to a file descriptor (file, pipe or socket).
+ * 
+ */
+class FdSink : public FormulaSink
+{
+    public:
+    FdSink(int _fd) { fd = _fd; }
+
+    protected:
+    int fd;
+
+    void flush(const char* data, size_t length)
+    {
+        while (length > 0 && !failed)
+        {
+            ssize_t written = ::write(fd, data, length);
+            if (written <= 0) { failed = true; break; }
+            data += written;
+            length -= written;
+        }
+    }
+};
+
+/**
+ * @brief Passes each chunk to a callback. From Javascript the callback is a function
+ * added with Module.addFunction(..., 'vii') that receives (pointer, length); the chunk
+ * is only valid during the call.
+ * 
+ */
+typedef void (*formula_chunk_callback)(const char* chunk, int length);
+
+class CallbackSink : public FormulaSink
+{
+    public:
+    CallbackSink(formula_chunk_callback _callback) { callback = _callback; }
+
+    protected:
+    formula_chunk_callback callback;
+
+    void flush(const char* data, size_t length) { callback(data, (int)length); }
+};
+
+#endif
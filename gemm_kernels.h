@@ -0,0 +1,444 @@
+/*
+Dense matrix-multiply kernels used by the blocked LU in inverse_real_valued.cpp.
+
+All matrices are row-major double arrays addressed through a leading dimension (the
+distance between rows), so the kernels can work on sub-blocks of a larger matrix.
+
+gemm_subtract() computes C -= A * B the way optimized BLAS libraries do: the operands
+are split into cache-sized blocks, each block is packed into a contiguous buffer, and
+a small register-tiled "microkernel" does the multiply-adds. The microkernel is chosen
+at runtime: AVX-512 or AVX2/FMA when the CPU supports them, plain C++ otherwise (this
+is also the path taken by the WASM build).
+
+Every kernel also comes in single precision (float), used by the mixed-precision
+inverse: the vector registers hold twice as many floats, so the microkernel tiles are
+twice as wide.
+
+Author: Evan Lauer
+*/
+
+#ifndef GEMM_KERNELS_H
+#define GEMM_KERNELS_H
+
+#include <vector>
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define GEMM_KERNELS_X86 1
+#endif
+
+using namespace std;
+
+// Block sizes: a KC x NC panel of B stays in L2/L3, an MC x KC block of A stays in L2.
+// MC must be a multiple of every microkernel's MR, NC of every NR.
+const int GEMM_MC = 96;
+const int GEMM_KC = 256;
+const int GEMM_NC = 3072;
+
+/**
+ * @brief A microkernel computes C -= A * B for one MR x NR tile of C, reading kc steps
+ * of a packed A panel (MR values per step) and a packed B panel (NR values per step).
+ *
+ */
+typedef void (*gemm_microkernel)(int kc, const double* a, const double* b, double* c, int ldc);
+
+template <class T>
+class GemmKernel
+{
+    public:
+    const char* name;
+    int mr;
+    int nr;
+    void (*kernel)(int kc, const T* a, const T* b, T* c, int ldc);
+};
+
+/**
+ * @brief Portable microkernel. Small enough that the compiler keeps the tile in registers.
+ *
+ */
+template <class T>
+void gemm_microkernel_scalar(int kc, const T* a, const T* b, T* c, int ldc)
+{
+    T acc[4][4] = {};
+    for (int p = 0; p < kc; ++p)
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            for (int j = 0; j < 4; ++j) acc[i][j] += a[p * 4 + i] * b[p * 4 + j];
+        }
+    }
+    for (int i = 0; i < 4; ++i)
+    {
+        for (int j = 0; j < 4; ++j) c[i * ldc + j] -= acc[i][j];
+    }
+}
+
+#ifdef GEMM_KERNELS_X86
+
+/**
+ * @brief AVX2/FMA microkernel, 6 x 8 tile: 12 ymm accumulators, 2 for B, 1 broadcast.
+ *
+ */
+__attribute__((target("avx2,fma")))
+void gemm_microkernel_avx2(int kc, const double* a, const double* b, double* c, int ldc)
+{
+    __m256d acc[6][2];
+    #pragma GCC unroll 6
+    for (int i = 0; i < 6; ++i) { acc[i][0] = _mm256_setzero_pd(); acc[i][1] = _mm256_setzero_pd(); }
+    for (int p = 0; p < kc; ++p)
+    {
+        __m256d b0 = _mm256_loadu_pd(b + p * 8);
+        __m256d b1 = _mm256_loadu_pd(b + p * 8 + 4);
+        #pragma GCC unroll 6
+        for (int i = 0; i < 6; ++i)
+        {
+            __m256d ai = _mm256_broadcast_sd(a + p * 6 + i);
+            acc[i][0] = _mm256_fmadd_pd(ai, b0, acc[i][0]);
+            acc[i][1] = _mm256_fmadd_pd(ai, b1, acc[i][1]);
+        }
+    }
+    #pragma GCC unroll 6
+    for (int i = 0; i < 6; ++i)
+    {
+        double* row = c + i * ldc;
+        _mm256_storeu_pd(row, _mm256_sub_pd(_mm256_loadu_pd(row), acc[i][0]));
+        _mm256_storeu_pd(row + 4, _mm256_sub_pd(_mm256_loadu_pd(row + 4), acc[i][1]));
+    }
+}
+
+/**
+ * @brief AVX-512 microkernel, 12 x 16 tile: 24 zmm accumulators, 2 for B, 1 broadcast.
+ *
+ */
+__attribute__((target("avx512f")))
+void gemm_microkernel_avx512(int kc, const double* a, const double* b, double* c, int ldc)
+{
+    __m512d acc[12][2];
+    #pragma GCC unroll 12
+    for (int i = 0; i < 12; ++i) { acc[i][0] = _mm512_setzero_pd(); acc[i][1] = _mm512_setzero_pd(); }
+    for (int p = 0; p < kc; ++p)
+    {
+        __m512d b0 = _mm512_loadu_pd(b + p * 16);
+        __m512d b1 = _mm512_loadu_pd(b + p * 16 + 8);
+        #pragma GCC unroll 12
+        for (int i = 0; i < 12; ++i)
+        {
+            __m512d ai = _mm512_set1_pd(a[p * 12 + i]);
+            acc[i][0] = _mm512_fmadd_pd(ai, b0, acc[i][0]);
+            acc[i][1] = _mm512_fmadd_pd(ai, b1, acc[i][1]);
+        }
+    }
+    #pragma GCC unroll 12
+    for (int i = 0; i < 12; ++i)
+    {
+        double* row = c + i * ldc;
+        _mm512_storeu_pd(row, _mm512_sub_pd(_mm512_loadu_pd(row), acc[i][0]));
+        _mm512_storeu_pd(row + 8, _mm512_sub_pd(_mm512_loadu_pd(row + 8), acc[i][1]));
+    }
+}
+
+/**
+ * @brief AVX2/FMA single-precision microkernel, 6 x 16 tile.
+ *
+ */
+__attribute__((target("avx2,fma")))
+void gemm_microkernel_avx2_single(int kc, const float* a, const float* b, float* c, int ldc)
+{
+    __m256 acc[6][2];
+    #pragma GCC unroll 6
+    for (int i = 0; i < 6; ++i) { acc[i][0] = _mm256_setzero_ps(); acc[i][1] = _mm256_setzero_ps(); }
+    for (int p = 0; p < kc; ++p)
+    {
+        __m256 b0 = _mm256_loadu_ps(b + p * 16);
+        __m256 b1 = _mm256_loadu_ps(b + p * 16 + 8);
+        #pragma GCC unroll 6
+        for (int i = 0; i < 6; ++i)
+        {
+            __m256 ai = _mm256_broadcast_ss(a + p * 6 + i);
+            acc[i][0] = _mm256_fmadd_ps(ai, b0, acc[i][0]);
+            acc[i][1] = _mm256_fmadd_ps(ai, b1, acc[i][1]);
+        }
+    }
+    #pragma GCC unroll 6
+    for (int i = 0; i < 6; ++i)
+    {
+        float* row = c + i * ldc;
+        _mm256_storeu_ps(row, _mm256_sub_ps(_mm256_loadu_ps(row), acc[i][0]));
+        _mm256_storeu_ps(row + 8, _mm256_sub_ps(_mm256_loadu_ps(row + 8), acc[i][1]));
+    }
+}
+
+/**
+ * @brief AVX-512 single-precision microkernel, 12 x 32 tile.
+ *
+ */
+__attribute__((target("avx512f")))
+void gemm_microkernel_avx512_single(int kc, const float* a, const float* b, float* c, int ldc)
+{
+    __m512 acc[12][2];
+    #pragma GCC unroll 12
+    for (int i = 0; i < 12; ++i) { acc[i][0] = _mm512_setzero_ps(); acc[i][1] = _mm512_setzero_ps(); }
+    for (int p = 0; p < kc; ++p)
+    {
+        __m512 b0 = _mm512_loadu_ps(b + p * 32);
+        __m512 b1 = _mm512_loadu_ps(b + p * 32 + 16);
+        #pragma GCC unroll 12
+        for (int i = 0; i < 12; ++i)
+        {
+            __m512 ai = _mm512_set1_ps(a[p * 12 + i]);
+            acc[i][0] = _mm512_fmadd_ps(ai, b0, acc[i][0]);
+            acc[i][1] = _mm512_fmadd_ps(ai, b1, acc[i][1]);
+        }
+    }
+    #pragma GCC unroll 12
+    for (int i = 0; i < 12; ++i)
+    {
+        float* row = c + i * ldc;
+        _mm512_storeu_ps(row, _mm512_sub_ps(_mm512_loadu_ps(row), acc[i][0]));
+        _mm512_storeu_ps(row + 16, _mm512_sub_ps(_mm512_loadu_ps(row + 16), acc[i][1]));
+    }
+}
+
+#endif
+
+/**
+ * @brief Returns the fastest microkernel this CPU can run. Detection happens once.
+ *
+ * @return const GemmKernel<double>&
+ */
+const GemmKernel<double>& gemm_select_kernel()
+{
+    static const GemmKernel<double> scalar = { "scalar", 4, 4, gemm_microkernel_scalar<double> };
+#ifdef GEMM_KERNELS_X86
+    static const GemmKernel<double> avx2 = { "avx2", 6, 8, gemm_microkernel_avx2 };
+    static const GemmKernel<double> avx512 = { "avx512", 12, 16, gemm_microkernel_avx512 };
+    static const GemmKernel<double>* selected = __builtin_cpu_supports("avx512f") ? &avx512
+                                      : (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) ? &avx2
+                                      : &scalar;
+    return *selected;
+#else
+    return scalar;
+#endif
+}
+
+const GemmKernel<float>& gemm_select_kernel_single()
+{
+    static const GemmKernel<float> scalar = { "scalar", 4, 4, gemm_microkernel_scalar<float> };
+#ifdef GEMM_KERNELS_X86
+    static const GemmKernel<float> avx2 = { "avx2", 6, 16, gemm_microkernel_avx2_single };
+    static const GemmKernel<float> avx512 = { "avx512", 12, 32, gemm_microkernel_avx512_single };
+    static const GemmKernel<float>* selected = __builtin_cpu_supports("avx512f") ? &avx512
+                                             : (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) ? &avx2
+                                             : &scalar;
+    return *selected;
+#else
+    return scalar;
+#endif
+}
+
+/**
+ * @brief y -= alpha * x over n contiguous doubles. This is the row operation used by
+ * the unblocked parts of the LU and the triangular solves.
+ *
+ */
+template <class T>
+void axpy_subtract_scalar(int n, T alpha, const T* x, T* y)
+{
+    for (int i = 0; i < n; ++i) y[i] -= alpha * x[i];
+}
+
+#ifdef GEMM_KERNELS_X86
+
+__attribute__((target("avx2,fma")))
+void axpy_subtract_avx2(int n, double alpha, const double* x, double* y)
+{
+    __m256d a = _mm256_set1_pd(alpha);
+    int i = 0;
+    for (; i + 4 <= n; i += 4) _mm256_storeu_pd(y + i, _mm256_fnmadd_pd(a, _mm256_loadu_pd(x + i), _mm256_loadu_pd(y + i)));
+    for (; i < n; ++i) y[i] -= alpha * x[i];
+}
+
+__attribute__((target("avx512f")))
+void axpy_subtract_avx512(int n, double alpha, const double* x, double* y)
+{
+    __m512d a = _mm512_set1_pd(alpha);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) _mm512_storeu_pd(y + i, _mm512_fnmadd_pd(a, _mm512_loadu_pd(x + i), _mm512_loadu_pd(y + i)));
+    if (i < n)
+    {
+        __mmask8 tail = (__mmask8)((1u << (n - i)) - 1);
+        _mm512_mask_storeu_pd(y + i, tail, _mm512_fnmadd_pd(a, _mm512_maskz_loadu_pd(tail, x + i), _mm512_maskz_loadu_pd(tail, y + i)));
+    }
+}
+
+__attribute__((target("avx2,fma")))
+void axpy_subtract_avx2_single(int n, float alpha, const float* x, float* y)
+{
+    __m256 a = _mm256_set1_ps(alpha);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) _mm256_storeu_ps(y + i, _mm256_fnmadd_ps(a, _mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i)));
+    for (; i < n; ++i) y[i] -= alpha * x[i];
+}
+
+__attribute__((target("avx512f")))
+void axpy_subtract_avx512_single(int n, float alpha, const float* x, float* y)
+{
+    __m512 a = _mm512_set1_ps(alpha);
+    int i = 0;
+    for (; i + 16 <= n; i += 16) _mm512_storeu_ps(y + i, _mm512_fnmadd_ps(a, _mm512_loadu_ps(x + i), _mm512_loadu_ps(y + i)));
+    if (i < n)
+    {
+        __mmask16 tail = (__mmask16)((1u << (n - i)) - 1);
+        _mm512_mask_storeu_ps(y + i, tail, _mm512_fnmadd_ps(a, _mm512_maskz_loadu_ps(tail, x + i), _mm512_maskz_loadu_ps(tail, y + i)));
+    }
+}
+
+#endif
+
+typedef void (*axpy_kernel)(int n, double alpha, const double* x, double* y);
+
+/**
+ * @brief y -= alpha * x, dispatched the same way as the GEMM microkernel.
+ *
+ */
+void axpy_subtract(int n, double alpha, const double* x, double* y)
+{
+#ifdef GEMM_KERNELS_X86
+    static const axpy_kernel kernel = __builtin_cpu_supports("avx512f") ? axpy_subtract_avx512
+                                    : (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) ? axpy_subtract_avx2
+                                    : axpy_subtract_scalar<double>;
+    kernel(n, alpha, x, y);
+#else
+    axpy_subtract_scalar(n, alpha, x, y);
+#endif
+}
+
+typedef void (*axpy_kernel_single)(int n, float alpha, const float* x, float* y);
+
+void axpy_subtract(int n, float alpha, const float* x, float* y)
+{
+#ifdef GEMM_KERNELS_X86
+    static const axpy_kernel_single kernel = __builtin_cpu_supports("avx512f") ? axpy_subtract_avx512_single
+                                           : (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) ? axpy_subtract_avx2_single
+                                           : axpy_subtract_scalar<float>;
+    kernel(n, alpha, x, y);
+#else
+    axpy_subtract_scalar(n, alpha, x, y);
+#endif
+}
+
+/**
+ * @brief Copies an mc x kc block of A into MR-row panels, zero-padding the last panel.
+ * Panel layout: for each step p, the MR values A[i..i+MR, p].
+ *
+ */
+template <class T>
+void gemm_pack_a(int mc, int kc, const T* a, int lda, int mr, T* packed)
+{
+    for (int i = 0; i < mc; i += mr)
+    {
+        int rows = min(mr, mc - i);
+        for (int p = 0; p < kc; ++p)
+        {
+            for (int r = 0; r < rows; ++r) packed[r] = a[(i + r) * lda + p];
+            for (int r = rows; r < mr; ++r) packed[r] = 0;
+            packed += mr;
+        }
+    }
+}
+
+/**
+ * @brief Copies a kc x nc block of B into NR-column panels, zero-padding the last panel.
+ * Panel layout: for each step p, the NR values B[p, j..j+NR].
+ *
+ */
+template <class T>
+void gemm_pack_b(int kc, int nc, const T* b, int ldb, int nr, T* packed)
+{
+    for (int j = 0; j < nc; j += nr)
+    {
+        int cols = min(nr, nc - j);
+        for (int p = 0; p < kc; ++p)
+        {
+            const T* src = b + p * ldb + j;
+            for (int c = 0; c < cols; ++c) packed[c] = src[c];
+            for (int c = cols; c < nr; ++c) packed[c] = 0;
+            packed += nr;
+        }
+    }
+}
+
+/**
+ * @brief C -= A * B with the given microkernel; see gemm_subtract().
+ *
+ */
+template <class T>
+void gemm_subtract_blocked(const GemmKernel<T>& kernel, int m, int n, int k, const T* a, int lda, const T* b, int ldb, T* c, int ldc)
+{
+    if (m <= 0 || n <= 0 || k <= 0) return;
+    int mr = kernel.mr;
+    int nr = kernel.nr;
+
+    // Packing buffers are reused between calls; one set per thread.
+    thread_local vector<T> packed_a;
+    thread_local vector<T> packed_b;
+    packed_a.resize((size_t)GEMM_MC * GEMM_KC);
+    packed_b.resize((size_t)GEMM_KC * (GEMM_NC + nr));
+    T edge_tile[16 * 32];
+
+    for (int jc = 0; jc < n; jc += GEMM_NC)
+    {
+        int nc = min(GEMM_NC, n - jc);
+        for (int pc = 0; pc < k; pc += GEMM_KC)
+        {
+            int kc = min(GEMM_KC, k - pc);
+            gemm_pack_b(kc, nc, b + (size_t)pc * ldb + jc, ldb, nr, packed_b.data());
+            for (int ic = 0; ic < m; ic += GEMM_MC)
+            {
+                int mc = min(GEMM_MC, m - ic);
+                gemm_pack_a(mc, kc, a + (size_t)ic * lda + pc, lda, mr, packed_a.data());
+                for (int jr = 0; jr < nc; jr += nr)
+                {
+                    int cols = min(nr, nc - jr);
+                    const T* pb = packed_b.data() + (size_t)jr * kc;
+                    for (int ir = 0; ir < mc; ir += mr)
+                    {
+                        int rows = min(mr, mc - ir);
+                        const T* pa = packed_a.data() + (size_t)ir * kc;
+                        T* tile = c + (size_t)(ic + ir) * ldc + jc + jr;
+                        if (rows == mr && cols == nr)
+                        {
+                            kernel.kernel(kc, pa, pb, tile, ldc);
+                            continue;
+                        }
+                        // Partial tile at the matrix edge: run the kernel on a scratch tile.
+                        fill(edge_tile, edge_tile + mr * nr, T(0));
+                        kernel.kernel(kc, pa, pb, edge_tile, nr);
+                        for (int i = 0; i < rows; ++i)
+                        {
+                            for (int j = 0; j < cols; ++j) tile[i * ldc + j] += edge_tile[i * nr + j];
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+/**
+ * @brief C -= A * B, where A is m x k, B is k x n and C is m x n (all row-major).
+ *
+ * @param lda int  Leading dimension (row stride) of A, likewise ldb and ldc
+ */
+void gemm_subtract(int m, int n, int k, const double* a, int lda, const double* b, int ldb, double* c, int ldc)
+{
+    gemm_subtract_blocked(gemm_select_kernel(), m, n, k, a, lda, b, ldb, c, ldc);
+}
+
+void gemm_subtract(int m, int n, int k, const float* a, int lda, const float* b, int ldb, float* c, int ldc)
+{
+    gemm_subtract_blocked(gemm_select_kernel_single(), m, n, k, a, lda, b, ldb, c, ldc);
+}
+
+#endif
@@ -1,6 +1,14 @@
 #include <string>
 #include <vector>
 #include <iostream>
+#include <unordered_map>
+
+#include "thread_pool.h"
+#include "expression.h"
+#include "formula_sink.h"
+#include "formula_cache.h"
+#include "formula_program.h"
+#include "profiling.h"
 
 using namespace std;
 
@@ -37,86 +45,357 @@ int calculate_index(int size, int row, int col) { return (row * size) + col; }
 string matrix_get(Matrix* m, int row, int col) { return m->matrix.at(calculate_index(m->size, row, col)); }
 
 /**
- * @brief Gets the minor matrix  at (row, col).
+ * @brief Transposes the given matrix in place. The formulas are moved, not copied, and
+ * the matrix is walked in tiles so that the column side of each swap stays in cache.
  * 
  * @param m Matrix*
- * @param row int
- * @param col int
- * @return Matrix* Minor matrix
  */
-Matrix* get_minor_matrix(Matrix* m, int row, int col)
+void transpose_matrix(Matrix* m)
 {
-    Matrix* minor_matrix = new Matrix(m->size - 1);
-    for (int i = 0; i < m->size; ++i)
+    PROFILE_SCOPE("closed_form.transpose");
+    const int tile = 16;
+    int n = m->size;
+    for (int i0 = 0; i0 < n; i0 += tile)
     {
-        if (i == row) continue;
-        for (int j = 0; j < m->size; ++j)
+        for (int j0 = i0; j0 < n; j0 += tile)
         {
-            if (j == col) continue;
-            minor_matrix->matrix.push_back(m->matrix.at(calculate_index(m->size,i,j)));
+            for (int i = i0; i < min(n, i0 + tile); ++i)
+            {
+                for (int j = max(j0, i + 1); j < min(n, j0 + tile); ++j)
+                {
+                    swap(m->matrix[calculate_index(n, i, j)], m->matrix[calculate_index(n, j, i)]);
+                }
+            }
         }
     }
-    return minor_matrix;
 }
 
+// Minors of this size or smaller keep their rendered formula in the DAG, so the text of
+// a small minor that appears in many expansions is only built once.
+const int FORMULA_CACHE_SIZE = 4;
+
+/**
+ * @brief The determinant of one minor of the matrix: the rows in row_mask and the
+ * columns in col_mask (bit i set = row/column i kept). Minors larger than 2x2 are
+ * expanded along their first kept row; children[t] is the minor left after removing
+ * that row and the t-th kept column.
+ */
+class MinorNode
+{
+    public:
+    int size;
+    unsigned int row_mask;
+    unsigned int col_mask;
+    vector<int> children;
+    string formula; // cached text, only for size <= FORMULA_CACHE_SIZE
+};
+
 /**
- * @brief Transposes the given matrix.
+ * @brief Every distinct minor reached while expanding determinants of `matrix`, built
+ * once and shared. Two expansions that reach the same (rows, columns) minor share its
+ * node, so the DAG has at most (number of row sets) * 2^n nodes instead of n! subtrees.
  * 
- * @param m Matrix*
  */
-void transpose_matrix(Matrix* m)
+class DeterminantDag
 {
-    for (int i = 0; i < m->size; ++i)
+    public:
+    Matrix* matrix; // entry names, not owned
+    vector<MinorNode> nodes;
+    unordered_map<unsigned long long, int> node_index; // (row_mask << 32 | col_mask) -> node
+
+    DeterminantDag(Matrix* _matrix)
     {
-        for (int j = i; j < m->size; ++j)
+        matrix = _matrix;
+    }
+};
+
+/**
+ * @brief Writes the closed-form determinant of node `id` to the sink. The text is the
+ * same as the plain recursive expansion produces, e.g. "((11)(22*33-23*32)-(12)(...)+...)".
+ * Nothing is built up in memory: each entry name and sign goes straight to the sink, so
+ * the only state is the recursion, at most one level per row.
+ * 
+ * @param dag DeterminantDag*
+ * @param id int
+ * @param out FormulaSink&
+ */
+void dag_render(DeterminantDag* dag, int id, FormulaSink& out)
+{
+    const MinorNode& node = dag->nodes[id];
+    if (!node.formula.empty()) { out.write(node.formula); return; }
+
+    if (node.size == 0) { out.write("1", 1); return; }
+    Matrix* m = dag->matrix;
+    int first_row = __builtin_ctz(node.row_mask); // the masks are not empty from here on
+    if (node.size == 1) { out.write(m->matrix[calculate_index(m->size, first_row, __builtin_ctz(node.col_mask))]); return; }
+    if (node.size == 2)
+    {
+        int second_row = __builtin_ctz(node.row_mask & (node.row_mask - 1));
+        int left = __builtin_ctz(node.col_mask);
+        int right = __builtin_ctz(node.col_mask & (node.col_mask - 1));
+        out.write("(", 1);
+        out.write(m->matrix[calculate_index(m->size, first_row, left)]);
+        out.write("*", 1);
+        out.write(m->matrix[calculate_index(m->size, second_row, right)]);
+        out.write("-", 1);
+        out.write(m->matrix[calculate_index(m->size, first_row, right)]);
+        out.write("*", 1);
+        out.write(m->matrix[calculate_index(m->size, second_row, left)]);
+        out.write(")", 1);
+        return;
+    }
+
+    out.write("(", 1);
+    unsigned int columns = node.col_mask;
+    for (int t = 0; columns; ++t, columns &= columns - 1)
+    {
+        const string& entry = m->matrix[calculate_index(m->size, first_row, __builtin_ctz(columns))];
+        if (t % 2 == 1) out.write("-(", 2); // writes (-a11), for example
+        else out.write(t != 0 ? "+(" : "("); // plus sign if needed, then (a11)
+        out.write(entry);
+        out.write(")", 1);
+        dag_render(dag, node.children[t], out);
+    }
+    out.write(")", 1);
+}
+
+/**
+ * @brief Appends the closed-form determinant of node `id` to a string.
+ * 
+ * @param dag DeterminantDag*
+ * @param id int
+ * @param out string&
+ */
+void dag_render(DeterminantDag* dag, int id, string& out)
+{
+    StringSink sink(&out);
+    dag_render(dag, id, sink);
+    sink.finish();
+}
+
+/**
+ * @brief Returns the node for the minor (row_mask, col_mask), building it and the
+ * minors below it the first time it is reached.
+ * 
+ * @param dag DeterminantDag*
+ * @param row_mask unsigned int
+ * @param col_mask unsigned int  Must keep as many columns as row_mask keeps rows
+ * @return int Node id
+ */
+int dag_minor_node(DeterminantDag* dag, unsigned int row_mask, unsigned int col_mask)
+{
+    unsigned long long key = ((unsigned long long)row_mask << 32) | col_mask;
+    unordered_map<unsigned long long, int>::iterator found = dag->node_index.find(key);
+    if (found != dag->node_index.end()) return found->second;
+
+    PROFILE_COUNT("closed_form.dag_nodes", 1);
+    MinorNode node;
+    node.size = __builtin_popcount(col_mask);
+    node.row_mask = row_mask;
+    node.col_mask = col_mask;
+    if (node.size > 2)
+    {
+        unsigned int remaining_rows = row_mask & (row_mask - 1); // drop the first kept row
+        for (unsigned int columns = col_mask; columns; columns &= columns - 1)
         {
-            int index_1d = calculate_index(m->size,i,j);
-            int index_1d_swap = calculate_index(m->size,j,i);
-            string val = matrix_get(m, i, j);
-            string val_swap = matrix_get(m, j, i);
-            m->matrix[index_1d] = val_swap;
-            m->matrix[index_1d_swap] = val;
+            node.children.push_back(dag_minor_node(dag, remaining_rows, col_mask & ~(columns & -columns)));
         }
     }
+
+    int id = (int)dag->nodes.size();
+    dag->nodes.push_back(node);
+    dag->node_index[key] = id;
+    if (node.size <= FORMULA_CACHE_SIZE)
+    {
+        string formula;
+        dag_render(dag, id, formula);
+        dag->nodes[id].formula = formula;
+    }
+    return id;
 }
 
 /**
- * @brief Returns the closed-form determinant equation for the given 2x2 matrix.
+ * @brief Mask with the low `size` bits set, i.e. every row or column of a size x size matrix.
  * 
- * @param m Matrix*
- * @return string Closed-form equation
  */
-string matrix_determinant_closed_form_2x2(Matrix* m)
+unsigned int full_mask(int size) { return size >= 32 ? ~0u : (1u << size) - 1; }
+
+// Formulas are rendered in parallel in pieces of about this many characters: a minor
+// whose text is longer is split along its expansion, one piece per branch.
+const size_t FORMULA_PIECE_SIZE = 1 << 18;
+
+// Pieces rendered per round, per thread. The pieces of one round are held in memory
+// until they are written, so this bounds the memory used on top of the DAG.
+const int FORMULA_PIECES_PER_THREAD = 4;
+
+/**
+ * @brief Length of the text dag_render() writes for every node, indexed by node id.
+ * Children always come before their parents, so one pass in id order is enough.
+ * 
+ * @param dag DeterminantDag*
+ * @return vector<size_t> 
+ */
+vector<size_t> dag_text_lengths(DeterminantDag* dag)
 {
-    return "(" + m->matrix.at(0) + "*" + m->matrix.at(3) + "-" + m->matrix.at(1) + "*" + m->matrix.at(2) + ")";
+    Matrix* m = dag->matrix;
+    vector<size_t> lengths(dag->nodes.size());
+    for (size_t id = 0; id < dag->nodes.size(); ++id)
+    {
+        const MinorNode& node = dag->nodes[id];
+        if (!node.formula.empty() || node.size <= 2)
+        {
+            string formula;
+            if (node.formula.empty()) dag_render(dag, (int)id, formula);
+            lengths[id] = node.formula.empty() ? formula.size() : node.formula.size();
+            continue;
+        }
+        int first_row = __builtin_ctz(node.row_mask);
+        size_t length = 2; // the outer parentheses
+        unsigned int columns = node.col_mask;
+        for (int t = 0; columns; ++t, columns &= columns - 1)
+        {
+            length += (t == 0 ? 1 : 2) + m->matrix[calculate_index(m->size, first_row, __builtin_ctz(columns))].size() + 1;
+            length += lengths[node.children[t]];
+        }
+        lengths[id] = length;
+    }
+    return lengths;
 }
 
 /**
- * @brief Returns a string representing the closed-form equation for the determinant
- * of the given matrix.
+ * @brief One piece of formula text: `literal`, then the rendering of `node` (if not -1).
  * 
- * @param m Matrix* 
- * @return string Closed-form equation
  */
-string matrix_determinant_closed_form(Matrix* m)
+class FormulaPiece
 {
-    if (m->size == 2) return matrix_determinant_closed_form_2x2(m);
-    string ret = "(";
-    for (int i = 0; i < m->size; ++i)
+    public:
+    string literal;
+    int node;
+};
+
+/**
+ * @brief Writes formula text built from a DAG to a sink, rendering it on the shared pool.
+ * Text is queued as pieces; once enough is queued, every queued piece is rendered as its
+ * own task and the results are written in the order they were queued, so the output is
+ * the same for any number of threads.
+ * 
+ */
+class ParallelFormulaWriter
+{
+    public:
+    DeterminantDag* dag;
+    FormulaSink* out;
+    vector<size_t> lengths; // see dag_text_lengths()
+    vector<FormulaPiece> pieces; // queued, not yet rendered
+    size_t queued; // characters of text queued
+    vector<string> texts; // rendered pieces, kept between rounds to reuse their memory
+
+    ParallelFormulaWriter(DeterminantDag* _dag, FormulaSink* _out)
     {
-        if (i % 2 == 1)
+        dag = _dag;
+        out = _out;
+        lengths = dag_text_lengths(_dag);
+        queued = 0;
+    }
+};
+
+/**
+ * @brief Renders and writes everything queued so far. With a single thread the pieces
+ * are rendered straight to the sink.
+ * 
+ * @param writer ParallelFormulaWriter*
+ */
+void formula_writer_flush(ParallelFormulaWriter* writer)
+{
+    PROFILE_SCOPE("closed_form.render_pieces");
+    vector<FormulaPiece>& pieces = writer->pieces;
+    FormulaSink* out = writer->out;
+    if (shared_thread_pool().size() == 1)
+    {
+        for (const FormulaPiece& piece : pieces)
         {
-            ret += "-(" + matrix_get(m, 0, i) + ")"; // concatenates (-a11), for example
-        } else
+            out->write(piece.literal);
+            if (piece.node >= 0) dag_render(writer->dag, piece.node, *out);
+        }
+    } else
+    {
+        vector<string>& texts = writer->texts;
+        if (texts.size() < pieces.size()) texts.resize(pieces.size());
+        parallel_for(0, (int)pieces.size(), 1, [&](int first, int last)
+        {
+            for (int p = first; p < last; ++p)
+            {
+                texts[p] = pieces[p].literal;
+                if (pieces[p].node >= 0) dag_render(writer->dag, pieces[p].node, texts[p]);
+            }
+        });
+        for (size_t p = 0; p < pieces.size() && !out->failed; ++p) out->write(texts[p]);
+    }
+    pieces.clear();
+    writer->queued = 0;
+}
+
+/**
+ * @brief Queues `text` to be written.
+ * 
+ */
+void formula_writer_literal(ParallelFormulaWriter* writer, const string& text)
+{
+    if (writer->pieces.empty() || writer->pieces.back().node >= 0) writer->pieces.push_back(FormulaPiece{ "", -1 });
+    writer->pieces.back().literal += text;
+    writer->queued += text.size();
+}
+
+/**
+ * @brief Queues the determinant of node `id`, split into pieces of at most about
+ * FORMULA_PIECE_SIZE characters, and flushes once a round's worth of text is queued.
+ * 
+ * @param writer ParallelFormulaWriter*
+ * @param id int
+ */
+void formula_writer_node(ParallelFormulaWriter* writer, int id)
+{
+    const MinorNode& node = writer->dag->nodes[id];
+    if (writer->lengths[id] > FORMULA_PIECE_SIZE && node.size > 2 && node.formula.empty())
+    {
+        Matrix* m = writer->dag->matrix;
+        int first_row = __builtin_ctz(node.row_mask);
+        formula_writer_literal(writer, "(");
+        unsigned int columns = node.col_mask;
+        for (int t = 0; columns; ++t, columns &= columns - 1)
         {
-            if (i != 0) ret += "+"; // concatenates plus sign if needed
-            ret += "(" + matrix_get(m, 0, i) + ")"; // concatenates (a11), for example
+            const string& entry = m->matrix[calculate_index(m->size, first_row, __builtin_ctz(columns))];
+            formula_writer_literal(writer, (t % 2 == 1 ? "-(" : t != 0 ? "+(" : "(") + entry + ")");
+            formula_writer_node(writer, node.children[t]);
         }
-        Matrix* minor_matrix = get_minor_matrix(m, 0, i);
-        ret += matrix_determinant_closed_form(minor_matrix);
-        delete minor_matrix;
+        formula_writer_literal(writer, ")");
+        return;
     }
-    return ret + ")";
+    if (writer->pieces.empty() || writer->pieces.back().node >= 0) writer->pieces.push_back(FormulaPiece{ "", -1 });
+    writer->pieces.back().node = id;
+    writer->queued += writer->lengths[id];
+    if (writer->queued >= FORMULA_PIECE_SIZE * FORMULA_PIECES_PER_THREAD * shared_thread_pool().size()) formula_writer_flush(writer);
+}
+
+/**
+ * @brief Returns a string representing the closed-form equation for the determinant
+ * of the given matrix.
+ * 
+ * @param m Matrix* 
+ * @return string Closed-form equation
+ */
+string matrix_determinant_closed_form(Matrix* m)
+{
+    PROFILE_SCOPE("closed_form.determinant_string");
+    DeterminantDag dag(m);
+    int root = dag_minor_node(&dag, full_mask(m->size), full_mask(m->size));
+    string formula;
+    StringSink sink(&formula);
+    ParallelFormulaWriter writer(&dag, &sink);
+    formula_writer_node(&writer, root);
+    formula_writer_flush(&writer);
+    sink.finish();
+    return formula;
 }
 
 /**
@@ -139,6 +418,26 @@ Matrix* populate_matrix(int size)
     return m;
 }
 
+/**
+ * @brief Writes the closed-form determinant of a dimension x dimension matrix, with
+ * entries named as populate_matrix() names them, to the sink.
+ * 
+ * @param dimension int
+ * @param out FormulaSink&
+ */
+void write_determinant_closed_form(int dimension, FormulaSink& out)
+{
+    PROFILE_SCOPE("closed_form.write_determinant");
+    Matrix* m = populate_matrix(dimension);
+    DeterminantDag dag(m);
+    int root = dag_minor_node(&dag, full_mask(dimension), full_mask(dimension));
+    ParallelFormulaWriter writer(&dag, &out);
+    formula_writer_node(&writer, root);
+    formula_writer_flush(&writer);
+    out.finish();
+    delete m;
+}
+
 void pretty_print_matrix(Matrix* m)
 {
     for (int i = 0; i < m->size; ++i)
@@ -151,28 +450,564 @@ void pretty_print_matrix(Matrix* m)
     }
 }
 
+/**
+ * @brief Builds the DAG holding the cofactor of every entry of the given matrix. The
+ * cofactor of (i, j) is node cofactor_nodes[i * size + j].
+ * 
+ * @param m Matrix*  Entry names
+ * @param cofactor_nodes vector<int>&  Filled with size * size node ids
+ * @return DeterminantDag* 
+ */
+DeterminantDag* build_cofactor_dag(Matrix* m, vector<int>& cofactor_nodes)
+{
+    PROFILE_SCOPE("closed_form.build_cofactor_dag");
+    DeterminantDag* dag = new DeterminantDag(m);
+    unsigned int all = full_mask(m->size);
+    cofactor_nodes.resize(m->size * m->size);
+    for (int i = 0; i < m->size; ++i)
+    {
+        for (int j = 0; j < m->size; ++j)
+        {
+            cofactor_nodes[i * m->size + j] = dag_minor_node(dag, all & ~(1u << i), all & ~(1u << j));
+        }
+    }
+    return dag;
+}
+
+/**
+ * @brief Interns the entry names of m in row-major order, so entry (i, j) is variable
+ * i * size + j.
+ * 
+ * @param m Matrix*
+ * @param table VariableTable*
+ */
+void intern_entries(Matrix* m, VariableTable* table)
+{
+    for (int entry = 0; entry < m->size * m->size; ++entry) intern_variable(table, m->matrix[entry]);
+}
+
+/**
+ * @brief Appends every term of node `id`, multiplied by coefficient * prefix, to the
+ * last polynomial in the arena. Terms come out in the same order as dag_render() writes
+ * them, straight into the arena.
+ * 
+ */
+void dag_expand_terms(DeterminantDag* dag, int id, int coefficient, vector<VariableId>& prefix, PolynomialArena* arena)
+{
+    const MinorNode& node = dag->nodes[id];
+    if (node.size == 0)
+    {
+        polynomial_add_term(arena, coefficient, prefix.data());
+        return;
+    }
+    int size = dag->matrix->size;
+    int first_row = __builtin_ctz(node.row_mask); // the masks are not empty from here on
+    if (node.size == 1)
+    {
+        prefix.push_back((VariableId)calculate_index(size, first_row, __builtin_ctz(node.col_mask)));
+        polynomial_add_term(arena, coefficient, prefix.data());
+        prefix.pop_back();
+        return;
+    }
+    if (node.size == 2)
+    {
+        int second_row = __builtin_ctz(node.row_mask & (node.row_mask - 1));
+        int left = __builtin_ctz(node.col_mask);
+        int right = __builtin_ctz(node.col_mask & (node.col_mask - 1));
+        prefix.push_back((VariableId)calculate_index(size, first_row, left));
+        prefix.push_back((VariableId)calculate_index(size, second_row, right));
+        polynomial_add_term(arena, coefficient, prefix.data());
+        prefix[prefix.size() - 2] = (VariableId)calculate_index(size, first_row, right);
+        prefix[prefix.size() - 1] = (VariableId)calculate_index(size, second_row, left);
+        polynomial_add_term(arena, -coefficient, prefix.data());
+        prefix.resize(prefix.size() - 2);
+        return;
+    }
+
+    unsigned int columns = node.col_mask;
+    for (int t = 0; columns; ++t, columns &= columns - 1)
+    {
+        prefix.push_back((VariableId)calculate_index(size, first_row, __builtin_ctz(columns)));
+        dag_expand_terms(dag, node.children[t], t % 2 == 1 ? -coefficient : coefficient, prefix, arena);
+        prefix.pop_back();
+    }
+}
+
+/**
+ * @brief Appends the fully expanded determinant of node `id` to the arena as a new
+ * polynomial over the entry variables, and returns its id.
+ * 
+ * @param dag DeterminantDag*
+ * @param id int
+ * @param coefficient int  1, or -1 to negate the determinant
+ * @param arena PolynomialArena*
+ * @return int
+ */
+int dag_expand(DeterminantDag* dag, int id, int coefficient, PolynomialArena* arena)
+{
+    int polynomial = polynomial_begin(arena, dag->nodes[id].size);
+    vector<VariableId> prefix;
+    prefix.reserve(dag->nodes[id].size);
+    dag_expand_terms(dag, id, coefficient, prefix, arena);
+    return polynomial;
+}
+
+/**
+ * @brief Fills the arena with the closed-form inverse as polynomials: entry (i, j) is
+ * polynomial i * dimension + j, the signed cofactor of (j, i), over variables named as
+ * populate_matrix() names the entries. Divide by the determinant to get the inverse.
+ * 
+ * Entries are expanded in parallel, a round of a few per thread at a time, each into its
+ * own arena, and then appended in entry order.
+ * 
+ * @param dimension int
+ * @param arena PolynomialArena*  Should be empty
+ * @param table VariableTable*  Should be empty
+ */
+void matrix_inverse_closed_form_polynomials(int dimension, PolynomialArena* arena, VariableTable* table)
+{
+    PROFILE_SCOPE("closed_form.inverse_polynomials");
+    Matrix* matrix = populate_matrix(dimension);
+    intern_entries(matrix, table);
+    vector<int> cofactor_nodes;
+    DeterminantDag* dag = build_cofactor_dag(matrix, cofactor_nodes);
+    int entries = dimension * dimension;
+    int round = FORMULA_PIECES_PER_THREAD * shared_thread_pool().size();
+    vector<PolynomialArena> expanded(min(entries, round));
+    for (int first = 0; first < entries; first += round)
+    {
+        int count = min(round, entries - first);
+        parallel_for(0, count, 1, [&](int begin, int end)
+        {
+            for (int e = begin; e < end; ++e)
+            {
+                int i = (first + e) / dimension;
+                int j = (first + e) % dimension;
+                expanded[e] = PolynomialArena();
+                dag_expand(dag, cofactor_nodes[j * dimension + i], (i + j) % 2 == 1 ? -1 : 1, &expanded[e]);
+            }
+        });
+        for (int e = 0; e < count; ++e) polynomial_append(arena, &expanded[e], 0);
+    }
+    delete dag;
+    delete matrix;
+}
+
 /**
  * @brief Returns a Matrix containing closed-form equations for each entry of the
  * inverse. Each equation must be divided by the determinant to get the proper entry.
  * 
+ * Entry (i, j) is the signed cofactor of (j, i): the cofactor matrix is transposed as
+ * it is written.
+ * 
  * @param dimension int  Dimension of a square matrix
  * @return Matrix*       Strings representing closed-form inverse equations
  */
 Matrix* matrix_inverse_closed_form(int dimension)
 {
     Matrix* matrix = populate_matrix(dimension);
+    vector<int> cofactor_nodes;
+    DeterminantDag* dag = build_cofactor_dag(matrix, cofactor_nodes);
+
     Matrix* matrix_inverse_closed_form = new Matrix(dimension);
+    matrix_inverse_closed_form->matrix.resize(dimension * dimension);
+    // Every entry is an independent cofactor job, run as one task each on the shared pool.
+    // The DAG is only read from here on, so the tasks can share it.
+    parallel_for(0, dimension * dimension, 1, [&](int entry_begin, int entry_end)
+    {
+        for (int entry = entry_begin; entry < entry_end; ++entry)
+        {
+            int row = entry / dimension;
+            int col = entry % dimension;
+            string formula = (row + col) % 2 == 1 ? "-" : "";
+            dag_render(dag, cofactor_nodes[col * dimension + row], formula);
+            matrix_inverse_closed_form->matrix[entry] = formula;
+        }
+    });
+    delete dag;
+    delete matrix;
+    return matrix_inverse_closed_form;
+}
+
+/**
+ * @brief Writes the closed-form inverse of a dimension x dimension matrix to the sink,
+ * encoded like export_as_str(). Only the DAG of minors and one round of pieces (see
+ * ParallelFormulaWriter) are held in memory, never the whole formulas, so sizes whose
+ * text is gigabytes long can still be written to a file or piped to another program.
+ * The entries, and the branches of large entries, are rendered in parallel.
+ * 
+ * @param dimension int
+ * @param out FormulaSink&
+ */
+void write_inverse_closed_form(int dimension, FormulaSink& out)
+{
+    PROFILE_SCOPE("closed_form.write_inverse");
+    Matrix* matrix = populate_matrix(dimension);
+    vector<int> cofactor_nodes;
+    DeterminantDag* dag = build_cofactor_dag(matrix, cofactor_nodes);
+    ParallelFormulaWriter writer(dag, &out);
+    for (int i = 0; i < dimension && !out.failed; ++i)
+    {
+        for (int j = 0; j < dimension; ++j)
+        {
+            if ((i + j) % 2 == 1) formula_writer_literal(&writer, "-");
+            formula_writer_node(&writer, cofactor_nodes[j * dimension + i]);
+            formula_writer_literal(&writer, ",");
+        }
+        formula_writer_literal(&writer, "\n,");
+    }
+    formula_writer_flush(&writer);
+    out.finish();
+    delete dag;
+    delete matrix;
+}
+
+/**
+ * @brief Writes the inverse formulas with shared minors written once, for sizes whose
+ * fully expanded formulas are too large to produce. One line per DAG node, children
+ * first ("m7=(22*33-23*32)", "m9=((11)m7-(12)m8+(13)m5)"), then the inverse entries
+ * encoded like export_as_str() as references to nodes ("m12,-m15,...,\n,").
+ * 
+ * @param dimension int
+ * @param out FormulaSink&
+ */
+void write_inverse_closed_form_dag(int dimension, FormulaSink& out)
+{
+    PROFILE_SCOPE("closed_form.write_inverse_dag");
+    Matrix* matrix = populate_matrix(dimension);
+    vector<int> cofactor_nodes;
+    DeterminantDag* dag = build_cofactor_dag(matrix, cofactor_nodes);
+
+    for (int id = 0; id < (int)dag->nodes.size(); ++id)
+    {
+        const MinorNode& node = dag->nodes[id];
+        out.write("m" + to_string(id) + "=");
+        if (node.size <= 2)
+        {
+            dag_render(dag, id, out);
+        } else
+        {
+            int first_row = __builtin_ctz(node.row_mask);
+            out.write("(", 1);
+            unsigned int columns = node.col_mask;
+            for (int t = 0; columns; ++t, columns &= columns - 1)
+            {
+                const string& entry = matrix->matrix[calculate_index(dimension, first_row, __builtin_ctz(columns))];
+                if (t % 2 == 1) out.write("-(", 2);
+                else out.write(t != 0 ? "+(" : "(");
+                out.write(entry);
+                out.write(")m" + to_string(node.children[t]));
+            }
+            out.write(")", 1);
+        }
+        out.write("\n", 1);
+    }
     for (int i = 0; i < dimension; ++i)
     {
         for (int j = 0; j < dimension; ++j)
         {
-            Matrix* minor_matrix = get_minor_matrix(matrix, i, j);
-            matrix_inverse_closed_form->matrix.push_back(matrix_determinant_closed_form(minor_matrix));
-            delete minor_matrix;
+            out.write(((i + j) % 2 == 1 ? "-m" : "m") + to_string(cofactor_nodes[j * dimension + i]) + ",");
         }
+        out.write("\n,", 2);
     }
+    out.finish();
+    delete dag;
+    delete matrix;
+}
+
+void dag_render_simplified(DeterminantDag* dag, int id, const vector<int>& temporaries, bool negate, FormulaSink& out);
+
+/**
+ * @brief Writes node `id` where it is one factor of a product, or a whole entry: an entry
+ * name, the temporary holding the minor, or the minor itself (in parentheses when it is
+ * a factor with more than one term).
+ * 
+ */
+void dag_render_operand(DeterminantDag* dag, int id, const vector<int>& temporaries, bool negate, bool factor, FormulaSink& out)
+{
+    const MinorNode& node = dag->nodes[id];
+    Matrix* m = dag->matrix;
+    if (node.size <= 1 || temporaries[id] > 0)
+    {
+        if (negate) out.write("-", 1);
+        if (temporaries[id] > 0) out.write("t" + to_string(temporaries[id]));
+        else if (node.size == 0) out.write("1", 1);
+        else out.write(m->matrix[calculate_index(m->size, __builtin_ctz(node.row_mask), __builtin_ctz(node.col_mask))]);
+        return;
+    }
+    if (factor) out.write("(", 1);
+    dag_render_simplified(dag, id, temporaries, negate, out);
+    if (factor) out.write(")", 1);
+}
+
+/**
+ * @brief Writes the determinant of node `id` (size 2 or more) as a signed sum of
+ * products with no redundant parentheses, e.g. "11*t4-12*t7+13*(21*32-22*31)", negated
+ * when `negate` is set. Minors with a temporary (temporaries[id] > 0) are referred to
+ * by its name, t<number>.
+ * 
+ * @param dag DeterminantDag*
+ * @param id int
+ * @param temporaries const vector<int>&  Temporary number of every node, 0 for none
+ * @param negate bool
+ * @param out FormulaSink&
+ */
+void dag_render_simplified(DeterminantDag* dag, int id, const vector<int>& temporaries, bool negate, FormulaSink& out)
+{
+    const MinorNode& node = dag->nodes[id];
+    Matrix* m = dag->matrix;
+    int first_row = __builtin_ctz(node.row_mask);
+    if (node.size == 2)
+    {
+        int second_row = __builtin_ctz(node.row_mask & (node.row_mask - 1));
+        int left = __builtin_ctz(node.col_mask);
+        int right = __builtin_ctz(node.col_mask & (node.col_mask - 1));
+        if (negate) out.write("-", 1);
+        out.write(m->matrix[calculate_index(m->size, first_row, left)]);
+        out.write("*", 1);
+        out.write(m->matrix[calculate_index(m->size, second_row, right)]);
+        out.write(negate ? "+" : "-", 1);
+        out.write(m->matrix[calculate_index(m->size, first_row, right)]);
+        out.write("*", 1);
+        out.write(m->matrix[calculate_index(m->size, second_row, left)]);
+        return;
+    }
+    unsigned int columns = node.col_mask;
+    for (int t = 0; columns; ++t, columns &= columns - 1)
+    {
+        if ((t % 2 == 1) != negate) out.write("-", 1);
+        else if (t != 0) out.write("+", 1);
+        out.write(m->matrix[calculate_index(m->size, first_row, __builtin_ctz(columns))]);
+        out.write("*", 1);
+        dag_render_operand(dag, node.children[t], temporaries, false, true, out);
+    }
+}
+
+/**
+ * @brief Writes the closed-form inverse in simplified form: every minor used by more
+ * than one larger minor or entry is written once, as a temporary ("t1=22*33-23*32",
+ * "t5=11*t1-12*t2+13*t3"), defined before it is used; minors used once are written in
+ * place. Expressions are signed sums of products, with no "(-1)" factors or redundant
+ * parentheses. Then come the inverse entries, encoded like export_as_str()
+ * ("t12,-t15,...,\n,").
+ * 
+ * @param dimension int
+ * @param out FormulaSink&
+ */
+void write_inverse_closed_form_simplified(int dimension, FormulaSink& out)
+{
+    PROFILE_SCOPE("closed_form.write_inverse_simplified");
+    Matrix* matrix = populate_matrix(dimension);
+    vector<int> cofactor_nodes;
+    DeterminantDag* dag = build_cofactor_dag(matrix, cofactor_nodes);
+
+    vector<int> uses(dag->nodes.size(), 0);
+    for (const MinorNode& node : dag->nodes)
+    {
+        for (int child : node.children) uses[child]++;
+    }
+    for (int root : cofactor_nodes) uses[root]++;
+    vector<int> temporaries(dag->nodes.size(), 0);
+    int count = 0;
+    for (int id = 0; id < (int)dag->nodes.size(); ++id) // children come first, so temporaries are defined before use
+    {
+        if (uses[id] < 2 || dag->nodes[id].size < 2) continue;
+        temporaries[id] = ++count;
+        out.write("t" + to_string(count) + "=");
+        dag_render_simplified(dag, id, temporaries, false, out);
+        out.write("\n", 1);
+    }
+    for (int i = 0; i < dimension; ++i)
+    {
+        for (int j = 0; j < dimension; ++j)
+        {
+            dag_render_operand(dag, cofactor_nodes[j * dimension + i], temporaries, (i + j) % 2 == 1, false, out);
+            out.write(",", 1);
+        }
+        out.write("\n,", 2);
+    }
+    out.finish();
+    delete dag;
+    delete matrix;
+}
+
+/**
+ * @brief The C++ expression for node `id` inside a generated kernel: a copied input
+ * entry for 1x1 minors, otherwise the temporary holding the minor.
+ * 
+ */
+string kernel_operand(DeterminantDag* dag, int id)
+{
+    const MinorNode& node = dag->nodes[id];
+    if (node.size == 0) return "1.0";
+    if (node.size == 1) return "a" + to_string(calculate_index(dag->matrix->size, __builtin_ctz(node.row_mask), __builtin_ctz(node.col_mask)));
+    return "m" + to_string(id);
+}
+
+/**
+ * @brief Writes a C++ header defining
+ * 
+ *     inline void inverse_NxN(const double* matrix, double* inverse)
+ * 
+ * for N = dimension (both arrays row-major, N * N doubles; they may be the same array).
+ * The body is straight-line code generated from the cofactor DAG: every distinct minor
+ * is computed once into a temporary, so common subexpressions are shared, and the
+ * determinant reuses the cofactors of the first row. A singular matrix gives inf/nan.
+ * 
+ * @param dimension int
+ * @param out FormulaSink&
+ */
+void write_inverse_kernel_header(int dimension, FormulaSink& out)
+{
+    PROFILE_SCOPE("closed_form.write_kernel_header");
+    Matrix* matrix = populate_matrix(dimension);
+    vector<int> cofactor_nodes;
+    DeterminantDag* dag = build_cofactor_dag(matrix, cofactor_nodes);
+    string size = to_string(dimension) + "x" + to_string(dimension);
+    string guard = "INVERSE_" + to_string(dimension) + "X" + to_string(dimension) + "_H";
+
+    out.write("// Generated by `inverse_closed_form --header " + to_string(dimension) + "`. Do not edit.\n");
+    out.write("#ifndef " + guard + "\n#define " + guard + "\n\n");
+    out.write("inline void inverse_" + size + "(const double* matrix, double* inverse)\n{\n");
+    for (int entry = 0; entry < dimension * dimension; ++entry)
+    {
+        out.write("    const double a" + to_string(entry) + " = matrix[" + to_string(entry) + "];\n");
+    }
+    for (int id = 0; id < (int)dag->nodes.size(); ++id) // children always come before their parents
+    {
+        const MinorNode& node = dag->nodes[id];
+        if (node.size < 2) continue;
+        out.write("    const double m" + to_string(id) + " = ");
+        int first_row = __builtin_ctz(node.row_mask);
+        if (node.size == 2)
+        {
+            int second_row = __builtin_ctz(node.row_mask & (node.row_mask - 1));
+            int left = __builtin_ctz(node.col_mask);
+            int right = __builtin_ctz(node.col_mask & (node.col_mask - 1));
+            out.write("a" + to_string(calculate_index(dimension, first_row, left)) + " * a" + to_string(calculate_index(dimension, second_row, right))
+                      + " - a" + to_string(calculate_index(dimension, first_row, right)) + " * a" + to_string(calculate_index(dimension, second_row, left)));
+        } else
+        {
+            unsigned int columns = node.col_mask;
+            for (int t = 0; columns; ++t, columns &= columns - 1)
+            {
+                if (t != 0) out.write(t % 2 == 1 ? " - " : " + ");
+                out.write("a" + to_string(calculate_index(dimension, first_row, __builtin_ctz(columns))) + " * " + kernel_operand(dag, node.children[t]));
+            }
+        }
+        out.write(";\n");
+    }
+    out.write("    const double det = ");
+    for (int j = 0; j < dimension; ++j)
+    {
+        if (j != 0) out.write(j % 2 == 1 ? " - " : " + ");
+        out.write("a" + to_string(j) + " * " + kernel_operand(dag, cofactor_nodes[j]));
+    }
+    out.write(";\n    const double r = 1.0 / det;\n");
+    for (int i = 0; i < dimension; ++i)
+    {
+        for (int j = 0; j < dimension; ++j)
+        {
+            out.write("    inverse[" + to_string(i * dimension + j) + "] = " + ((i + j) % 2 == 1 ? "-" : "")
+                      + kernel_operand(dag, cofactor_nodes[j * dimension + i]) + " * r;\n");
+        }
+    }
+    out.write("}\n\n#endif\n");
+    out.finish();
+    delete dag;
     delete matrix;
-    return matrix_inverse_closed_form;
+}
+
+/**
+ * @brief Compiles the closed-form inverse of the given size into a FormulaProgram over
+ * the n * n entries (row-major), with the n * n entries of the inverse as outputs. It
+ * computes the same values as the kernel of write_inverse_kernel_header(): every
+ * distinct minor once, then the determinant from the first-row cofactors, then each
+ * cofactor times 1 / det. A singular matrix gives inf/nan.
+ * 
+ * @param dimension int
+ * @param program FormulaProgram*
+ */
+void compile_inverse_program(int dimension, FormulaProgram* program)
+{
+    PROFILE_SCOPE("closed_form.compile_inverse_program");
+    Matrix* matrix = populate_matrix(dimension);
+    vector<int> cofactor_nodes;
+    DeterminantDag* dag = build_cofactor_dag(matrix, cofactor_nodes);
+    formula_program_begin(program, dimension * dimension);
+    int one = formula_program_constant(program, 1.0);
+
+    vector<int> value(dag->nodes.size()); // register holding each minor
+    for (int id = 0; id < (int)dag->nodes.size(); ++id) // children always come before their parents
+    {
+        const MinorNode& node = dag->nodes[id];
+        if (node.size == 0) { value[id] = one; continue; }
+        int first_row = __builtin_ctz(node.row_mask); // the masks are not empty from here on
+        if (node.size == 1) { value[id] = calculate_index(dimension, first_row, __builtin_ctz(node.col_mask)); continue; }
+        if (node.size == 2)
+        {
+            int second_row = __builtin_ctz(node.row_mask & (node.row_mask - 1));
+            int left = __builtin_ctz(node.col_mask);
+            int right = __builtin_ctz(node.col_mask & (node.col_mask - 1));
+            value[id] = formula_program_emit(program, FORMULA_OP_MUL, 0, calculate_index(dimension, first_row, left), calculate_index(dimension, second_row, right));
+            formula_program_emit(program, FORMULA_OP_MUL_SUB, value[id], calculate_index(dimension, first_row, right), calculate_index(dimension, second_row, left));
+            continue;
+        }
+        unsigned int columns = node.col_mask;
+        for (int t = 0; columns; ++t, columns &= columns - 1)
+        {
+            int entry = calculate_index(dimension, first_row, __builtin_ctz(columns));
+            if (t == 0) value[id] = formula_program_emit(program, FORMULA_OP_MUL, 0, entry, value[node.children[t]]);
+            else formula_program_emit(program, t % 2 == 1 ? FORMULA_OP_MUL_SUB : FORMULA_OP_MUL_ADD, value[id], entry, value[node.children[t]]);
+        }
+    }
+
+    int determinant = formula_program_emit(program, FORMULA_OP_MUL, 0, 0, value[cofactor_nodes[0]]);
+    for (int j = 1; j < dimension; ++j)
+    {
+        formula_program_emit(program, j % 2 == 1 ? FORMULA_OP_MUL_SUB : FORMULA_OP_MUL_ADD, determinant, j, value[cofactor_nodes[j]]);
+    }
+    int reciprocal = formula_program_emit(program, FORMULA_OP_DIVIDE, 0, one, determinant);
+    for (int i = 0; i < dimension; ++i)
+    {
+        for (int j = 0; j < dimension; ++j)
+        {
+            int op = (i + j) % 2 == 1 ? FORMULA_OP_NEG_MUL : FORMULA_OP_MUL;
+            program->outputs.push_back(formula_program_emit(program, op, 0, value[cofactor_nodes[j * dimension + i]], reciprocal));
+        }
+    }
+    formula_program_allocate(program);
+    delete dag;
+    delete matrix;
+}
+
+/**
+ * @brief The compiled inverse program for the given size, built on first use and kept
+ * (one per size, per thread).
+ * 
+ */
+const FormulaProgram* inverse_program(int dimension)
+{
+    thread_local unordered_map<int, FormulaProgram> programs;
+    unordered_map<int, FormulaProgram>::iterator found = programs.find(dimension);
+    if (found != programs.end()) return &found->second;
+    FormulaProgram* program = &programs[dimension];
+    compile_inverse_program(dimension, program);
+    return program;
+}
+
+/**
+ * @brief Returns the output of write_inverse_closed_form_dag() as one string.
+ * 
+ * @param dimension int
+ * @return string 
+ */
+string matrix_inverse_closed_form_dag(int dimension)
+{
+    string out;
+    StringSink sink(&out);
+    write_inverse_closed_form_dag(dimension, sink);
+    return out;
 }
 
 /**
@@ -180,47 +1015,262 @@ Matrix* matrix_inverse_closed_form(int dimension)
  * 
  * @example (1,2,3),(4,5,6),(7,7,7) is encoded as "1,2,3,\n,4,5,6,\n,7,7,7,\n,"
  * 
+ * The returned pointer stays valid until the next call on the same thread. For large
+ * matrices prefer write_inverse_closed_form(), which never holds the whole text.
+ * 
  * @param m 
  * @return const char* 
  */
 const char* export_as_str(Matrix* m)
 {
-    string str = "";
+    PROFILE_SCOPE("closed_form.export_as_str");
+    thread_local string str;
+    str = "";
+    StringSink sink(&str);
     for (int i = 0; i < m->size; ++i)
     {
         for (int j = 0; j < m->size; ++j)
         {
-            str += matrix_get(m, i, j) + ","; // PROBLEM!!!!!! BIG STRING ALERT!!! WHATCHA GONNA DO ABOUT THAT?>???????
+            sink.write(m->matrix[calculate_index(m->size, i, j)]);
+            sink.write(",", 1);
         }
-        str += "\n,";
+        sink.write("\n,", 2);
     }
+    sink.finish();
     return str.c_str();
 }
 
+// Part of every cache key: bump when the text written for any variant changes, so
+// files written by an older version are no longer found.
+const int CLOSED_FORM_FORMAT_VERSION = 1;
+
+/**
+ * @brief The formula cache used by the JS_interact functions. It starts out disabled,
+ * or pointed at the MATRIX_INVERSE_CACHE_DIR environment variable if that is set.
+ * 
+ * @return FormulaCache*
+ */
+FormulaCache* closed_form_cache()
+{
+    static FormulaCache* cache = []()
+    {
+        FormulaCache* created = new FormulaCache();
+        const char* directory = getenv("MATRIX_INVERSE_CACHE_DIR");
+        if (directory && *directory) formula_cache_warm_start(created, directory);
+        return created;
+    }();
+    return cache;
+}
+
+/**
+ * @brief Returns the cached text of one formula variant ("inverse", "inverse_dag",
+ * "inverse_simplified" or "determinant") for the given size, generating and storing it on a miss. Returns
+ * nullptr when no cache directory is set.
+ * 
+ * @param variant const char*
+ * @param dimension int
+ * @return const char* 
+ */
+const char* cached_closed_form(const char* variant, int dimension)
+{
+    string key = "closed_form/v" + to_string(CLOSED_FORM_FORMAT_VERSION) + "/" + variant + "/" + to_string(dimension);
+    string name = variant;
+    const MappedFormula* formula = formula_cache_get(closed_form_cache(), key, [&](FormulaSink& out)
+    {
+        if (name == "inverse") write_inverse_closed_form(dimension, out);
+        else if (name == "inverse_dag") write_inverse_closed_form_dag(dimension, out);
+        else if (name == "inverse_simplified") write_inverse_closed_form_simplified(dimension, out);
+        else write_determinant_closed_form(dimension, out);
+    });
+    return formula ? formula->text : nullptr;
+}
+
 extern "C"
 {
+    /**
+     * @brief Uses `directory` as the formula cache from now on (creating it if needed)
+     * and maps the formulas already in it. Returns how many were found, or -1 if the
+     * directory cannot be used.
+     * 
+     */
+    int matrix_inverse_closed_form_cache_dir(const char* directory)
+    {
+        return formula_cache_warm_start(closed_form_cache(), directory);
+    }
+
     const char* matrix_inverse_closed_form_JS_interact(int dimension)
     {
-        Matrix* m = matrix_inverse_closed_form(dimension);
-        const char* str = export_as_str(m);
-        delete m;
-        return str;
+        const char* cached = cached_closed_form("inverse", dimension);
+        if (cached) return cached;
+        thread_local string str; // returned to Javascript, so it must outlive this call
+        str = "";
+        StringSink sink(&str);
+        write_inverse_closed_form(dimension, sink);
+        return str.c_str();
+    }
+
+    /**
+     * @brief Streams the closed-form inverse to `write_chunk` in pieces of at most 64 KiB,
+     * so the page can append them to the output (or a download) without the WASM heap
+     * ever holding the whole formula. Build with -s ALLOW_TABLE_GROWTH=1 and export
+     * addFunction and UTF8ToString to create the callback from Javascript.
+     * 
+     * @return int 0
+     */
+    int matrix_inverse_closed_form_stream(int dimension, formula_chunk_callback write_chunk)
+    {
+        CallbackSink sink(write_chunk);
+        write_inverse_closed_form(dimension, sink);
+        return 0;
+    }
+
+    /**
+     * @brief Writes the closed-form inverse to an open file descriptor.
+     * 
+     * @return int 0, or -1 if a write failed
+     */
+    int matrix_inverse_closed_form_to_fd(int dimension, int fd)
+    {
+        FdSink sink(fd);
+        write_inverse_closed_form(dimension, sink);
+        return sink.failed ? -1 : 0;
+    }
+
+    /**
+     * @brief Writes the closed-form inverse to the file at `path`, replacing it.
+     * 
+     * @return int 0, or -1 if the file could not be opened or written
+     */
+    int matrix_inverse_closed_form_to_file(int dimension, const char* path)
+    {
+        FILE* file = fopen(path, "wb");
+        if (!file) return -1;
+        FileSink sink(file);
+        write_inverse_closed_form(dimension, sink);
+        bool failed = sink.failed;
+        if (fclose(file) != 0) failed = true;
+        return failed ? -1 : 0;
+    }
+
+    /**
+     * @brief The closed-form inverse with every entry multiplied out into a sum of signed
+     * products ("11*22*33-11*23*32+..."), encoded like export_as_str().
+     * 
+     */
+    const char* matrix_inverse_closed_form_expanded_JS_interact(int dimension)
+    {
+        thread_local string str; // returned to Javascript, so it must outlive this call
+        str = "";
+        PolynomialArena arena;
+        VariableTable table;
+        matrix_inverse_closed_form_polynomials(dimension, &arena, &table);
+        for (int entry = 0; entry < dimension * dimension; ++entry)
+        {
+            render_polynomial(&arena, entry, &table, str);
+            str += entry % dimension == dimension - 1 ? ",\n," : ",";
+        }
+        return str.c_str();
+    }
+
+    const char* matrix_inverse_closed_form_dag_JS_interact(int dimension)
+    {
+        const char* cached = cached_closed_form("inverse_dag", dimension);
+        if (cached) return cached;
+        thread_local string str; // returned to Javascript, so it must outlive this call
+        str = matrix_inverse_closed_form_dag(dimension);
+        return str.c_str();
+    }
+
+    /**
+     * @brief The closed-form inverse with shared minors hoisted into temporaries; see
+     * write_inverse_closed_form_simplified().
+     * 
+     */
+    const char* matrix_inverse_closed_form_simplified_JS_interact(int dimension)
+    {
+        const char* cached = cached_closed_form("inverse_simplified", dimension);
+        if (cached) return cached;
+        thread_local string str; // returned to Javascript, so it must outlive this call
+        str = "";
+        StringSink sink(&str);
+        write_inverse_closed_form_simplified(dimension, sink);
+        return str.c_str();
+    }
+
+    /**
+     * @brief Evaluates the compiled closed-form inverse (compile_inverse_program()) for
+     * `count` matrices, in the structure-of-arrays layout of matrix_inverse_batch():
+     * entry e of matrix b at matrices[e * count + b], and the same for `inverses`. Both
+     * are addresses in the WASM heap. The program is compiled once per size. There is no
+     * pivoting, so this suits well-conditioned matrices; a singular one gives inf/nan.
+     * 
+     * @return int 0, or -1 if the dimension is not 1 to 8
+     */
+    int evaluate_inverse_closed_form(int dimension, int count, const double* matrices, double* inverses)
+    {
+        if (dimension < 1 || dimension > 8) return -1;
+        PROFILE_SCOPE("closed_form.evaluate_inverse");
+        evaluate_formula_program(inverse_program(dimension), count, matrices, inverses);
+        return 0;
     }
 
     const char* matrix_determinant_closed_form_JS_interact(int dimension)
     {
+        const char* cached = cached_closed_form("determinant", dimension);
+        if (cached) return cached;
+        thread_local string str; // returned to Javascript, so it must outlive this call
         Matrix* m = populate_matrix(dimension);
-        const char* str = matrix_determinant_closed_form(m).c_str();
+        str = matrix_determinant_closed_form(m);
         delete m;
-        return str;
+        return str.c_str();
     }
 }
 
-int main()
+#ifndef MATRIX_INVERSE_NO_MAIN // define when including this file from a benchmark
+/**
+ * @brief Writes the closed-form inverse of the given size (default 11) to stdout, e.g.
+ * ./inverse_closed_form 10 > inverse_10.txt
+ * 
+ * With --header, writes the generated C++ kernel instead, e.g.
+ * ./inverse_closed_form --header 4 > closed_form_kernels/inverse_4x4.h
+ * 
+ * With --simplified, writes the inverse with shared minors as temporaries, e.g.
+ * ./inverse_closed_form --simplified 12 > inverse_12.txt
+ * 
+ * With --pregenerate, fills a cache directory with every formula variant for a range of
+ * sizes (default 2 to 9), e.g. ./inverse_closed_form --pregenerate formula_cache 2 10
+ * 
+ */
+int main(int argc, char** argv)
 {
-    const char* output = matrix_inverse_closed_form_JS_interact(11);
-    char ch = 1;
-    string test = output;
-    cout <<test; // these outputs are huge...................
-    return 1;
+    string mode = argc > 1 ? argv[1] : "";
+    if (mode == "--pregenerate")
+    {
+        if (argc < 3) { cerr << "usage: inverse_closed_form --pregenerate DIRECTORY [FROM] [TO]\n"; return 2; }
+        int from = argc > 3 ? atoi(argv[3]) : 2;
+        int to = argc > 4 ? atoi(argv[4]) : 9;
+        if (formula_cache_warm_start(closed_form_cache(), argv[2]) < 0) { cerr << "cannot use " << argv[2] << "\n"; return 1; }
+        const char* variants[] = { "determinant", "inverse_dag", "inverse_simplified", "inverse" };
+        for (int dimension = from; dimension <= to; ++dimension)
+        {
+            for (const char* variant : variants)
+            {
+                if (!cached_closed_form(variant, dimension)) { cerr << "failed to write " << variant << " " << dimension << "\n"; return 1; }
+                cerr << variant << " " << dimension << "\n";
+            }
+        }
+        return 0;
+    }
+
+    bool header = mode == "--header";
+    bool simplified = mode == "--simplified";
+    int argument = header || simplified ? 2 : 1;
+    int dimension = argc > argument ? atoi(argv[argument]) : 11;
+    FileSink out(stdout);
+    if (header) write_inverse_kernel_header(dimension, out);
+    else if (simplified) write_inverse_closed_form_simplified(dimension, out);
+    else write_inverse_closed_form(dimension, out); // these outputs are huge, so they are never held in memory
+    fflush(stdout);
+    return out.failed ? 1 : 0;
 }
+#endif
@@ -1,152 +1,2379 @@
 #include <vector>
 #include <iostream>
 #include <string>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <climits>
+#include <cstdint>
+#include <memory>
+
+#include "gemm_kernels.h"
+#include "thread_pool.h"
+#include "matrix_file.h"
+#include "exact_inverse.h"
+#include "profiling.h"
+#include "matrix_text.h"
 
 using namespace std;
 
 /**
- * @brief Defines a matrix using double[]. Represents a 2d matrix with 1d array
- * using index arithmetic.
+ * @brief Defines a matrix using double[]. Represents a 2d matrix with 1d array
+ * using index arithmetic. The entries are either held in `matrix` or, for matrices
+ * too large for memory, in a mapped matrix file (see matrix_file.h); use
+ * matrix_data() to reach them either way.
+ * 
+ */
+class Matrix
+{
+    public:
+    int size;
+    vector<double> matrix;
+    shared_ptr<MatrixMapping> mapping; // set when the entries live in a mapped file
+    double* mapped; // those entries, or nullptr
+
+    Matrix(int _size)
+    {
+        size = _size;
+        mapped = nullptr;
+    }
+
+    Matrix(int _size, vector<double> _matrix)
+    {
+        matrix = _matrix;
+        size = _size;
+        mapped = nullptr;
+    }
+
+    Matrix(int _size, shared_ptr<MatrixMapping> _mapping)
+    {
+        size = _size;
+        mapping = _mapping;
+        mapped = (double*)_mapping->data();
+    }
+};
+
+/**
+ * @brief The size * size row-major entries of m, wherever they are stored.
+ * 
+ * @param m Matrix*
+ * @return double* 
+ */
+double* matrix_data(Matrix* m) { return m->mapped ? m->mapped : m->matrix.data(); }
+
+
+/**
+ * @brief Handles index arithmetic for 2d->1d array.
+ * 
+ * @param size int 
+ * @param row int  2d index
+ * @param col int  2d index
+ * @return int     1d index
+ */
+size_t calculate_index(int size, int row, int col) { return ((size_t)row * size) + col; }
+
+
+/**
+ * @brief Gets the value at (row, col).
+ * 
+ * @param m Matrix*
+ * @param row int
+ * @param col int
+ * @return double 
+ */
+double matrix_get(Matrix* m, int row, int col)
+{
+    if (m->mapped) return m->mapped[calculate_index(m->size, row, col)];
+    return m->matrix.at(calculate_index(m->size, row, col));
+}
+
+/**
+ * @brief Holds an LU factorization with partial pivoting, PA = LU. L (unit diagonal,
+ * not stored) and U are packed into a single matrix. pivots[k] is the row that was
+ * swapped into row k at step k.
+ * 
+ */
+class LUDecomposition
+{
+    public:
+    Matrix* lu;
+    vector<int> pivots;
+    int pivot_sign;  // +1 or -1, parity of the row swaps
+    bool singular;
+
+    LUDecomposition(Matrix* _lu)
+    {
+        lu = _lu;
+        pivots = vector<int>(_lu->size);
+        pivot_sign = 1;
+        singular = false;
+    }
+
+    ~LUDecomposition() { delete lu; }
+};
+
+// Panel width of the blocked algorithms. Passing the matrix size instead gives the
+// plain unblocked algorithm, which is what the benchmark compares against.
+const int LU_BLOCK_SIZE = 96;
+
+/**
+ * @brief Chunk size for splitting `count` rows or columns into tasks: a few chunks per
+ * thread so stealing can even out the load, but never so small that tasks are overhead.
+ * 
+ * @param count int
+ * @param minimum int  Smallest useful chunk
+ * @return int 
+ */
+int parallel_grain(int count, int minimum)
+{
+    int threads = shared_thread_pool().size();
+    if (threads == 1) return max(1, count);
+    int grain = (count + 3 * threads - 1) / (3 * threads);
+    return max(minimum, (grain + 15) / 16 * 16);
+}
+
+/**
+ * @brief Factors the kb columns starting at column k0 (rows k0 and below) of the block
+ * `a` with the unblocked algorithm. Pivot rows are swapped across all cols columns of
+ * the block.
+ * 
+ * The block starts at row and column `base` of the factored matrix, so its row i is row
+ * base + i there; that is how the pivots are recorded.
+ * 
+ * The entries may be float or double (see mixed_precision_inverse_into()).
+ * 
+ * @param decomposition LUDecomposition*  Receives pivots, pivot sign and the singular flag
+ * @param a T*  rows x cols block, row-major with leading dimension lda
+ * @param rows int
+ * @param cols int
+ * @param lda int
+ * @param base int
+ * @param k0 int  First column of the panel
+ * @param kb int  Panel width
+ * @param tolerance double  Pivots at or below this magnitude are treated as zero
+ */
+template <class T>
+void lu_factor_panel(LUDecomposition* decomposition, T* a, int rows, int cols, int lda, int base, int k0, int kb, double tolerance)
+{
+    for (int k = k0; k < k0 + kb; ++k)
+    {
+        int pivot_row = k; // find the largest entry in column k, at or below the diagonal
+        for (int i = k + 1; i < rows; ++i)
+        {
+            if (fabs(a[(size_t)i * lda + k]) > fabs(a[(size_t)pivot_row * lda + k])) pivot_row = i;
+        }
+        decomposition->pivots[base + k] = base + pivot_row;
+        if (pivot_row != k)
+        {
+            swap_ranges(a + (size_t)k * lda, a + (size_t)k * lda + cols, a + (size_t)pivot_row * lda);
+            decomposition->pivot_sign = -decomposition->pivot_sign;
+        }
+
+        T pivot = a[(size_t)k * lda + k];
+        if (fabs(pivot) <= tolerance)
+        {
+            decomposition->singular = true;
+            continue; // nothing to eliminate with; keep factoring so the determinant is still defined
+        }
+
+        // Eliminate below the pivot, storing the multipliers in L. Rows are independent,
+        // so tall panels are split across the pool.
+        parallel_for(k + 1, rows, parallel_grain(rows - k - 1, 512), [&](int row_begin, int row_end)
+        {
+            for (int i = row_begin; i < row_end; ++i)
+            {
+                T* row = a + (size_t)i * lda;
+                T multiplier = row[k] / pivot;
+                row[k] = multiplier;
+                if (multiplier == 0) continue;
+                axpy_subtract(k0 + kb - k - 1, multiplier, a + (size_t)k * lda + k + 1, row + k + 1);
+            }
+        });
+    }
+}
+
+/**
+ * @brief Overwrites the n x ncols block b with L^-1 b, where L is the unit lower
+ * triangle of the n x n block l. Each block row first subtracts the contribution of
+ * every block row already solved (one large matrix multiply), then is solved with
+ * contiguous row operations inside the block.
+ * 
+ * @param l const T*  Row-major with leading dimension ldl
+ * @param ldl int
+ * @param n int
+ * @param b T*  Row-major with leading dimension ldb
+ * @param ldb int
+ * @param ncols int
+ * @param block_size int
+ */
+template <class T>
+void lu_forward_substitute(const T* l, int ldl, int n, T* b, int ldb, int ncols, int block_size = LU_BLOCK_SIZE)
+{
+    for (int k0 = 0; k0 < n; k0 += block_size)
+    {
+        int kb = min(block_size, n - k0);
+        gemm_subtract(kb, ncols, k0, l + (size_t)k0 * ldl, ldl, b, ldb, b + (size_t)k0 * ldb, ldb);
+        for (int i = k0 + 1; i < k0 + kb; ++i)
+        {
+            for (int k = k0; k < i; ++k)
+            {
+                T multiplier = l[(size_t)i * ldl + k];
+                if (multiplier == 0) continue;
+                axpy_subtract(ncols, multiplier, b + (size_t)k * ldb, b + (size_t)i * ldb);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Overwrites the n x ncols block b with U^-1 b, where U is the upper triangle of
+ * the n x n block u: lu_forward_substitute() run backwards, dividing by the diagonal.
+ * 
+ * @param u const T*  Row-major with leading dimension ldu
+ * @param ldu int
+ * @param n int
+ * @param b T*  Row-major with leading dimension ldb
+ * @param ldb int
+ * @param ncols int
+ * @param block_size int
+ */
+template <class T>
+void lu_back_substitute(const T* u, int ldu, int n, T* b, int ldb, int ncols, int block_size = LU_BLOCK_SIZE)
+{
+    int last_block = ((n - 1) / block_size) * block_size;
+    for (int k0 = last_block; k0 >= 0; k0 -= block_size)
+    {
+        int kb = min(block_size, n - k0);
+        int rest = k0 + kb;
+        gemm_subtract(kb, ncols, n - rest, u + (size_t)k0 * ldu + rest, ldu, b + (size_t)rest * ldb, ldb, b + (size_t)k0 * ldb, ldb);
+        for (int i = k0 + kb - 1; i >= k0; --i)
+        {
+            T* row = b + (size_t)i * ldb;
+            for (int k = i + 1; k < rest; ++k)
+            {
+                T entry = u[(size_t)i * ldu + k];
+                if (entry == 0) continue;
+                axpy_subtract(ncols, entry, b + (size_t)k * ldb, row);
+            }
+            T reciprocal = 1 / u[(size_t)i * ldu + i];
+            for (int j = 0; j < ncols; ++j) row[j] *= reciprocal;
+        }
+    }
+}
+
+/**
+ * @brief Factors the rows x cols block `a` (rows >= cols) in place with the right-looking
+ * blocked algorithm: factor a panel of columns, solve for the matching block row of U,
+ * then update the trailing matrix with one large matrix multiply. See lu_factor_panel()
+ * for `base`.
+ * 
+ * @param decomposition LUDecomposition*
+ * @param a T*  Row-major with leading dimension lda
+ * @param rows int
+ * @param cols int
+ * @param lda int
+ * @param base int
+ * @param tolerance double
+ * @param block_size int  Panel width
+ */
+template <class T>
+void lu_factor_block(LUDecomposition* decomposition, T* a, int rows, int cols, int lda, int base, double tolerance, int block_size)
+{
+    for (int k0 = 0; k0 < cols; k0 += block_size)
+    {
+        int kb = min(block_size, cols - k0);
+        lu_factor_panel(decomposition, a, rows, cols, lda, base, k0, kb, tolerance);
+
+        int rest = k0 + kb; // first column/row of the trailing matrix
+        if (rest == cols) break;
+        // Each task owns a stripe of columns of the trailing matrix.
+        parallel_for(rest, cols, parallel_grain(cols - rest, 64), [&](int col_begin, int col_end)
+        {
+            int width = col_end - col_begin;
+            T* u12 = a + (size_t)k0 * lda + col_begin;
+            lu_forward_substitute(a + (size_t)k0 * lda + k0, lda, kb, u12, lda, width, kb); // U12 = L11^-1 A12
+            // A22 -= L21 * U12
+            gemm_subtract(rows - rest, width, kb, a + (size_t)rest * lda + k0, lda, u12, lda, a + (size_t)rest * lda + col_begin, lda);
+        });
+    }
+}
+
+/**
+ * @brief Pivots at or below this magnitude are treated as zero: negligible relative to
+ * the largest entry `scale` of an n x n matrix.
+ * 
+ */
+double lu_tolerance(double scale, int n) { return scale * n * numeric_limits<double>::epsilon(); }
+
+/**
+ * @brief Factorizes m as PA = LU using partial pivoting. The matrix is flagged as
+ * singular when a pivot is negligible relative to the largest entry of m.
+ * 
+ * @param entries const double*  n x n row-major matrix (copied, not modified)
+ * @param n int
+ * @param block_size int  Panel width
+ * @return LUDecomposition* 
+ */
+LUDecomposition* lu_decompose(const double* entries, int n, int block_size = LU_BLOCK_SIZE)
+{
+    PROFILE_SCOPE("real_valued.lu_decompose");
+    size_t count = (size_t)n * n;
+    LUDecomposition* decomposition = new LUDecomposition(new Matrix(n, vector<double>(entries, entries + count)));
+    double* a = matrix_data(decomposition->lu);
+
+    double scale = 0;
+    for (size_t i = 0; i < count; ++i) scale = max(scale, fabs(a[i]));
+    lu_factor_block(decomposition, a, n, n, n, 0, lu_tolerance(scale, n), block_size);
+    return decomposition;
+}
+
+LUDecomposition* lu_decompose(Matrix* m, int block_size = LU_BLOCK_SIZE) { return lu_decompose(matrix_data(m), m->size, block_size); }
+
+/**
+ * @brief Determinant of the factored matrix: the pivot sign times the diagonal of U.
+ * 
+ * @param decomposition LUDecomposition*
+ * @return double 
+ */
+double lu_determinant(LUDecomposition* decomposition)
+{
+    double determinant = decomposition->pivot_sign;
+    for (int k = 0; k < decomposition->lu->size; ++k) determinant *= matrix_get(decomposition->lu, k, k);
+    return determinant;
+}
+
+/**
+ * @brief Calculates determinant of matrix m from its LU factorization.
+ * 
+ * @param m Matrix*
+ * @return double 
+ */
+double matrix_determinant(Matrix* m)
+{
+    LUDecomposition* decomposition = lu_decompose(m);
+    double determinant = lu_determinant(decomposition);
+    delete decomposition;
+    return determinant;
+}
+
+/**
+ * @brief Overwrites the n x ncols block b with (LU)^-1 b: forward substitution with L,
+ * then back substitution with U, one block row at a time (see lu_forward_substitute()).
+ * 
+ * @param decomposition LUDecomposition*  Non-singular factorization
+ * @param b double*  Right-hand sides, row-major with leading dimension ldb
+ * @param ldb int
+ * @param ncols int
+ * @param block_size int
+ */
+void lu_substitute(LUDecomposition* decomposition, double* b, int ldb, int ncols, int block_size = LU_BLOCK_SIZE)
+{
+    int n = decomposition->lu->size;
+    const double* a = matrix_data(decomposition->lu);
+    lu_forward_substitute(a, n, n, b, ldb, ncols, block_size); // L has a unit diagonal
+    lu_back_substitute(a, n, n, b, ldb, ncols, block_size);
+}
+
+/**
+ * @brief Solves LU X = P I for X, writing X (the inverse of the factored matrix) to x.
+ * 
+ * @param decomposition LUDecomposition*  Non-singular factorization
+ * @param x double*  n x n output, row-major
+ * @param block_size int
+ */
+void lu_inverse_into(LUDecomposition* decomposition, double* x, int block_size = LU_BLOCK_SIZE)
+{
+    PROFILE_SCOPE("real_valued.lu_inverse");
+    int n = decomposition->lu->size;
+    fill(x, x + (size_t)n * n, 0.0);
+    vector<int> permutation(n); // row i of P I is e_permutation[i]
+    for (int i = 0; i < n; ++i) permutation[i] = i;
+    for (int k = 0; k < n; ++k) swap(permutation[k], permutation[decomposition->pivots[k]]);
+    for (int i = 0; i < n; ++i) x[(size_t)i * n + permutation[i]] = 1;
+
+    // Columns of the inverse are independent solves; each task takes a stripe of them.
+    parallel_for(0, n, parallel_grain(n, 64), [&](int col_begin, int col_end)
+    {
+        lu_substitute(decomposition, x + col_begin, n, col_end - col_begin, block_size);
+    });
+}
+
+/**
+ * @brief Returns the inverse of the factored matrix as a new matrix.
+ * 
+ * @param decomposition LUDecomposition*  Non-singular factorization
+ * @param block_size int
+ * @return Matrix* 
+ */
+Matrix* lu_inverse(LUDecomposition* decomposition, int block_size = LU_BLOCK_SIZE)
+{
+    int n = decomposition->lu->size;
+    Matrix* inverse = new Matrix(n, vector<double>((size_t)n * n));
+    lu_inverse_into(decomposition, matrix_data(inverse), block_size);
+    return inverse;
+}
+
+/**
+ * @brief gemm_subtract() with the rows of C split across the pool.
+ * 
+ */
+void parallel_gemm_subtract(int m, int n, int k, const double* a, int lda, const double* b, int ldb, double* c, int ldc)
+{
+    parallel_for(0, m, parallel_grain(m, GEMM_MC), [&](int row_begin, int row_end)
+    {
+        gemm_subtract(row_end - row_begin, n, k, a + (size_t)row_begin * lda, lda, b, ldb, c + (size_t)row_begin * ldc, ldc);
+    });
+}
+
+// Side of the square tiles the transposes work through. A pair of 32 x 32 tiles of
+// doubles is 16 KB, so both the rows read and the columns written stay in L1.
+const int TRANSPOSE_TILE = 32;
+
+#ifdef GEMM_KERNELS_X86
+// Transposes the 4 x 4 block held in r0..r3 (one row each) within the registers:
+// pairs of rows are interleaved, then the 128-bit halves exchanged.
+__attribute__((target("avx"), always_inline))
+inline void transpose_4x4_registers(__m256d& r0, __m256d& r1, __m256d& r2, __m256d& r3)
+{
+    __m256d t0 = _mm256_unpacklo_pd(r0, r1); // a00 a10 a02 a12
+    __m256d t1 = _mm256_unpackhi_pd(r0, r1); // a01 a11 a03 a13
+    __m256d t2 = _mm256_unpacklo_pd(r2, r3); // a20 a30 a22 a32
+    __m256d t3 = _mm256_unpackhi_pd(r2, r3); // a21 a31 a23 a33
+    r0 = _mm256_permute2f128_pd(t0, t2, 0x20);
+    r1 = _mm256_permute2f128_pd(t1, t3, 0x20);
+    r2 = _mm256_permute2f128_pd(t0, t2, 0x31);
+    r3 = _mm256_permute2f128_pd(t1, t3, 0x31);
+}
+
+/**
+ * @brief Writes the transpose of the 4 x 4 block at a (rows lda apart) to b (rows ldb
+ * apart). a and b must not overlap.
+ * 
+ */
+__attribute__((target("avx")))
+void transpose_4x4_avx(const double* a, size_t lda, double* b, size_t ldb)
+{
+    __m256d r0 = _mm256_loadu_pd(a);
+    __m256d r1 = _mm256_loadu_pd(a + lda);
+    __m256d r2 = _mm256_loadu_pd(a + 2 * lda);
+    __m256d r3 = _mm256_loadu_pd(a + 3 * lda);
+    transpose_4x4_registers(r0, r1, r2, r3);
+    _mm256_storeu_pd(b, r0);
+    _mm256_storeu_pd(b + ldb, r1);
+    _mm256_storeu_pd(b + 2 * ldb, r2);
+    _mm256_storeu_pd(b + 3 * ldb, r3);
+}
+
+/**
+ * @brief Swaps the 4 x 4 block at p with the transpose of the one at q (rows n apart):
+ * blocks (i, j) and (j, i) of an in-place transpose. p may equal q, for a block on the
+ * diagonal.
+ * 
+ */
+__attribute__((target("avx")))
+void transpose_swap_4x4_avx(double* p, double* q, size_t n)
+{
+    __m256d p0 = _mm256_loadu_pd(p);
+    __m256d p1 = _mm256_loadu_pd(p + n);
+    __m256d p2 = _mm256_loadu_pd(p + 2 * n);
+    __m256d p3 = _mm256_loadu_pd(p + 3 * n);
+    __m256d q0 = _mm256_loadu_pd(q);
+    __m256d q1 = _mm256_loadu_pd(q + n);
+    __m256d q2 = _mm256_loadu_pd(q + 2 * n);
+    __m256d q3 = _mm256_loadu_pd(q + 3 * n);
+    transpose_4x4_registers(p0, p1, p2, p3);
+    transpose_4x4_registers(q0, q1, q2, q3);
+    _mm256_storeu_pd(q, p0);
+    _mm256_storeu_pd(q + n, p1);
+    _mm256_storeu_pd(q + 2 * n, p2);
+    _mm256_storeu_pd(q + 3 * n, p3);
+    _mm256_storeu_pd(p, q0);
+    _mm256_storeu_pd(p + n, q1);
+    _mm256_storeu_pd(p + 2 * n, q2);
+    _mm256_storeu_pd(p + 3 * n, q3);
+}
+#endif
+
+/**
+ * @brief Where the 4 x 4 AVX blocks of a transpose of the n x n matrix at p should start:
+ * the number of columns (0 to 3) after which a row of p is 32-byte aligned. When n is a
+ * multiple of 4 every row is aligned the same way, so shifting the grid of blocks by
+ * this much keeps every block row aligned, whatever alignment the allocator gave p. Rows
+ * straddling two cache lines cost more than the shuffles save, so without such a shift
+ * (n not a multiple of 4, or no AVX) this is -1 and the scalar loops are used.
+ * 
+ */
+int transpose_block_offset(const double* p, int n)
+{
+#ifdef GEMM_KERNELS_X86
+    uintptr_t address = (uintptr_t)p;
+    if (n % 4 != 0 || address % sizeof(double) != 0 || !__builtin_cpu_supports("avx")) return -1;
+    return (int)((32 - address % 32) % 32 / sizeof(double));
+#else
+    return -1;
+#endif
+}
+
+/**
+ * @brief First index of tile t of a transpose whose blocks start at `offset` (mod 4).
+ * The tiles are shifted by the same amount, so no block straddles two tiles; the first
+ * tile takes the extra leading indices.
+ * 
+ */
+int transpose_tile_start(int t, int offset, int n)
+{
+    return t == 0 ? 0 : min(n, t * TRANSPOSE_TILE + offset);
+}
+
+/**
+ * @brief Transposes the n x n matrix a in place, without a second buffer. Tiles (i, j)
+ * and (j, i) of about TRANSPOSE_TILE x TRANSPOSE_TILE are swapped together, 4 x 4
+ * aligned blocks at a time with AVX where transpose_block_offset() allows; rows of tiles
+ * are spread over the thread pool.
+ * 
+ * @param a double*
+ * @param n int
+ */
+void transpose_in_place(double* a, int n)
+{
+    PROFILE_SCOPE("real_valued.transpose");
+    if (n <= 0) return;
+    int offset = transpose_block_offset(a, n);
+    bool blocks = offset >= 0; // otherwise every entry is swapped singly
+    if (!blocks) offset = 0;
+    int tiles = max(1, (n - offset + TRANSPOSE_TILE - 1) / TRANSPOSE_TILE);
+    parallel_for(0, tiles, 1, [&](int first, int last)
+    {
+        for (int ti = first; ti < last; ++ti)
+        {
+            int i0 = transpose_tile_start(ti, offset, n);
+            int i1 = transpose_tile_start(ti + 1, offset, n);
+            int i_first = ti == 0 ? min(i1, offset) : i0; // the whole blocks are [i_first, i_blocks)
+            int i_blocks = blocks ? i_first + (i1 - i_first) / 4 * 4 : i_first;
+            for (int tj = ti; tj < tiles; ++tj) // the tile on the diagonal, then those right of it
+            {
+                int j0 = transpose_tile_start(tj, offset, n);
+                int j1 = transpose_tile_start(tj + 1, offset, n);
+                int j_first = tj == 0 ? min(j1, offset) : j0;
+                int j_blocks = blocks ? j_first + (j1 - j_first) / 4 * 4 : j_first;
+                bool diagonal = tj == ti;
+#ifdef GEMM_KERNELS_X86
+                for (int i = i_first; i < i_blocks; i += 4)
+                {
+                    for (int j = diagonal ? i : j_first; j < j_blocks; j += 4) transpose_swap_4x4_avx(a + (size_t)i * n + j, a + (size_t)j * n + i, n);
+                }
+#endif
+                for (int i = i0; i < i1; ++i) // the entries outside whole blocks
+                {
+                    bool block_row = i >= i_first && i < i_blocks;
+                    for (int j = diagonal ? i + 1 : j0; j < j1; ++j)
+                    {
+                        if (!block_row || j < j_first || j >= j_blocks) swap(a[(size_t)i * n + j], a[(size_t)j * n + i]);
+                    }
+                }
+            }
+        }
+    });
+}
+
+/**
+ * @brief Transposes matrix m in place.
+ * 
+ * @param m Matrix*
+ */
+void transpose_matrix(Matrix* m)
+{
+    transpose_in_place(matrix_data(m), m->size);
+}
+
+/**
+ * @brief Writes the transpose of the n x n matrix a to out (a different buffer), a
+ * tile at a time so both sides stay in cache, and 4 x 4 aligned blocks at a time within
+ * a tile where transpose_block_offset() allows for both.
+ * 
+ */
+void transpose_into(const double* a, int n, double* out)
+{
+    PROFILE_SCOPE("real_valued.transpose");
+    if (n <= 0) return;
+    // Block (i, j) is read from row i of a at column j and written to row j of out at
+    // column i, so the rows of blocks follow out's alignment and the columns a's.
+    int row_offset = transpose_block_offset(out, n);
+    int col_offset = transpose_block_offset(a, n);
+    bool blocks = row_offset >= 0 && col_offset >= 0;
+    if (!blocks) row_offset = col_offset = 0;
+    int row_tiles = max(1, (n - row_offset + TRANSPOSE_TILE - 1) / TRANSPOSE_TILE);
+    int col_tiles = max(1, (n - col_offset + TRANSPOSE_TILE - 1) / TRANSPOSE_TILE);
+    parallel_for(0, row_tiles, 1, [&](int first, int last)
+    {
+        for (int ti = first; ti < last; ++ti)
+        {
+            int i0 = transpose_tile_start(ti, row_offset, n);
+            int i1 = transpose_tile_start(ti + 1, row_offset, n);
+            int i_first = ti == 0 ? min(i1, row_offset) : i0;
+            int i_blocks = blocks ? i_first + (i1 - i_first) / 4 * 4 : i_first;
+            for (int tj = 0; tj < col_tiles; ++tj)
+            {
+                int j0 = transpose_tile_start(tj, col_offset, n);
+                int j1 = transpose_tile_start(tj + 1, col_offset, n);
+                int j_first = tj == 0 ? min(j1, col_offset) : j0;
+                int j_blocks = blocks ? j_first + (j1 - j_first) / 4 * 4 : j_first;
+#ifdef GEMM_KERNELS_X86
+                for (int i = i_first; i < i_blocks; i += 4)
+                {
+                    for (int j = j_first; j < j_blocks; j += 4) transpose_4x4_avx(a + (size_t)i * n + j, n, out + (size_t)j * n + i, n);
+                }
+#endif
+                for (int i = i0; i < i1; ++i)
+                {
+                    bool block_row = i >= i_first && i < i_blocks;
+                    for (int j = j0; j < j1; ++j)
+                    {
+                        if (!block_row || j < j_first || j >= j_blocks) out[(size_t)j * n + i] = a[(size_t)i * n + j];
+                    }
+                }
+            }
+        }
+    });
+}
+
+// How matrix_inverse() should invert a matrix. MATRIX_STRUCTURE_AUTO looks at the
+// matrix to choose; the others are hints from a caller that knows its matrices.
+const int MATRIX_STRUCTURE_AUTO = 0;
+const int MATRIX_STRUCTURE_GENERAL = 1; // dense LU with partial pivoting
+const int MATRIX_STRUCTURE_SPD = 2; // symmetric positive definite: Cholesky
+const int MATRIX_STRUCTURE_BANDED = 3; // LU in band storage
+const int MATRIX_STRUCTURE_TRIANGULAR = 4; // lower or upper triangular
+const int MATRIX_STRUCTURE_SPARSE = 5; // sparse LU on compressed rows
+
+// Below this size the dense LU is always used; structure would save next to nothing.
+const int STRUCTURED_MIN_SIZE = 32;
+
+// Row block height when only a triangle of a product is needed; blocks are this fine
+// whatever the thread count, so little work is wasted above the diagonal.
+const int TRIANGLE_ROWS = 48;
+
+// Matrices with at most this fraction of nonzero entries are treated as sparse.
+const double SPARSE_DENSITY = 0.05;
+
+// The sparse LU gives up, for the dense LU, once its factors have more than
+// n^2 / SPARSE_FILL_RATIO nonzeros: past that its scattered updates are slower than
+// the dense kernels.
+const int SPARSE_FILL_RATIO = 16;
+
+/**
+ * @brief What one pass over a matrix reveals about its structure.
+ * 
+ */
+class MatrixStructure
+{
+    public:
+    int lower_bandwidth; // largest i - j with a nonzero entry (i, j); 0 for upper triangular
+    int upper_bandwidth; // largest j - i with a nonzero entry (i, j); 0 for lower triangular
+    size_t nonzeros;
+    double scale; // largest magnitude of an entry
+};
+
+/**
+ * @brief Measures the bandwidths, number of nonzeros and scale of the n x n matrix a.
+ * 
+ * @param a const double*
+ * @param n int
+ * @return MatrixStructure 
+ */
+MatrixStructure matrix_structure(const double* a, int n)
+{
+    PROFILE_SCOPE("real_valued.matrix_structure");
+    vector<int> lower(n, 0);
+    vector<int> upper(n, 0);
+    vector<size_t> nonzeros(n, 0);
+    vector<double> scale(n, 0.0);
+    parallel_for(0, n, parallel_grain(n, 256), [&](int row_begin, int row_end)
+    {
+        for (int i = row_begin; i < row_end; ++i)
+        {
+            const double* row = a + (size_t)i * n;
+            int first = n;
+            int last = -1;
+            for (int j = 0; j < n; ++j)
+            {
+                if (row[j] == 0) continue;
+                if (first == n) first = j;
+                last = j;
+                nonzeros[i]++;
+                scale[i] = max(scale[i], fabs(row[j]));
+            }
+            if (last < 0) continue;
+            lower[i] = max(0, i - first);
+            upper[i] = max(0, last - i);
+        }
+    });
+    MatrixStructure structure;
+    structure.lower_bandwidth = *max_element(lower.begin(), lower.end());
+    structure.upper_bandwidth = *max_element(upper.begin(), upper.end());
+    structure.nonzeros = 0;
+    for (size_t count : nonzeros) structure.nonzeros += count;
+    structure.scale = *max_element(scale.begin(), scale.end());
+    return structure;
+}
+
+/**
+ * @brief Whether the n x n matrix a is exactly symmetric with a positive diagonal, the
+ * cheap necessary conditions for positive definiteness. Stops at the first mismatch.
+ * 
+ */
+bool matrix_may_be_spd(const double* a, int n)
+{
+    for (int i = 0; i < n; ++i)
+    {
+        if (!(a[(size_t)i * n + i] > 0)) return false;
+        for (int j = 0; j < i; ++j)
+        {
+            if (a[(size_t)i * n + j] != a[(size_t)j * n + i]) return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Cholesky factorization A = L L^T of the n x n symmetric matrix a, in place:
+ * on return the lower triangle holds L and the strict upper triangle is not meaningful.
+ * Right-looking blocked, like lu_factor_block(): factor a diagonal block, solve for the
+ * block column below it, then update the lower half of the trailing matrix.
+ * 
+ * @param a double*  Only the lower triangle is read
+ * @param n int
+ * @param tolerance double  Pivots must exceed this
+ * @param block_size int
+ * @return bool  false if a is not (numerically) positive definite
+ */
+bool cholesky_factor(double* a, int n, double tolerance, int block_size = LU_BLOCK_SIZE)
+{
+    vector<double> transposed; // L21^T, for the trailing update
+    for (int k0 = 0; k0 < n; k0 += block_size)
+    {
+        int kb = min(block_size, n - k0);
+        for (int j = k0; j < k0 + kb; ++j) // diagonal block, unblocked
+        {
+            double* row_j = a + (size_t)j * n;
+            double diagonal = row_j[j];
+            for (int p = k0; p < j; ++p) diagonal -= row_j[p] * row_j[p];
+            if (!(diagonal > tolerance)) return false;
+            diagonal = sqrt(diagonal);
+            row_j[j] = diagonal;
+            for (int i = j + 1; i < k0 + kb; ++i)
+            {
+                double* row_i = a + (size_t)i * n;
+                double sum = row_i[j];
+                for (int p = k0; p < j; ++p) sum -= row_i[p] * row_j[p];
+                row_i[j] = sum / diagonal;
+            }
+        }
+
+        int rest = k0 + kb;
+        if (rest == n) break;
+        int m = n - rest;
+        // L21 = A21 L11^-T, row by row
+        parallel_for(rest, n, parallel_grain(m, 256), [&](int row_begin, int row_end)
+        {
+            for (int i = row_begin; i < row_end; ++i)
+            {
+                double* row_i = a + (size_t)i * n;
+                for (int j = k0; j < rest; ++j)
+                {
+                    const double* row_j = a + (size_t)j * n;
+                    double sum = row_i[j];
+                    for (int p = k0; p < j; ++p) sum -= row_i[p] * row_j[p];
+                    row_i[j] = sum / row_j[j];
+                }
+            }
+        });
+        // A22 -= L21 L21^T, lower half only: row i needs columns rest..i.
+        transposed.resize((size_t)kb * m);
+        for (int i = 0; i < m; ++i)
+        {
+            for (int p = 0; p < kb; ++p) transposed[(size_t)p * m + i] = a[(size_t)(rest + i) * n + k0 + p];
+        }
+        parallel_for(0, (m + TRIANGLE_ROWS - 1) / TRIANGLE_ROWS, 1, [&](int first, int last)
+        {
+            for (int row_begin = rest + first * TRIANGLE_ROWS; row_begin < min(n, rest + last * TRIANGLE_ROWS); row_begin += TRIANGLE_ROWS)
+            {
+                int row_end = min(n, row_begin + TRIANGLE_ROWS);
+                gemm_subtract(row_end - row_begin, row_end - rest, kb, a + (size_t)row_begin * n + k0, n, transposed.data(), m,
+                              a + (size_t)row_begin * n + rest, n);
+            }
+        });
+    }
+    return true;
+}
+
+/**
+ * @brief Inverts the lower triangular n x n block l in place (leading dimension ld).
+ * Entries above the diagonal must be zero, and stay zero. Recursive: with
+ * L = [[L11, 0], [L21, L22]], L^-1 = [[L11^-1, 0], [-L22^-1 L21 L11^-1, L22^-1]],
+ * so most of the work is two large matrix multiplies.
+ * 
+ */
+void lower_triangular_inverse(double* l, int n, int ld)
+{
+    if (n <= 64)
+    {
+        // Columns from the right: column j of the inverse is -W22 l[j+1:, j] / l[j][j],
+        // where W22 is the part already inverted.
+        for (int j = n - 1; j >= 0; --j)
+        {
+            double reciprocal = 1 / l[(size_t)j * ld + j];
+            l[(size_t)j * ld + j] = reciprocal;
+            for (int i = n - 1; i > j; --i)
+            {
+                double sum = 0;
+                for (int p = j + 1; p <= i; ++p) sum += l[(size_t)i * ld + p] * l[(size_t)p * ld + j];
+                l[(size_t)i * ld + j] = -sum * reciprocal;
+            }
+        }
+        return;
+    }
+    int n1 = n / 2;
+    int n2 = n - n1;
+    double* l21 = l + (size_t)n1 * ld;
+    double* l22 = l21 + n1;
+    lower_triangular_inverse(l, n1, ld);
+    lower_triangular_inverse(l22, n2, ld);
+    vector<double> product((size_t)n2 * n1, 0.0);
+    parallel_gemm_subtract(n2, n1, n1, l21, ld, l, ld, product.data(), n1); // -L21 L11^-1
+    for (double& entry : product) entry = -entry;
+    for (int i = 0; i < n2; ++i) fill(l21 + (size_t)i * ld, l21 + (size_t)i * ld + n1, 0.0);
+    parallel_gemm_subtract(n2, n1, n2, l22, ld, product.data(), n1, l21, ld);
+}
+
+/**
+ * @brief Writes the inverse of the triangular n x n matrix a to x (which may be a).
+ * Upper triangular matrices are transposed, inverted as lower, and transposed back.
+ * 
+ * @return int  0 on success, 1 if a diagonal entry is negligible (x is not written)
+ */
+int triangular_inverse_into(const double* a, int n, double* x, bool lower, double tolerance)
+{
+    for (int i = 0; i < n; ++i)
+    {
+        if (fabs(a[(size_t)i * n + i]) <= tolerance) return 1;
+    }
+    vector<double> work((size_t)n * n);
+    if (lower) copy(a, a + (size_t)n * n, work.begin());
+    else transpose_into(a, n, work.data());
+    for (int i = 0; i < n; ++i) fill(work.begin() + (size_t)i * n + i + 1, work.begin() + (size_t)(i + 1) * n, 0.0);
+    lower_triangular_inverse(work.data(), n, n);
+    if (lower) copy(work.begin(), work.end(), x);
+    else transpose_into(work.data(), n, x);
+    return 0;
+}
+
+/**
+ * @brief Writes the inverse of the symmetric positive definite n x n matrix a to x (which
+ * may be a) as A^-1 = L^-T L^-1, from the Cholesky factor L. That is about a third of
+ * the work of the LU inverse: factor, invert the triangle, then form the product for
+ * the lower half only and mirror it.
+ * 
+ * @return bool  false if a is not (numerically) positive definite (x is not written)
+ */
+bool spd_inverse_into(const double* a, int n, double* x, double tolerance)
+{
+    vector<double> w(a, a + (size_t)n * n);
+    if (!cholesky_factor(w.data(), n, tolerance)) return false;
+    for (int i = 0; i < n; ++i) fill(w.begin() + (size_t)i * n + i + 1, w.begin() + (size_t)(i + 1) * n, 0.0);
+    lower_triangular_inverse(w.data(), n, n);
+    vector<double> negative_wt((size_t)n * n); // -(L^-1)^T, upper triangular
+    transpose_into(w.data(), n, negative_wt.data());
+    for (double& entry : negative_wt) entry = -entry;
+
+    // Rows i of the lower half: X[i, 0..i] = sum over k >= i of W[k, i] W[k, 0..i].
+    fill(x, x + (size_t)n * n, 0.0);
+    parallel_for(0, (n + TRIANGLE_ROWS - 1) / TRIANGLE_ROWS, 1, [&](int first, int last)
+    {
+        for (int row_begin = first * TRIANGLE_ROWS; row_begin < min(n, last * TRIANGLE_ROWS); row_begin += TRIANGLE_ROWS)
+        {
+            int row_end = min(n, row_begin + TRIANGLE_ROWS);
+            gemm_subtract(row_end - row_begin, row_end, n - row_begin, negative_wt.data() + (size_t)row_begin * n + row_begin, n,
+                          w.data() + (size_t)row_begin * n, n, x + (size_t)row_begin * n, n);
+        }
+    });
+    for (int i = 0; i < n; ++i)
+    {
+        for (int j = i + 1; j < n; ++j) x[(size_t)i * n + j] = x[(size_t)j * n + i];
+    }
+    return true;
+}
+
+/**
+ * @brief Writes the inverse of the n x n banded matrix a (nonzeros only within kl
+ * below and ku above the diagonal) to x (which may be a). The LU with partial pivoting
+ * is done in band storage, O(n kl (kl + ku)) time and O(n (2 kl + ku)) memory; the
+ * inverse itself is dense, so solving for it is O(n^2 (kl + ku)), in stripes of columns.
+ * 
+ * @return int  0 on success, 1 if the matrix is singular (x is not written)
+ */
+int banded_inverse_into(const double* a, int n, int kl, int ku, double* x, double tolerance)
+{
+    // Row i holds columns i - kl to i + kl + ku; row swaps can fill in up to kl extra
+    // columns of U.
+    int width = 2 * kl + ku + 1;
+    vector<double> band((size_t)n * width, 0.0);
+    auto at = [&](int i, int j) -> double& { return band[(size_t)i * width + j - i + kl]; };
+    for (int i = 0; i < n; ++i)
+    {
+        for (int j = max(0, i - kl); j <= min(n - 1, i + ku); ++j) at(i, j) = a[(size_t)i * n + j];
+    }
+
+    vector<int> pivots(n);
+    for (int k = 0; k < n; ++k)
+    {
+        int last_row = min(n - 1, k + kl);
+        int last_col = min(n - 1, k + kl + ku);
+        int pivot_row = k;
+        for (int i = k + 1; i <= last_row; ++i)
+        {
+            if (fabs(at(i, k)) > fabs(at(pivot_row, k))) pivot_row = i;
+        }
+        pivots[k] = pivot_row;
+        if (pivot_row != k) swap_ranges(&at(k, k), &at(k, k) + (last_col - k + 1), &at(pivot_row, k));
+        double pivot = at(k, k);
+        if (fabs(pivot) <= tolerance) return 1;
+        for (int i = k + 1; i <= last_row; ++i)
+        {
+            double multiplier = at(i, k) / pivot;
+            at(i, k) = multiplier;
+            if (multiplier != 0) axpy_subtract(last_col - k, multiplier, &at(k, k + 1), &at(i, k + 1));
+        }
+    }
+
+    parallel_for(0, n, parallel_grain(n, 64), [&](int col_begin, int col_end)
+    {
+        int w = col_end - col_begin;
+        vector<double> b((size_t)n * w, 0.0);
+        for (int c = col_begin; c < col_end; ++c) b[(size_t)c * w + c - col_begin] = 1;
+        // Row swaps and eliminations in the order of the factorization; steps before
+        // col_begin - kl only touch rows that are still zero.
+        for (int k = max(0, col_begin - kl); k < n; ++k)
+        {
+            if (pivots[k] != k) swap_ranges(b.begin() + (size_t)k * w, b.begin() + (size_t)(k + 1) * w, b.begin() + (size_t)pivots[k] * w);
+            for (int i = k + 1; i <= min(n - 1, k + kl); ++i)
+            {
+                double multiplier = at(i, k);
+                if (multiplier != 0) axpy_subtract(w, multiplier, b.data() + (size_t)k * w, b.data() + (size_t)i * w);
+            }
+        }
+        for (int i = n - 1; i >= 0; --i)
+        {
+            double* row = b.data() + (size_t)i * w;
+            for (int j = i + 1; j <= min(n - 1, i + kl + ku); ++j)
+            {
+                double u = at(i, j);
+                if (u != 0) axpy_subtract(w, u, b.data() + (size_t)j * w, row);
+            }
+            double reciprocal = 1 / at(i, i);
+            for (int c = 0; c < w; ++c) row[c] *= reciprocal;
+        }
+        for (int i = 0; i < n; ++i) copy(b.begin() + (size_t)i * w, b.begin() + (size_t)(i + 1) * w, x + (size_t)i * n + col_begin);
+    });
+    return 0;
+}
+
+/**
+ * @brief A sparse matrix in compressed sparse row (CSR) form: the nonzeros of row i are
+ * values[row_start[i]] to values[row_start[i + 1] - 1], in columns columns[...].
+ * 
+ */
+class SparseMatrix
+{
+    public:
+    int size;
+    vector<int> row_start; // size + 1 entries
+    vector<int> columns;
+    vector<double> values;
+};
+
+SparseMatrix sparse_from_dense(const double* a, int n)
+{
+    SparseMatrix sparse;
+    sparse.size = n;
+    sparse.row_start.push_back(0);
+    for (int i = 0; i < n; ++i)
+    {
+        for (int j = 0; j < n; ++j)
+        {
+            double entry = a[(size_t)i * n + j];
+            if (entry == 0) continue;
+            sparse.columns.push_back(j);
+            sparse.values.push_back(entry);
+        }
+        sparse.row_start.push_back((int)sparse.columns.size());
+    }
+    return sparse;
+}
+
+/**
+ * @brief Writes the inverse of the sparse matrix s to the dense n x n x.
+ * 
+ * Left-looking sparse LU with partial pivoting (Gilbert-Peierls): each column is found
+ * with a sparse triangular solve that only visits the entries it can reach, so the
+ * work is proportional to the nonzeros of the factors rather than n^3. The rows of s
+ * are read as the columns of its transpose B = A^T, which is factored instead: then
+ * row j of A^-1 is the solution of B x = e_j, and each solve writes one contiguous row.
+ * The diagonal is kept as pivot when it is within a factor 10 of the largest candidate,
+ * which keeps the fill-in of diagonally dominant matrices low. There is no fill-reducing
+ * reordering.
+ * 
+ * @param s const SparseMatrix*
+ * @param x double*  n x n output, row-major
+ * @param tolerance double  Pivots at or below this magnitude are treated as zero
+ * @param fill_limit size_t  Give up once the factors have more nonzeros than this
+ * @return int  0 on success, 1 if the matrix is singular, -1 if the fill-in limit was
+ * reached (x is not written unless 0 is returned)
+ */
+int sparse_inverse_into(const SparseMatrix* s, double* x, double tolerance, size_t fill_limit)
+{
+    int n = s->size;
+    vector<int> l_start(1, 0); // column k of L: original row indices and multipliers
+    vector<int> l_rows;
+    vector<double> l_values;
+    vector<int> u_start(1, 0); // column k of U above the diagonal: pivot steps and entries
+    vector<int> u_steps;
+    vector<double> u_values;
+    vector<double> u_diagonal(n);
+    vector<int> step_of_row(n, -1);
+    vector<int> pivot_rows(n);
+
+    vector<double> work(n, 0.0);
+    vector<char> marked(n, 0);
+    vector<int> reach; // rows reached from column k, in reverse topological order
+    vector<int> stack;
+    vector<int> next_child(n);
+    for (int k = 0; k < n; ++k)
+    {
+        // Depth-first search from the nonzeros of column k through the columns of L
+        // already computed, so the solve below visits rows in dependency order.
+        reach.clear();
+        for (int e = s->row_start[k]; e < s->row_start[k + 1]; ++e)
+        {
+            int root = s->columns[e];
+            if (marked[root]) continue;
+            marked[root] = 1;
+            stack.push_back(root);
+            next_child[root] = 0;
+            while (!stack.empty())
+            {
+                int node = stack.back();
+                int step = step_of_row[node];
+                bool descended = false;
+                if (step >= 0)
+                {
+                    for (int& c = next_child[node]; l_start[step] + c < l_start[step + 1]; )
+                    {
+                        int child = l_rows[l_start[step] + c++];
+                        if (marked[child]) continue;
+                        marked[child] = 1;
+                        next_child[child] = 0;
+                        stack.push_back(child);
+                        descended = true;
+                        break;
+                    }
+                }
+                if (descended) continue;
+                stack.pop_back();
+                reach.push_back(node);
+            }
+        }
+
+        for (int e = s->row_start[k]; e < s->row_start[k + 1]; ++e) work[s->columns[e]] = s->values[e];
+        for (int r = (int)reach.size() - 1; r >= 0; --r)
+        {
+            int node = reach[r];
+            int step = step_of_row[node];
+            if (step < 0 || work[node] == 0) continue;
+            double value = work[node];
+            for (int e = l_start[step]; e < l_start[step + 1]; ++e) work[l_rows[e]] -= l_values[e] * value;
+        }
+
+        int pivot_row = -1;
+        double largest = 0;
+        for (int node : reach)
+        {
+            if (step_of_row[node] < 0 && fabs(work[node]) > largest)
+            {
+                largest = fabs(work[node]);
+                pivot_row = node;
+            }
+        }
+        if (largest <= tolerance) return 1;
+        if (step_of_row[k] < 0 && marked[k] && fabs(work[k]) >= 0.1 * largest) pivot_row = k;
+        double pivot = work[pivot_row];
+
+        for (int node : reach)
+        {
+            if (step_of_row[node] >= 0 && work[node] != 0)
+            {
+                u_steps.push_back(step_of_row[node]);
+                u_values.push_back(work[node]);
+            }
+        }
+        u_start.push_back((int)u_steps.size());
+        u_diagonal[k] = pivot;
+        step_of_row[pivot_row] = k;
+        pivot_rows[k] = pivot_row;
+        for (int node : reach)
+        {
+            if (step_of_row[node] < 0 && work[node] != 0)
+            {
+                l_rows.push_back(node);
+                l_values.push_back(work[node] / pivot);
+            }
+        }
+        l_start.push_back((int)l_rows.size());
+        for (int node : reach)
+        {
+            work[node] = 0;
+            marked[node] = 0;
+        }
+        if (l_rows.size() + u_steps.size() > fill_limit) return -1;
+    }
+
+    parallel_for(0, n, parallel_grain(n, 16), [&](int row_begin, int row_end)
+    {
+        vector<double> y(n);
+        for (int j = row_begin; j < row_end; ++j)
+        {
+            fill(y.begin(), y.end(), 0.0); // B x = e_j, forward with L over original row indices
+            y[j] = 1;
+            for (int k = 0; k < n; ++k)
+            {
+                double value = y[pivot_rows[k]];
+                if (value == 0) continue;
+                for (int e = l_start[k]; e < l_start[k + 1]; ++e) y[l_rows[e]] -= l_values[e] * value;
+            }
+            double* z = x + (size_t)j * n; // then back with U over pivot steps
+            for (int k = 0; k < n; ++k) z[k] = y[pivot_rows[k]];
+            for (int k = n - 1; k >= 0; --k)
+            {
+                double value = z[k] / u_diagonal[k];
+                z[k] = value;
+                if (value == 0) continue;
+                for (int e = u_start[k]; e < u_start[k + 1]; ++e) z[u_steps[e]] -= u_values[e] * value;
+            }
+        }
+    });
+    return 0;
+}
+
+/**
+ * @brief Writes the inverse of the n x n matrix a to x (which may be the same buffer),
+ * choosing a method from `hint` or, for MATRIX_STRUCTURE_AUTO, from one pass over the
+ * matrix: a narrow band uses the banded LU, few nonzeros the sparse LU, a triangular
+ * matrix is inverted directly, and a symmetric matrix with a positive diagonal tries
+ * Cholesky. Everything else, and any specialized method that does not apply after all
+ * (a hint that was wrong, Cholesky finding the matrix indefinite, too much sparse
+ * fill-in), uses the dense LU.
+ * 
+ * @param a const double*  n x n row-major
+ * @param n int
+ * @param x double*  n x n output; left unchanged if a is singular
+ * @param hint int  One of the MATRIX_STRUCTURE_ values
+ * @return int  0 on success, 1 if a is singular
+ */
+int structured_inverse_into(const double* a, int n, double* x, int hint = MATRIX_STRUCTURE_AUTO)
+{
+    PROFILE_SCOPE("real_valued.structured_inverse");
+    bool detect = hint == MATRIX_STRUCTURE_AUTO;
+    if (detect && n < STRUCTURED_MIN_SIZE) hint = MATRIX_STRUCTURE_GENERAL;
+    if (hint != MATRIX_STRUCTURE_GENERAL)
+    {
+        MatrixStructure structure = matrix_structure(a, n);
+        double tolerance = lu_tolerance(structure.scale, n);
+        int kl = structure.lower_bandwidth;
+        int ku = structure.upper_bandwidth;
+        if (hint == MATRIX_STRUCTURE_BANDED || (detect && 2 * kl + ku + 1 <= n / 16))
+            return banded_inverse_into(a, n, kl, ku, x, tolerance);
+        if (hint == MATRIX_STRUCTURE_SPARSE || (detect && structure.nonzeros <= SPARSE_DENSITY * n * n))
+        {
+            SparseMatrix sparse = sparse_from_dense(a, n);
+            int status = sparse_inverse_into(&sparse, x, tolerance, (size_t)n * n / SPARSE_FILL_RATIO);
+            if (status >= 0) return status;
+        }
+        if ((hint == MATRIX_STRUCTURE_TRIANGULAR || detect) && (kl == 0 || ku == 0))
+            return triangular_inverse_into(a, n, x, ku == 0, tolerance);
+        if (hint == MATRIX_STRUCTURE_SPD || (detect && matrix_may_be_spd(a, n)))
+        {
+            if (spd_inverse_into(a, n, x, tolerance)) return 0;
+        }
+    }
+    LUDecomposition* decomposition = lu_decompose(a, n);
+    int singular = decomposition->singular ? 1 : 0;
+    if (!singular) lu_inverse_into(decomposition, x);
+    delete decomposition;
+    return singular;
+}
+
+/**
+ * @brief Calculates the inverse of matrix m. Returns as new matrix, or nullptr if m
+ * is singular. Banded, sparse, triangular and symmetric positive definite matrices are
+ * recognized and inverted with methods suited to them (see structured_inverse_into()).
+ * 
+ * @param m Matrix*
+ * @param hint int  MATRIX_STRUCTURE_AUTO, or the structure the caller knows m has
+ * @return Matrix* 
+ */
+Matrix* matrix_inverse(Matrix* m, int hint = MATRIX_STRUCTURE_AUTO)
+{
+    int n = m->size;
+    Matrix* inverse = new Matrix(n, vector<double>((size_t)n * n));
+    if (structured_inverse_into(matrix_data(m), n, matrix_data(inverse), hint) != 0)
+    {
+        delete inverse;
+        return nullptr;
+    }
+    return inverse;
+}
+
+// Residual-correction steps of the mixed-precision inverse before it gives up and
+// inverts in double precision.
+const int MIXED_PRECISION_MAX_STEPS = 4;
+
+/**
+ * @brief Largest row sum of absolute values of the n x n matrix a.
+ * 
+ */
+double matrix_norm_infinity(const double* a, int n)
+{
+    double norm = 0;
+    for (int i = 0; i < n; ++i)
+    {
+        double sum = 0;
+        for (int j = 0; j < n; ++j) sum += fabs(a[(size_t)i * n + j]);
+        norm = max(norm, sum);
+    }
+    return norm;
+}
+
+/**
+ * @brief Writes R = I - A X for n x n matrices a and x and returns its largest row sum
+ * of absolute values, the residual |A X - I| in the infinity norm.
+ * 
+ * @param a const double*
+ * @param x const double*
+ * @param n int
+ * @param r double*  n x n output
+ * @return double 
+ */
+double identity_residual_into(const double* a, const double* x, int n, double* r)
+{
+    size_t count = (size_t)n * n;
+    fill(r, r + count, 0.0);
+    for (int i = 0; i < n; ++i) r[(size_t)i * n + i] = 1;
+    parallel_gemm_subtract(n, n, n, a, n, x, n, r, n);
+    return matrix_norm_infinity(r, n);
+}
+
+/**
+ * @brief Writes (LU)^-1 P b to out for the n x n right-hand sides b, using factors
+ * held in single precision. The solve runs in single precision; b and out are double.
+ * 
+ * @param decomposition LUDecomposition*  Pivots of the factorization
+ * @param factors const float*  L and U packed as in LUDecomposition
+ * @param n int
+ * @param b const double*  n x n row-major
+ * @param out double*  n x n row-major, may be b
+ */
+void lu_solve_single(LUDecomposition* decomposition, const float* factors, int n, const double* b, double* out)
+{
+    vector<int> permutation(n); // row i of P b is row permutation[i] of b
+    for (int i = 0; i < n; ++i) permutation[i] = i;
+    for (int k = 0; k < n; ++k) swap(permutation[k], permutation[decomposition->pivots[k]]);
+    vector<float> rhs((size_t)n * n);
+    for (int i = 0; i < n; ++i)
+    {
+        const double* row = b + (size_t)permutation[i] * n;
+        copy(row, row + n, rhs.begin() + (size_t)i * n);
+    }
+    parallel_for(0, n, parallel_grain(n, 64), [&](int col_begin, int col_end)
+    {
+        lu_forward_substitute(factors, n, n, rhs.data() + col_begin, n, col_end - col_begin);
+        lu_back_substitute(factors, n, n, rhs.data() + col_begin, n, col_end - col_begin);
+    });
+    copy(rhs.begin(), rhs.end(), out);
+}
+
+/**
+ * @brief Writes the inverse of the n x n matrix a to x and reports the residual
+ * |A X - I| it reached. It factors in single precision and refines the result to
+ * double accuracy: X starts as the single-precision inverse
+ * M, and each step adds M (I - A X), with the residual I - A X formed in double. The
+ * residual shrinks by a factor of about |I - A M| per step, so this converges when
+ * cond(A) is well below 1 / float epsilon (about 10^7). It stops once
+ * |A X - I| <= eps |A| |X|, about what the double-precision LU reaches; when the
+ * residual stops shrinking, or a is singular in single precision, the inverse is
+ * computed in double precision instead.
+ * 
+ * This is a residual-reporting mode, not a faster one. The factors take half the
+ * memory of the double-precision ones, but each step's residual is a full n x n x n
+ * multiply in double, so the whole inversion is about 3x slower than matrix_inverse().
+ * Use it when the residual is wanted with the inverse.
+ * 
+ * @param a const double*  n x n row-major
+ * @param n int
+ * @param x double*  n x n output, a different buffer from a; left unchanged if a is singular
+ * @param residual double*  If not nullptr, receives |A X - I| (infinity norm)
+ * @return int  0 on success, 1 if a is singular
+ */
+int mixed_precision_inverse_into(const double* a, int n, double* x, double* residual = nullptr)
+{
+    PROFILE_SCOPE("real_valued.mixed_precision_inverse");
+    size_t count = (size_t)n * n;
+    vector<float> factors(a, a + count);
+    double scale = 0;
+    for (size_t i = 0; i < count; ++i) scale = max(scale, fabs(a[i]));
+    LUDecomposition pivots(new Matrix(n)); // pivots only; the factors are in `factors`
+    lu_factor_block(&pivots, factors.data(), n, n, n, 0, scale * n * numeric_limits<float>::epsilon(), LU_BLOCK_SIZE);
+
+    vector<double> refined(count);
+    vector<double> r(count);
+    double norm = numeric_limits<double>::infinity();
+    bool converged = false;
+    if (!pivots.singular)
+    {
+        fill(r.begin(), r.end(), 0.0);
+        for (int i = 0; i < n; ++i) r[(size_t)i * n + i] = 1;
+        lu_solve_single(&pivots, factors.data(), n, r.data(), refined.data());
+        double norm_a = matrix_norm_infinity(a, n);
+        for (int step = 0; step <= MIXED_PRECISION_MAX_STEPS; ++step)
+        {
+            double previous = norm;
+            norm = identity_residual_into(a, refined.data(), n, r.data());
+            double target = numeric_limits<double>::epsilon() * norm_a * matrix_norm_infinity(refined.data(), n);
+            if (norm <= target) { converged = true; break; }
+            if (!(norm <= previous / 2) || step == MIXED_PRECISION_MAX_STEPS) break; // not converging (or NaN)
+            lu_solve_single(&pivots, factors.data(), n, r.data(), r.data());
+            for (size_t i = 0; i < count; ++i) refined[i] += r[i];
+        }
+    }
+    if (!converged)
+    {
+        if (structured_inverse_into(a, n, refined.data(), MATRIX_STRUCTURE_GENERAL) != 0) return 1;
+        if (residual) norm = identity_residual_into(a, refined.data(), n, r.data());
+    }
+    copy(refined.begin(), refined.end(), x);
+    if (residual) *residual = norm;
+    return 0;
+}
+
+/**
+ * @brief Calculates the inverse of matrix m with mixed_precision_inverse_into(). Returns
+ * it as a new matrix, or nullptr if m is singular.
+ * 
+ * @param m Matrix*
+ * @param residual double*  If not nullptr, receives |m X - I| (infinity norm)
+ * @return Matrix* 
+ */
+Matrix* matrix_inverse_mixed(Matrix* m, double* residual = nullptr)
+{
+    int n = m->size;
+    Matrix* inverse = new Matrix(n, vector<double>((size_t)n * n));
+    if (mixed_precision_inverse_into(matrix_data(m), n, matrix_data(inverse), residual) != 0)
+    {
+        delete inverse;
+        return nullptr;
+    }
+    return inverse;
+}
+
+/**
+ * @brief A matrix factored once, for any number of solves against it
+ * (factorization_solve()), its determinant and, on demand, its inverse. Cholesky factors
+ * A = L L^T are kept in the packed LU form, as A = (L D^-1)(D L^T) with D the diagonal
+ * of L and no row swaps, so one set of substitution routines serves both.
+ * 
+ */
+class Factorization
+{
+    public:
+    int structure; // MATRIX_STRUCTURE_SPD (Cholesky) or MATRIX_STRUCTURE_GENERAL (LU)
+    LUDecomposition* decomposition;
+
+    Factorization(int _structure, LUDecomposition* _decomposition)
+    {
+        structure = _structure;
+        decomposition = _decomposition;
+    }
+
+    ~Factorization() { delete decomposition; }
+};
+
+/**
+ * @brief Factors the n x n matrix a for later solves. Symmetric matrices with a positive
+ * diagonal (or any matrix, given MATRIX_STRUCTURE_SPD) try Cholesky, which takes half
+ * the work of the LU; everything else, and a Cholesky that fails, uses the LU with
+ * partial pivoting. Other hints are treated as MATRIX_STRUCTURE_GENERAL. A singular
+ * matrix still gives a factorization, flagged as singular.
+ * 
+ * @param a const double*  n x n row-major (copied, not modified)
+ * @param n int
+ * @param hint int  MATRIX_STRUCTURE_AUTO, MATRIX_STRUCTURE_SPD or MATRIX_STRUCTURE_GENERAL
+ * @return Factorization* 
+ */
+Factorization* factorize(const double* a, int n, int hint = MATRIX_STRUCTURE_AUTO)
+{
+    if (hint == MATRIX_STRUCTURE_SPD || (hint == MATRIX_STRUCTURE_AUTO && matrix_may_be_spd(a, n)))
+    {
+        size_t count = (size_t)n * n;
+        vector<double> entries(a, a + count);
+        double scale = 0;
+        for (size_t i = 0; i < count; ++i) scale = max(scale, fabs(entries[i]));
+        if (cholesky_factor(entries.data(), n, lu_tolerance(scale, n)))
+        {
+            vector<double> diagonal(n);
+            for (int i = 0; i < n; ++i) diagonal[i] = entries[(size_t)i * n + i];
+            for (int i = 0; i < n; ++i)
+            {
+                for (int j = 0; j < i; ++j)
+                {
+                    double l = entries[(size_t)i * n + j];
+                    entries[(size_t)i * n + j] = l / diagonal[j];
+                    entries[(size_t)j * n + i] = l * diagonal[j];
+                }
+                entries[(size_t)i * n + i] = diagonal[i] * diagonal[i];
+            }
+            LUDecomposition* decomposition = new LUDecomposition(new Matrix(n, move(entries)));
+            for (int k = 0; k < n; ++k) decomposition->pivots[k] = k;
+            return new Factorization(MATRIX_STRUCTURE_SPD, decomposition);
+        }
+    }
+    return new Factorization(MATRIX_STRUCTURE_GENERAL, lu_decompose(a, n));
+}
+
+/**
+ * @brief Overwrites the n x nrhs block b with A^-1 b, where A is the factored matrix:
+ * O(n^2) per right-hand side. One right-hand side (nrhs = 1) is solved with plain dot
+ * products; more are solved as blocks, spread over the pool.
+ * 
+ * @param factorization Factorization*
+ * @param b double*  n x nrhs row-major (for one right-hand side, just the vector)
+ * @param nrhs int
+ * @return int  0 on success, 1 if the matrix is singular (b is left unchanged)
+ */
+int factorization_solve(Factorization* factorization, double* b, int nrhs)
+{
+    PROFILE_SCOPE("real_valued.factorization_solve");
+    LUDecomposition* decomposition = factorization->decomposition;
+    if (decomposition->singular) return 1;
+    int n = decomposition->lu->size;
+    for (int k = 0; k < n; ++k)
+    {
+        int pivot_row = decomposition->pivots[k];
+        if (pivot_row != k) swap_ranges(b + (size_t)k * nrhs, b + (size_t)(k + 1) * nrhs, b + (size_t)pivot_row * nrhs);
+    }
+    if (nrhs == 1)
+    {
+        const double* a = matrix_data(decomposition->lu);
+        for (int i = 0; i < n; ++i) // L has a unit diagonal
+        {
+            const double* row = a + (size_t)i * n;
+            double sum = b[i];
+            for (int k = 0; k < i; ++k) sum -= row[k] * b[k];
+            b[i] = sum;
+        }
+        for (int i = n - 1; i >= 0; --i)
+        {
+            const double* row = a + (size_t)i * n;
+            double sum = b[i];
+            for (int k = i + 1; k < n; ++k) sum -= row[k] * b[k];
+            b[i] = sum / row[i];
+        }
+        return 0;
+    }
+    parallel_for(0, nrhs, parallel_grain(nrhs, 64), [&](int col_begin, int col_end)
+    {
+        lu_substitute(decomposition, b + col_begin, nrhs, col_end - col_begin);
+    });
+    return 0;
+}
+
+/**
+ * @brief Determinant of the factored matrix (0 or tiny when it is singular).
+ * 
+ * @param factorization Factorization*
+ * @return double 
+ */
+double factorization_determinant(Factorization* factorization) { return lu_determinant(factorization->decomposition); }
+
+/**
+ * @brief Writes the inverse of the factored matrix to x, an O(n^3) computation that
+ * reuses the factors.
+ * 
+ * @param factorization Factorization*
+ * @param x double*  n x n output
+ * @return int  0 on success, 1 if the matrix is singular (x is left unchanged)
+ */
+int factorization_inverse_into(Factorization* factorization, double* x)
+{
+    if (factorization->decomposition->singular) return 1;
+    lu_inverse_into(factorization->decomposition, x);
+    return 0;
+}
+
+// Results of the inverse update functions below.
+const int INVERSE_UPDATE_APPLIED = 0; // the inverse was updated in O(n^2 k)
+const int INVERSE_UPDATE_SINGULAR = 1; // the updated matrix is singular, or too close to it for an accurate inverse; nothing was changed
+const int INVERSE_UPDATE_RECOMPUTED = 2; // the update was not accurate enough, so the inverse was recomputed
+
+// An updated inverse X of A is kept when |A X z - z| stays below this for a fixed probe
+// vector z of +-1 entries, and when the update formula itself is well conditioned.
+// Otherwise the inverse is recomputed from scratch.
+const double INVERSE_UPDATE_TOLERANCE = 1e-8;
+
+/**
+ * @brief Replaces the entries of m with `entries` (size x size, swapped in, not copied).
+ * A matrix mapped from a file is moved into memory.
+ * 
+ */
+void matrix_assign(Matrix* m, int size, vector<double>& entries)
+{
+    m->size = size;
+    m->matrix.swap(entries);
+    m->mapping.reset();
+    m->mapped = nullptr;
+}
+
+/**
+ * @brief Largest column sum of absolute values of the n x n matrix a.
+ * 
+ */
+double matrix_norm_1(const double* a, int n)
+{
+    vector<double> sums(n, 0.0);
+    for (int i = 0; i < n; ++i)
+    {
+        for (int j = 0; j < n; ++j) sums[j] += fabs(a[(size_t)i * n + j]);
+    }
+    return *max_element(sums.begin(), sums.end());
+}
+
+/**
+ * @brief |A X z - z| (largest entry) for a fixed vector z of +-1 entries: a check in
+ * O(n^2) that X is the inverse of A.
+ * 
+ * @param a const double*  n x n row-major
+ * @param x const double*  n x n row-major
+ * @param n int
+ * @return double 
+ */
+double inverse_residual(const double* a, const double* x, int n)
+{
+    vector<double> z(n);
+    unsigned int state = 12345;
+    for (int i = 0; i < n; ++i)
+    {
+        state = state * 1103515245u + 12345u;
+        z[i] = (state >> 16) & 1 ? 1.0 : -1.0;
+    }
+    vector<double> xz(n);
+    vector<double> residual(n);
+    parallel_for(0, n, parallel_grain(n, 256), [&](int row_begin, int row_end)
+    {
+        for (int i = row_begin; i < row_end; ++i)
+        {
+            double sum = 0;
+            for (int j = 0; j < n; ++j) sum += x[(size_t)i * n + j] * z[j];
+            xz[i] = sum;
+        }
+    });
+    parallel_for(0, n, parallel_grain(n, 256), [&](int row_begin, int row_end)
+    {
+        for (int i = row_begin; i < row_end; ++i)
+        {
+            double sum = -z[i];
+            for (int j = 0; j < n; ++j) sum += a[(size_t)i * n + j] * xz[j];
+            residual[i] = fabs(sum);
+        }
+    });
+    return *max_element(residual.begin(), residual.end());
+}
+
+/**
+ * @brief Last step of every inverse update: `updated` is the new matrix and, when
+ * `usable`, `candidate` is its inverse from the update formula. Unless that candidate
+ * passes inverse_residual(), the inverse is recomputed, and the recomputed one must pass
+ * it too. Then both are stored in m and inverse. If the new matrix is singular, or so
+ * nearly singular that neither inverse passes, m and inverse are left as they were.
+ * 
+ * @return int  INVERSE_UPDATE_APPLIED, INVERSE_UPDATE_SINGULAR or INVERSE_UPDATE_RECOMPUTED
+ */
+int inverse_update_finish(Matrix* m, Matrix* inverse, int size, vector<double>& updated, vector<double>& candidate, bool usable)
+{
+    int status = INVERSE_UPDATE_APPLIED;
+    if (!usable || inverse_residual(updated.data(), candidate.data(), size) > INVERSE_UPDATE_TOLERANCE)
+    {
+        LUDecomposition* decomposition = lu_decompose(updated.data(), size);
+        if (decomposition->singular)
+        {
+            delete decomposition;
+            return INVERSE_UPDATE_SINGULAR;
+        }
+        vector<double> recomputed((size_t)size * size);
+        lu_inverse_into(decomposition, recomputed.data());
+        delete decomposition;
+        // LU only rejects exactly tiny pivots; a pivot just above its tolerance gives an
+        // inverse that is no better than the candidate.
+        if (inverse_residual(updated.data(), recomputed.data(), size) > INVERSE_UPDATE_TOLERANCE) return INVERSE_UPDATE_SINGULAR;
+        candidate.swap(recomputed);
+        status = INVERSE_UPDATE_RECOMPUTED;
+    }
+    matrix_assign(m, size, updated);
+    matrix_assign(inverse, size, candidate);
+    return status;
+}
+
+/**
+ * @brief Woodbury identity: with `updated` = A + U V^T,
+ * (A + U V^T)^-1 = A^-1 - A^-1 U (I + V^T A^-1 U)^-1 V^T A^-1, which costs O(n^2 k)
+ * instead of a new O(n^3) inversion. See inverse_update_low_rank().
  * 
  */
-class Matrix
+int inverse_update_woodbury(Matrix* m, Matrix* inverse, vector<double>& updated, const double* u, const double* v, int k)
 {
-    public:
-    int size;
-    vector<double> matrix;
+    int n = m->size;
+    const double* b = matrix_data(inverse);
+    vector<double> vt((size_t)k * n); // V^T
+    for (int i = 0; i < n; ++i)
+    {
+        for (int j = 0; j < k; ++j) vt[(size_t)j * n + i] = v[(size_t)i * k + j];
+    }
 
-    Matrix(int _size)
+    // gemm_subtract() accumulates with a minus sign, so these two hold the negated products.
+    vector<double> bu((size_t)n * k, 0.0); // -A^-1 U
+    gemm_subtract(n, k, n, b, n, u, k, bu.data(), k);
+    vector<double> vb((size_t)k * n, 0.0); // -V^T A^-1
+    gemm_subtract(k, n, n, vt.data(), n, b, n, vb.data(), n);
+    vector<double> capacitance((size_t)k * k, 0.0); // I + V^T A^-1 U
+    for (int i = 0; i < k; ++i) capacitance[(size_t)i * k + i] = 1;
+    gemm_subtract(k, k, n, vt.data(), n, bu.data(), k, capacitance.data(), k);
+
+    vector<double> candidate;
+    bool usable = false;
+    LUDecomposition* factored = lu_decompose(capacitance.data(), k);
+    if (!factored->singular)
     {
-        size = _size;
+        vector<double> capacitance_inverse((size_t)k * k);
+        lu_inverse_into(factored, capacitance_inverse.data());
+        // Errors in the update grow with the condition number of the capacitance matrix.
+        usable = matrix_norm_1(capacitance.data(), k) * matrix_norm_1(capacitance_inverse.data(), k) * INVERSE_UPDATE_TOLERANCE < 1;
+        for (double& entry : capacitance_inverse) entry = -entry;
+        vector<double> t((size_t)k * n, 0.0); // (I + V^T A^-1 U)^-1 (-V^T A^-1)
+        gemm_subtract(k, n, k, capacitance_inverse.data(), k, vb.data(), n, t.data(), n);
+        candidate.assign(b, b + (size_t)n * n);
+        gemm_subtract(n, n, k, bu.data(), k, t.data(), n, candidate.data(), n);
     }
+    delete factored;
+    return inverse_update_finish(m, inverse, n, updated, candidate, usable);
+}
 
-    Matrix(int _size, vector<double> _matrix)
+/**
+ * @brief Updates m to m + U V^T and `inverse` (the inverse of m) to match, in O(n^2 k)
+ * with the Woodbury identity. When that would lose accuracy (an ill-conditioned update,
+ * or an updated inverse that fails a residual check) the inverse is recomputed instead.
+ * 
+ * @param m Matrix*  n x n, updated in place
+ * @param inverse Matrix*  Inverse of m, updated in place
+ * @param u const double*  n x k, row-major (column j is the j-th update vector)
+ * @param v const double*  n x k, row-major
+ * @param k int  Rank of the update
+ * @return int  INVERSE_UPDATE_APPLIED, INVERSE_UPDATE_SINGULAR (nothing is changed) or
+ * INVERSE_UPDATE_RECOMPUTED
+ */
+int inverse_update_low_rank(Matrix* m, Matrix* inverse, const double* u, const double* v, int k)
+{
+    int n = m->size;
+    vector<double> negative_vt((size_t)k * n);
+    for (int i = 0; i < n; ++i)
     {
-        matrix = _matrix;
-        size = _size;
+        for (int j = 0; j < k; ++j) negative_vt[(size_t)j * n + i] = -v[(size_t)i * k + j];
     }
-};
+    vector<double> updated(matrix_data(m), matrix_data(m) + (size_t)n * n);
+    gemm_subtract(n, n, k, u, k, negative_vt.data(), n, updated.data(), n);
+    return inverse_update_woodbury(m, inverse, updated, u, v, k);
+}
+
+/**
+ * @brief Replaces row `row` of m with `values` (n entries) and updates `inverse` to
+ * match: a rank-one update (see inverse_update_low_rank()).
+ * 
+ */
+int inverse_update_row(Matrix* m, Matrix* inverse, int row, const double* values)
+{
+    int n = m->size;
+    const double* a = matrix_data(m);
+    vector<double> u(n, 0.0);
+    vector<double> v(n);
+    u[row] = 1;
+    for (int j = 0; j < n; ++j) v[j] = values[j] - a[(size_t)row * n + j];
+    vector<double> updated(a, a + (size_t)n * n);
+    copy(values, values + n, updated.begin() + (size_t)row * n);
+    return inverse_update_woodbury(m, inverse, updated, u.data(), v.data(), 1);
+}
 
+/**
+ * @brief Replaces column `col` of m with `values` (n entries) and updates `inverse` to
+ * match: a rank-one update (see inverse_update_low_rank()).
+ * 
+ */
+int inverse_update_column(Matrix* m, Matrix* inverse, int col, const double* values)
+{
+    int n = m->size;
+    const double* a = matrix_data(m);
+    vector<double> u(n);
+    vector<double> v(n, 0.0);
+    v[col] = 1;
+    vector<double> updated(a, a + (size_t)n * n);
+    for (int i = 0; i < n; ++i)
+    {
+        u[i] = values[i] - a[(size_t)i * n + col];
+        updated[(size_t)i * n + col] = values[i];
+    }
+    return inverse_update_woodbury(m, inverse, updated, u.data(), v.data(), 1);
+}
 
 /**
- * @brief Handles index arithmetic for 2d->1d array.
+ * @brief Grows m by one row and column, to [[m, column], [row, corner]], and updates
+ * `inverse` to match in O(n^2) through the Schur complement
+ * s = corner - row A^-1 column. Falls back to recomputing when s is lost to cancellation
+ * or the result fails the residual check.
  * 
- * @param size int 
- * @param row int  2d index
- * @param col int  2d index
- * @return int     1d index
+ * @param m Matrix*  n x n, becomes (n + 1) x (n + 1)
+ * @param inverse Matrix*  Inverse of m, updated in place
+ * @param column const double*  n entries, the new last column above the corner
+ * @param row const double*  n entries, the new last row left of the corner
+ * @param corner double
+ * @return int  INVERSE_UPDATE_APPLIED, INVERSE_UPDATE_SINGULAR (nothing is changed) or
+ * INVERSE_UPDATE_RECOMPUTED
  */
-int calculate_index(int size, int row, int col) { return (row * size) + col; }
+int inverse_update_grow(Matrix* m, Matrix* inverse, const double* column, const double* row, double corner)
+{
+    int n = m->size;
+    int size = n + 1;
+    const double* a = matrix_data(m);
+    const double* b = matrix_data(inverse);
+    vector<double> updated((size_t)size * size);
+    for (int i = 0; i < n; ++i)
+    {
+        copy(a + (size_t)i * n, a + (size_t)(i + 1) * n, updated.begin() + (size_t)i * size);
+        updated[(size_t)i * size + n] = column[i];
+    }
+    copy(row, row + n, updated.begin() + (size_t)n * size);
+    updated[(size_t)n * size + n] = corner;
 
+    vector<double> x(n); // A^-1 column
+    vector<double> y(n, 0.0); // row A^-1
+    parallel_for(0, n, parallel_grain(n, 256), [&](int row_begin, int row_end)
+    {
+        for (int i = row_begin; i < row_end; ++i)
+        {
+            double sum = 0;
+            for (int j = 0; j < n; ++j) sum += b[(size_t)i * n + j] * column[j];
+            x[i] = sum;
+        }
+    });
+    for (int i = 0; i < n; ++i) axpy_subtract(n, -row[i], b + (size_t)i * n, y.data());
+    double schur = corner;
+    double magnitude = fabs(corner);
+    for (int i = 0; i < n; ++i)
+    {
+        schur -= row[i] * x[i];
+        magnitude += fabs(row[i] * x[i]);
+    }
+
+    vector<double> candidate;
+    bool usable = fabs(schur) > magnitude * INVERSE_UPDATE_TOLERANCE;
+    if (usable)
+    {
+        double reciprocal = 1 / schur;
+        candidate.resize((size_t)size * size);
+        parallel_for(0, n, parallel_grain(n, 256), [&](int row_begin, int row_end)
+        {
+            for (int i = row_begin; i < row_end; ++i)
+            {
+                double* out = candidate.data() + (size_t)i * size;
+                double scaled = x[i] * reciprocal;
+                for (int j = 0; j < n; ++j) out[j] = b[(size_t)i * n + j] + scaled * y[j];
+                out[n] = -scaled;
+            }
+        });
+        for (int j = 0; j < n; ++j) candidate[(size_t)n * size + j] = -y[j] * reciprocal;
+        candidate[(size_t)n * size + n] = reciprocal;
+    }
+    return inverse_update_finish(m, inverse, size, updated, candidate, usable);
+}
 
 /**
- * @brief Gets the value at (row, col).
+ * @brief Shrinks m by removing row `row` and column `col`, and updates `inverse` to
+ * match in O(n^2): with B the inverse of m, the new inverse is B without row `col` and
+ * column `row`, minus B[:, row] B[col, :] / B[col, row]. Falls back to recomputing when
+ * that pivot is negligible or the result fails the residual check.
  * 
- * @param m Matrix*
+ * @param m Matrix*  n x n (n >= 2), becomes (n - 1) x (n - 1)
+ * @param inverse Matrix*  Inverse of m, updated in place
  * @param row int
  * @param col int
- * @return double 
+ * @return int  INVERSE_UPDATE_APPLIED, INVERSE_UPDATE_SINGULAR (nothing is changed) or
+ * INVERSE_UPDATE_RECOMPUTED
+ */
+int inverse_update_remove(Matrix* m, Matrix* inverse, int row, int col)
+{
+    int n = m->size;
+    int size = n - 1;
+    const double* a = matrix_data(m);
+    const double* b = matrix_data(inverse);
+    vector<double> updated;
+    updated.reserve((size_t)size * size);
+    for (int i = 0; i < n; ++i)
+    {
+        if (i == row) continue;
+        for (int j = 0; j < n; ++j)
+        {
+            if (j != col) updated.push_back(a[(size_t)i * n + j]);
+        }
+    }
+
+    const double* pivot_row = b + (size_t)col * n;
+    double pivot = pivot_row[row];
+    double magnitude = 0;
+    for (int j = 0; j < n; ++j) magnitude = max(magnitude, fabs(pivot_row[j]));
+
+    vector<double> candidate;
+    bool usable = fabs(pivot) > magnitude * INVERSE_UPDATE_TOLERANCE;
+    if (usable)
+    {
+        candidate.resize((size_t)size * size);
+        parallel_for(0, n, parallel_grain(n, 256), [&](int row_begin, int row_end)
+        {
+            for (int i = row_begin; i < row_end; ++i)
+            {
+                if (i == col) continue;
+                const double* in = b + (size_t)i * n;
+                double* out = candidate.data() + (size_t)(i < col ? i : i - 1) * size;
+                double scaled = in[row] / pivot;
+                for (int j = 0, k = 0; j < n; ++j)
+                {
+                    if (j != row) out[k++] = in[j] - scaled * pivot_row[j];
+                }
+            }
+        });
+    }
+    return inverse_update_finish(m, inverse, size, updated, candidate, usable);
+}
+
+// Most matrices inverted together by one fixed-size kernel call (one lane per matrix).
+const int BATCH_LANES = 8;
+
+/**
+ * @brief One entry from each of W matrices, as a GCC/Clang vector-extension type. W is
+ * chosen to match one native register: 8 for AVX-512, 4 for AVX2, 2 for SSE2/WASM.
+ * 
  */
-double matrix_get(Matrix* m, int row, int col) { return m->matrix.at(calculate_index(m->size, row, col)); }
+template <int W>
+class BatchVector
+{
+    public:
+    typedef double lanes __attribute__((vector_size(W * sizeof(double))));
+    typedef long long mask __attribute__((vector_size(W * sizeof(long long))));
+};
+
+#define FIXED_SIZE_INLINE inline __attribute__((always_inline))
+
+// Per-lane if_true where mask is set, else if_false, for the BatchLanes and BatchMask
+// of invert_fixed_size_body(). Written with bitwise operations rather than a vector ?:
+// because the latter crashes GCC 12 (AVX-512, -O1), and as a macro so that no vector
+// is passed to or returned from a function compiled without the kernel's target (GCC
+// warns that this changes the ABI).
+#define LANE_SELECT(mask, if_true, if_false) \
+    ((BatchLanes)((((BatchMask)(if_true)) & (mask)) | (((BatchMask)(if_false)) & ~(mask))))
 
 /**
- * @brief Creates and returns minor matrix at (row, col)
+ * @brief Inverts W N x N matrices at once with Gauss-Jordan elimination and
+ * partial pivoting. N is a compile-time constant, so the row loops are unrolled
+ * completely; every operation works on all lanes (the batch dimension) at once.
+ * Pivoting differs per lane, so row swaps are done with lane masks instead of branches.
  * 
- * @param m Matrix*
- * @return Matrix* 
+ * Storage is structure-of-arrays: entry (i, j) of lane l is at data[(i * N + j) * stride + l].
+ * 
+ * @param input const double*  First lane of the chunk
+ * @param output double*
+ * @param stride size_t  Distance between consecutive entries of one matrix (the batch size)
+ * @param singular unsigned char*  Set to 1 for lanes with no inverse
+ * @return int  Number of singular lanes
  */
-Matrix* get_minor_matrix(Matrix* m, int row, int col)
+template <int N, int W>
+FIXED_SIZE_INLINE int invert_fixed_size_body(const double* input, double* output, size_t stride, unsigned char* singular)
 {
-    Matrix* minor_matrix = new Matrix(m->size - 1);
-    for (int i = 0; i < m->size; ++i)
+    typedef typename BatchVector<W>::lanes BatchLanes;
+    typedef typename BatchVector<W>::mask BatchMask;
+    const BatchLanes zero = {};
+    BatchLanes a[N][N];
+    BatchLanes x[N][N];
+    BatchLanes scale = zero;
+    BatchMask failed = {};
+
+    #pragma GCC unroll 8
+    for (int i = 0; i < N; ++i)
+    {
+        #pragma GCC unroll 8
+        for (int j = 0; j < N; ++j)
+        {
+            memcpy(&a[i][j], input + (size_t)(i * N + j) * stride, sizeof(BatchLanes));
+            x[i][j] = zero + (i == j ? 1.0 : 0.0);
+            BatchLanes magnitude = LANE_SELECT(a[i][j] < 0, -a[i][j], a[i][j]);
+            scale = LANE_SELECT(magnitude > scale, magnitude, scale);
+        }
+    }
+    const BatchLanes tolerance = scale * (N * numeric_limits<double>::epsilon());
+
+    #pragma GCC unroll 8
+    for (int k = 0; k < N; ++k)
+    {
+        BatchLanes best = LANE_SELECT(a[k][k] < 0, -a[k][k], a[k][k]);
+        BatchLanes pivot_row = zero + k;
+        #pragma GCC unroll 8
+        for (int r = k + 1; r < N; ++r)
+        {
+            BatchLanes magnitude = LANE_SELECT(a[r][k] < 0, -a[r][k], a[r][k]);
+            BatchMask larger = magnitude > best;
+            best = LANE_SELECT(larger, magnitude, best);
+            pivot_row = LANE_SELECT(larger, zero + r, pivot_row);
+        }
+
+        #pragma GCC unroll 8
+        for (int r = k + 1; r < N; ++r) // swap rows k and pivot_row, lane by lane
+        {
+            BatchMask swap_lane = pivot_row == zero + r;
+            for (int c = k; c < N; ++c) // columns left of k are already reduced in both rows
+            {
+                BatchLanes top = a[k][c];
+                a[k][c] = LANE_SELECT(swap_lane, a[r][c], top);
+                a[r][c] = LANE_SELECT(swap_lane, top, a[r][c]);
+            }
+            for (int c = 0; c < N; ++c)
+            {
+                BatchLanes top = x[k][c];
+                x[k][c] = LANE_SELECT(swap_lane, x[r][c], top);
+                x[r][c] = LANE_SELECT(swap_lane, top, x[r][c]);
+            }
+        }
+
+        BatchMask negligible = best <= tolerance;
+        failed = failed | negligible;
+        BatchLanes reciprocal = LANE_SELECT(negligible, zero, 1.0 / a[k][k]);
+        for (int c = k + 1; c < N; ++c) a[k][c] *= reciprocal; // a[k][k] is never read again
+        for (int c = 0; c < N; ++c) x[k][c] *= reciprocal;
+
+        #pragma GCC unroll 8
+        for (int r = 0; r < N; ++r) // eliminate column k from every other row
+        {
+            if (r == k) continue;
+            BatchLanes factor = a[r][k];
+            for (int c = k + 1; c < N; ++c) a[r][c] -= factor * a[k][c];
+            for (int c = 0; c < N; ++c) x[r][c] -= factor * x[k][c];
+        }
+    }
+
+    const BatchLanes not_a_number = zero + numeric_limits<double>::quiet_NaN();
+    #pragma GCC unroll 8
+    for (int i = 0; i < N; ++i)
     {
-        if (i == row) continue; // skip row
-        for (int j = 0; j < m->size; ++j)
+        #pragma GCC unroll 8
+        for (int j = 0; j < N; ++j)
         {
-            if (j == col) continue; // skip col
-            int index_1d = calculate_index(m->size, i, j);
-            minor_matrix->matrix.push_back(m->matrix.at(index_1d));
+            BatchLanes entry = LANE_SELECT(failed, not_a_number, x[i][j]);
+            memcpy(output + (size_t)(i * N + j) * stride, &entry, sizeof(BatchLanes));
         }
     }
-    return minor_matrix;
+    int singular_count = 0;
+    for (int l = 0; l < W; ++l)
+    {
+        singular[l] = failed[l] ? 1 : 0;
+        singular_count += singular[l];
+    }
+    return singular_count;
+}
+
+template <int N>
+int invert_fixed_size_portable(const double* input, double* output, size_t stride, unsigned char* singular)
+{
+    return invert_fixed_size_body<N, 2>(input, output, stride, singular);
+}
+
+#ifdef GEMM_KERNELS_X86
+template <int N>
+__attribute__((target("avx2,fma")))
+int invert_fixed_size_avx2(const double* input, double* output, size_t stride, unsigned char* singular)
+{
+    return invert_fixed_size_body<N, 4>(input, output, stride, singular);
+}
+
+template <int N>
+__attribute__((target("avx512f")))
+int invert_fixed_size_avx512(const double* input, double* output, size_t stride, unsigned char* singular)
+{
+    return invert_fixed_size_body<N, 8>(input, output, stride, singular);
 }
+#endif
 
 /**
- * @brief Calculates determinant of matrix m.
+ * @brief Inverts `count` N x N matrices stored structure-of-arrays, as many at a time
+ * as the widest vector instructions the CPU supports allow. A short last chunk is
+ * padded with identity matrices.
  * 
- * @param m Matrix*
- * @return double 
+ * @return int  Number of singular matrices
  */
-double matrix_determinant(Matrix* m)
+template <int N>
+int invert_fixed_size_batch(int count, const double* input, double* output, unsigned char* singular)
 {
-    if (m->size == 2) return (m->matrix.at(0) * m->matrix.at(3)) - (m->matrix.at(1) * m->matrix.at(2));
+    typedef int (*chunk_kernel)(const double*, double*, size_t, unsigned char*);
+    chunk_kernel kernel = invert_fixed_size_portable<N>;
+    int lanes = 2;
+#ifdef GEMM_KERNELS_X86
+    if (__builtin_cpu_supports("avx512f")) { kernel = invert_fixed_size_avx512<N>; lanes = 8; }
+    else if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) { kernel = invert_fixed_size_avx2<N>; lanes = 4; }
+#endif
+
+    int full_chunks = count / lanes;
+    atomic<int> singular_count(0);
+    parallel_for(0, full_chunks, parallel_grain(full_chunks, 256), [&](int chunk_begin, int chunk_end)
+    {
+        int found = 0;
+        for (int chunk = chunk_begin; chunk < chunk_end; ++chunk)
+        {
+            int lane = chunk * lanes;
+            found += kernel(input + lane, output + lane, count, singular + lane);
+        }
+        singular_count += found;
+    });
 
-    double determinant = 0;
-    for (int i = 0; i < m->size; ++i) // Cofactor expansion along 1st row
+    int remaining = count - full_chunks * lanes;
+    if (remaining > 0)
     {
-        Matrix* minor_matrix = get_minor_matrix(m, 0, i);
-        double minor_matrix_determinant = matrix_determinant(minor_matrix);
-        double entry = matrix_get(m,0,i);
-        if (i % 2 == 1)
+        double padded_input[N * N * BATCH_LANES];
+        double padded_output[N * N * BATCH_LANES];
+        unsigned char padded_singular[BATCH_LANES];
+        for (int e = 0; e < N * N; ++e)
         {
-            determinant += (-1 * minor_matrix_determinant) * entry;
-        } else
+            for (int l = 0; l < lanes; ++l)
+            {
+                int lane = full_chunks * lanes + l;
+                padded_input[e * lanes + l] = l < remaining ? input[(size_t)e * count + lane] : (e % (N + 1) == 0 ? 1.0 : 0.0);
+            }
+        }
+        kernel(padded_input, padded_output, lanes, padded_singular);
+        for (int l = 0; l < remaining; ++l)
         {
-            determinant += (minor_matrix_determinant) * entry;
+            int lane = full_chunks * lanes + l;
+            for (int e = 0; e < N * N; ++e) output[(size_t)e * count + lane] = padded_output[e * lanes + l];
+            singular[lane] = padded_singular[l];
+            singular_count += padded_singular[l];
         }
-        delete minor_matrix;
     }
-    return determinant;
+    return singular_count;
+}
+
+/**
+ * @brief Inverts `count` same-sized matrices in one call. Entry (i, j) of matrix b is
+ * at input[(i * dimension + j) * count + b] (structure-of-arrays), and the inverses are
+ * written to output in the same layout. Singular matrices get singular[b] = 1 and NaN
+ * entries. Dimensions 2 to 8 use the fixed-size kernels; larger ones fall back to
+ * matrix_inverse() one matrix at a time.
+ * 
+ * @param dimension int
+ * @param count int  Number of matrices
+ * @param input const double*
+ * @param output double*
+ * @param singular unsigned char*  count flags
+ * @return int  Number of singular matrices
+ */
+int matrix_inverse_batch(int dimension, int count, const double* input, double* output, unsigned char* singular)
+{
+    PROFILE_SCOPE("real_valued.matrix_inverse_batch");
+    switch (dimension)
+    {
+        case 2: return invert_fixed_size_batch<2>(count, input, output, singular);
+        case 3: return invert_fixed_size_batch<3>(count, input, output, singular);
+        case 4: return invert_fixed_size_batch<4>(count, input, output, singular);
+        case 5: return invert_fixed_size_batch<5>(count, input, output, singular);
+        case 6: return invert_fixed_size_batch<6>(count, input, output, singular);
+        case 7: return invert_fixed_size_batch<7>(count, input, output, singular);
+        case 8: return invert_fixed_size_batch<8>(count, input, output, singular);
+    }
+
+    int entries = dimension * dimension;
+    int singular_count = 0;
+    for (int b = 0; b < count; ++b)
+    {
+        Matrix m(dimension, vector<double>(entries));
+        for (int e = 0; e < entries; ++e) m.matrix[e] = input[(size_t)e * count + b];
+        Matrix* inverse = matrix_inverse(&m);
+        singular[b] = inverse ? 0 : 1;
+        singular_count += singular[b];
+        for (int e = 0; e < entries; ++e) output[(size_t)e * count + b] = inverse ? inverse->matrix[e] : numeric_limits<double>::quiet_NaN();
+        delete inverse;
+    }
+    return singular_count;
+}
+
+/**
+ * @brief Maps a float64 row-major square matrix file (see matrix_file.h) as a Matrix
+ * whose entries stay in the file. With `writable`, changes to the entries are written
+ * back to the file; otherwise they stay in memory. Returns nullptr if the file cannot be
+ * mapped or has another layout.
+ * 
+ * @param path const char*
+ * @param writable bool
+ * @return Matrix* 
+ */
+Matrix* map_matrix_file(const char* path, bool writable = false)
+{
+    shared_ptr<MatrixMapping> mapping = matrix_file_map(path, writable);
+    if (!mapping) return nullptr;
+    const MatrixFileHeader& header = mapping->header;
+    if (header.dtype != MATRIX_FILE_FLOAT64 || header.layout != MATRIX_FILE_ROW_MAJOR || header.rows != header.cols
+        || header.rows == 0 || header.rows > INT_MAX) return nullptr;
+    return new Matrix((int)header.rows, mapping);
+}
+
+/**
+ * @brief Reads a square matrix file in any dtype and layout. float64 row-major files
+ * are mapped rather than copied (see map_matrix_file()); others are converted into a
+ * new in-memory matrix. Returns nullptr if the file cannot be read or is not square.
+ * 
+ * @param path const char*
+ * @return Matrix* 
+ */
+Matrix* read_matrix_file(const char* path)
+{
+    Matrix* mapped = map_matrix_file(path);
+    if (mapped) return mapped;
+    shared_ptr<MatrixMapping> mapping = matrix_file_map(path, false);
+    if (!mapping) return nullptr;
+    const MatrixFileHeader& header = mapping->header;
+    if (header.rows != header.cols || header.rows == 0 || header.rows > INT_MAX) return nullptr;
+    int n = (int)header.rows;
+    Matrix* m = new Matrix(n, vector<double>((size_t)n * n));
+    double* entries = matrix_data(m);
+    for (int i = 0; i < n; ++i)
+    {
+        for (int j = 0; j < n; ++j) entries[(size_t)i * n + j] = matrix_file_get(header, mapping->data(), i, j);
+    }
+    return m;
 }
 
 /**
- * @brief Transposes matrix m
+ * @brief Writes m to a matrix file with the given dtype and layout (see matrix_file.h).
  * 
  * @param m Matrix*
+ * @param path const char*
+ * @param dtype uint32_t  MATRIX_FILE_FLOAT64 or MATRIX_FILE_FLOAT32
+ * @param layout uint32_t  MATRIX_FILE_ROW_MAJOR or MATRIX_FILE_TILED
+ * @param tile uint32_t  Block size of the tiled layout (0 for the default)
+ * @return int  0 on success, -1 if the file could not be written
  */
-void transpose_matrix(Matrix* m)
+int write_matrix_file(Matrix* m, const char* path, uint32_t dtype = MATRIX_FILE_FLOAT64, uint32_t layout = MATRIX_FILE_ROW_MAJOR, uint32_t tile = 0)
+{
+    int n = m->size;
+    shared_ptr<MatrixMapping> mapping = matrix_file_create(path, matrix_file_header(n, n, dtype, layout, tile));
+    if (!mapping) return -1;
+    const double* entries = matrix_data(m);
+    const MatrixFileHeader& header = mapping->header;
+    if (dtype == MATRIX_FILE_FLOAT64 && layout == MATRIX_FILE_ROW_MAJOR)
+    {
+        memcpy(mapping->data(), entries, (size_t)n * n * sizeof(double));
+        return 0;
+    }
+    for (int i = 0; i < n; ++i)
+    {
+        for (int j = 0; j < n; ++j) matrix_file_set(header, mapping->data(), i, j, entries[(size_t)i * n + j]);
+    }
+    return 0;
+}
+
+// Memory the out-of-core inverse may use for the panels it holds, unless told otherwise.
+const size_t OUT_OF_CORE_MEMORY_BUDGET = (size_t)1 << 30;
+
+/**
+ * @brief Panel width for out-of-core work on an n x n matrix: as many columns as fit in
+ * `memory` bytes (an n x width panel of doubles), in whole LU blocks.
+ * 
+ * @param n int
+ * @param memory size_t
+ * @return int 
+ */
+int out_of_core_panel_width(int n, size_t memory)
+{
+    size_t columns = memory / ((size_t)n * sizeof(double)) / LU_BLOCK_SIZE * LU_BLOCK_SIZE;
+    return (int)max((size_t)min(n, LU_BLOCK_SIZE), min((size_t)n, columns));
+}
+
+/**
+ * @brief Factorizes decomposition->lu in place (PA = LU, as lu_decompose()), holding only
+ * one n x panel_width panel of it in memory at a time. Meant for a matrix mapped from a
+ * file (map_matrix_file()) that is larger than memory: every pass over the rest of the
+ * matrix reads and writes it in row order, so the file is streamed rather than paged at
+ * random.
+ * 
+ * For each panel of columns: copy it (all rows from the diagonal down) into memory and
+ * factor it there; write it back; apply its row swaps to the other columns; solve for
+ * the block row of U to its right; then update the trailing matrix, split across the
+ * pool by rows.
+ * 
+ * @param decomposition LUDecomposition*
+ * @param panel_width int
+ * @param tolerance double  Pivots at or below this magnitude are treated as zero
+ */
+void lu_decompose_out_of_core(LUDecomposition* decomposition, int panel_width, double tolerance)
 {
-    for (int i = 0; i < m->size; ++i)
+    int n = decomposition->lu->size;
+    double* a = matrix_data(decomposition->lu);
+    vector<double> buffer((size_t)n * panel_width);
+    double* panel = buffer.data();
+
+    for (int k0 = 0; k0 < n; k0 += panel_width)
     {
-        for (int j = i; j < m->size; ++j)
+        int width = min(panel_width, n - k0);
+        int rows = n - k0;
+        int rest = k0 + width;
+        parallel_for(0, rows, parallel_grain(rows, 256), [&](int row_begin, int row_end)
+        {
+            for (int i = row_begin; i < row_end; ++i) memcpy(panel + (size_t)i * width, a + (size_t)(k0 + i) * n + k0, width * sizeof(double));
+        });
+        lu_factor_block(decomposition, panel, rows, width, width, k0, tolerance, LU_BLOCK_SIZE);
+        parallel_for(0, rows, parallel_grain(rows, 256), [&](int row_begin, int row_end)
+        {
+            for (int i = row_begin; i < row_end; ++i) memcpy(a + (size_t)(k0 + i) * n + k0, panel + (size_t)i * width, width * sizeof(double));
+        });
+
+        for (int k = k0; k < rest; ++k)
         {
-            int index_1d = calculate_index(m->size,i,j);
-            int index_1d_swap = calculate_index(m->size,j,i);
-            double val = matrix_get(m, i, j);
-            double val_swap = matrix_get(m, j, i);
-            m->matrix[index_1d] = val_swap;
-            m->matrix[index_1d_swap] = val;
+            int pivot_row = decomposition->pivots[k];
+            if (pivot_row == k) continue;
+            double* top = a + (size_t)k * n;
+            double* bottom = a + (size_t)pivot_row * n;
+            swap_ranges(top, top + k0, bottom);
+            swap_ranges(top + rest, top + n, bottom + rest);
         }
+        if (rest == n) break;
+
+        parallel_for(rest, n, parallel_grain(n - rest, 64), [&](int col_begin, int col_end) // U12 = L11^-1 A12
+        {
+            lu_forward_substitute(panel, width, width, a + (size_t)k0 * n + col_begin, n, col_end - col_begin);
+        });
+        parallel_for(rest, n, parallel_grain(n - rest, GEMM_MC), [&](int row_begin, int row_end) // A22 -= L21 * U12
+        {
+            gemm_subtract(row_end - row_begin, n - rest, width, panel + (size_t)(row_begin - k0) * width, width,
+                          a + (size_t)k0 * n + rest, n, a + (size_t)row_begin * n + rest, n);
+        });
     }
 }
 
 /**
- * @brief Calculates the inverse of matrix m. Returns as new matrix.
+ * @brief Writes the inverse of the factored matrix to x (as lu_inverse_into()), solving
+ * for panel_width columns at a time in memory and copying each finished panel into x.
  * 
- * @param m Matrix*
- * @return Matrix* 
+ * @param decomposition LUDecomposition*  Non-singular factorization
+ * @param x double*  n x n output, row-major
+ * @param panel_width int
  */
-Matrix* matrix_inverse(Matrix* m)
+void lu_inverse_out_of_core(LUDecomposition* decomposition, double* x, int panel_width)
 {
-    Matrix* matrix_inverse = new Matrix(m->size);
-    double det = matrix_determinant(m);
-    for (int i = 0; i < m->size; ++i)
+    int n = decomposition->lu->size;
+    vector<int> permutation(n); // row i of P I is e_permutation[i]
+    for (int i = 0; i < n; ++i) permutation[i] = i;
+    for (int k = 0; k < n; ++k) swap(permutation[k], permutation[decomposition->pivots[k]]);
+
+    vector<double> buffer((size_t)n * panel_width);
+    double* panel = buffer.data();
+    for (int c0 = 0; c0 < n; c0 += panel_width)
     {
-        for (int j = 0; j < m->size; ++j)
+        int width = min(panel_width, n - c0);
+        fill(panel, panel + (size_t)n * width, 0.0);
+        for (int i = 0; i < n; ++i)
         {
-            double entry = matrix_determinant(get_minor_matrix(m, i, j));
-            if (i + j % 2 == 1) entry *= -1;
-            matrix_inverse->matrix.push_back(entry/det);
+            if (permutation[i] >= c0 && permutation[i] < c0 + width) panel[(size_t)i * width + permutation[i] - c0] = 1;
         }
+        parallel_for(0, width, parallel_grain(width, 64), [&](int col_begin, int col_end)
+        {
+            lu_substitute(decomposition, panel + col_begin, width, col_end - col_begin);
+        });
+        parallel_for(0, n, parallel_grain(n, 256), [&](int row_begin, int row_end)
+        {
+            for (int i = row_begin; i < row_end; ++i) memcpy(x + (size_t)i * n + c0, panel + (size_t)i * width, width * sizeof(double));
+        });
     }
-    transpose_matrix(matrix_inverse);
-    return matrix_inverse;
 }
 
+/**
+ * @brief Inverts the square matrix in the file `input` (any dtype and layout) and writes
+ * the inverse to `output` as a float64 row-major matrix file, for matrices too large to
+ * hold in memory. The LU factors are kept in a scratch file next to the output, and
+ * roughly `memory_budget` bytes are used for the panels held in memory; the operating
+ * system pages the files in and out as they are streamed.
+ * 
+ * @param input const char*
+ * @param output const char*
+ * @param memory_budget size_t  Bytes
+ * @return int  0 on success, 1 if the matrix is singular (no output is written), -1 if a
+ * file could not be read or written
+ */
+int invert_matrix_file(const char* input, const char* output, size_t memory_budget = OUT_OF_CORE_MEMORY_BUDGET)
+{
+    PROFILE_SCOPE("real_valued.invert_matrix_file");
+    shared_ptr<MatrixMapping> source = matrix_file_map(input, false);
+    if (!source) return -1;
+    const MatrixFileHeader header = source->header;
+    if (header.rows != header.cols || header.rows == 0 || header.rows > INT_MAX) return -1;
+    int n = (int)header.rows;
 
+    string scratch_path = string(output) + ".lu";
+    shared_ptr<MatrixMapping> scratch = matrix_file_create(scratch_path.c_str(), matrix_file_header(n, n));
+    unlink(scratch_path.c_str()); // the mapping keeps it alive; nothing is left behind if we stop early
+    if (!scratch) return -1;
 
+    // Copy the input into the scratch file, converting it if needed, and find its scale.
+    madvise(source->base, source->length, MADV_SEQUENTIAL);
+    double* a = (double*)scratch->data();
+    bool native = header.dtype == MATRIX_FILE_FLOAT64 && header.layout == MATRIX_FILE_ROW_MAJOR;
+    vector<double> row_scale(n);
+    parallel_for(0, n, parallel_grain(n, 256), [&](int row_begin, int row_end)
+    {
+        for (int i = row_begin; i < row_end; ++i)
+        {
+            double* row = a + (size_t)i * n;
+            if (native) memcpy(row, (const double*)source->data() + (size_t)i * n, n * sizeof(double));
+            else for (int j = 0; j < n; ++j) row[j] = matrix_file_get(header, source->data(), i, j);
+            double scale = 0;
+            for (int j = 0; j < n; ++j) scale = max(scale, fabs(row[j]));
+            row_scale[i] = scale;
+        }
+    });
+    source.reset();
+    double scale = *max_element(row_scale.begin(), row_scale.end());
 
+    // Half the budget for the panel being factored or solved; the rest is left to the
+    // page cache for the block row of U it is multiplied with.
+    int panel_width = out_of_core_panel_width(n, memory_budget / 2);
+    LUDecomposition decomposition(new Matrix(n, scratch));
+    scratch.reset();
+    lu_decompose_out_of_core(&decomposition, panel_width, lu_tolerance(scale, n));
+    if (decomposition.singular) return 1;
 
+    shared_ptr<MatrixMapping> inverse = matrix_file_create(output, matrix_file_header(n, n));
+    if (!inverse) return -1;
+    lu_inverse_out_of_core(&decomposition, (double*)inverse->data(), panel_width);
+    return msync(inverse->base, inverse->length, MS_SYNC) == 0 ? 0 : -1;
+}
 
 /**
  * @brief Implements CLI for easy testing (as opposed to hard-coding 2d vectors.)
@@ -180,57 +2407,65 @@ Matrix* populate_matrix()
  * 
  * @example (1,2,3),(4,5,6),(7,7,7) is encoded as "1,2,3,\n,4,5,6,\n,7,7,7,\n,"
  * 
+ * The returned pointer stays valid until the next call on the same thread.
+ * 
  * @param m 
  * @return const char* 
  */
 const char* export_matrix_as_string(Matrix* m)
 {
-    string str = "";
-    for (int i = 0; i < m->size; ++i)
-    {
-        for (int j = 0; j < m->size; ++j)
-        {
-            str += to_string(matrix_get(m, i, j)) + ",";
-        }
-        str += "\n,";
-    }
+    PROFILE_SCOPE("real_valued.export_matrix_as_string");
+    thread_local string str;
+    matrix_text_format(matrix_data(m), m->size, str); // shortest text that reads back exactly
     delete m;
     return str.c_str();
 }
 
-
-
-Matrix* decode_input_string(const char* matrix_str) // this method is messy. improve soon
+/**
+ * @brief Reads a matrix encoded as by export_matrix_as_string(), in one pass
+ * (matrix_text_parse()).
+ * 
+ * @param matrix_str const char*
+ * @return Matrix*  nullptr if an entry is not a number or the matrix is not square
+ */
+Matrix* decode_input_string(const char* matrix_str)
 {
-    char delimiter = ',';
-
-    string token = "";
-
-    int dimension_counter = 0;
+    PROFILE_SCOPE("real_valued.decode_input_string");
+    vector<double> matrix_as_doubles;
+    int dimension = matrix_text_parse(matrix_str, strlen(matrix_str), matrix_as_doubles);
+    if (dimension < 0) return nullptr;
+    return new Matrix(dimension, matrix_as_doubles);
+}
 
-    vector<double> matrix_as_doubles = {};
-    for ( ; *matrix_str != '\0'; matrix_str++) // iterate through const char*
+/**
+ * @brief decode_input_string() for exact entries: each token is an integer, a fraction
+ * ("3/4") or a decimal ("0.125"), read without rounding (see rational_parse()).
+ * 
+ * @param matrix_str const char*
+ * @param entries vector<Rational>&  Filled row-major
+ * @return int  The dimension, or -1 if a token is invalid or the matrix is not square
+ */
+int decode_exact_input_string(const char* matrix_str, vector<Rational>& entries)
+{
+    PROFILE_SCOPE("real_valued.decode_exact_input_string");
+    entries.clear();
+    int dimension = 0;
+    const char* token = matrix_str;
+    for (const char* c = matrix_str; ; ++c)
     {
-        if (*matrix_str == delimiter) // if delimiter found, convert token to double, push into double vector, reset token
-        {
-            if (token.size() == 0) // skip empty tokens (newlines)
-            {
-                continue;
-            }
-            double matrix_entry = stod(token);
-            matrix_as_doubles.push_back(matrix_entry);
-            token = "";
-        } else
-        if (*matrix_str == '\n') // if newline found, increment the dimension (tricky little algorithm to find the matrix size)
+        if (*c == '\n') { dimension++; token = c + 1; continue; }
+        if (*c != ',' && *c != '\0') continue;
+        if (c > token)
         {
-            dimension_counter++;
-            continue;
-        } else                   // if neither newline nor delimiter, add char to the token.
-        {
-            token = token + *matrix_str;
+            Rational entry;
+            if (!rational_parse(token, c - token, entry)) return -1;
+            entries.push_back(entry);
         }
+        if (*c == '\0') break;
+        token = c + 1;
     }
-    return new Matrix(dimension_counter, matrix_as_doubles);
+    if ((size_t)dimension * dimension != entries.size()) return -1;
+    return dimension;
 }
 
 extern "C"
@@ -238,16 +2473,188 @@ extern "C"
     const char* matrix_inverse_JS_interact(const char* matrix_str)
     {
         Matrix* matrix = decode_input_string(matrix_str);
+        if (!matrix) return ""; // not a square matrix of numbers
         Matrix* inverse = matrix_inverse(matrix);
         delete matrix;
+        if (!inverse) return ""; // If matrix_inverse() returned null, matrix has no inverse.
         return export_matrix_as_string(inverse);
     }
+
+    /**
+     * @brief Exact inverse of a matrix of integers, fractions or decimals, in the same
+     * string format as matrix_inverse_JS_interact() (e.g. "1,2,\n,3,4,\n,"). Entries of
+     * the result are exact fractions ("-2,1,\n,3/2,-1/2,\n,"). See exact_inverse.h.
+     * 
+     * The returned pointer stays valid until the next call on the same thread.
+     * 
+     * @return const char*  Empty if the matrix is singular or the input is invalid
+     */
+    const char* matrix_inverse_exact_JS_interact(const char* matrix_str)
+    {
+        vector<Rational> entries;
+        int n = decode_exact_input_string(matrix_str, entries);
+        vector<Rational> inverse((size_t)max(n, 0) * max(n, 0));
+        if (n <= 0 || exact_inverse(entries.data(), n, inverse.data())) return "";
+        thread_local string str;
+        str = "";
+        for (int i = 0; i < n; ++i)
+        {
+            for (int j = 0; j < n; ++j) str += rational_to_string(inverse[(size_t)i * n + j]) + ",";
+            str += "\n,";
+        }
+        return str.c_str();
+    }
+
+    /**
+     * @brief Binary interface for JS: inverts the n x n row-major matrix at `matrix` and
+     * writes the inverse to `inverse`. Both are addresses in the WASM heap, so JS fills
+     * and reads them through Float64Array views with no text conversion. `inverse` may be
+     * the same buffer as `matrix`.
+     * 
+     * @param matrix const double*
+     * @param n int
+     * @param inverse double*
+     * @return int  0 on success, 1 if the matrix is singular (inverse is left unchanged)
+     */
+    int invert(const double* matrix, int n, double* inverse) { return structured_inverse_into(matrix, n, inverse); }
+
+    /**
+     * @brief invert() with a hint about the structure of the matrix (one of the
+     * MATRIX_STRUCTURE_ values; 0 detects it).
+     * 
+     */
+    int invert_structured(const double* matrix, int n, double* inverse, int hint)
+    {
+        return structured_inverse_into(matrix, n, inverse, hint);
+    }
+
+    /**
+     * @brief invert() that also reports the residual |A X - I| it reached, through
+     * mixed_precision_inverse_into(). It is about 3x slower than invert(), so use it
+     * only when the residual is wanted. `inverse` may be the same buffer as `matrix`.
+     *
+     * @return int  0 on success, 1 if the matrix is singular
+     */
+    int invert_mixed(const double* matrix, int n, double* inverse, double* residual)
+    {
+        if (matrix != inverse) return mixed_precision_inverse_into(matrix, n, inverse, residual);
+        vector<double> copied(matrix, matrix + (size_t)n * n);
+        return mixed_precision_inverse_into(copied.data(), n, inverse, residual);
+    }
+
+    /**
+     * @brief Binary interface to factorize(): factors the n x n matrix at `matrix` (hint
+     * 0 detects symmetric positive definite matrices, 1 forces the LU, 2 tries Cholesky)
+     * and returns a handle for factor_solve(), factor_determinant() and factor_inverse().
+     * Release it with factor_free().
+     * 
+     * @return Factorization*
+     */
+    Factorization* factor(const double* matrix, int n, int hint) { return factorize(matrix, n, hint); }
+
+    /**
+     * @brief Overwrites the n x nrhs row-major block at `b` with A^-1 b, where A is the
+     * matrix factored by factor(). O(n^2) per right-hand side.
+     * 
+     * @return int  0 on success, 1 if the matrix is singular
+     */
+    int factor_solve(Factorization* handle, double* b, int nrhs) { return factorization_solve(handle, b, nrhs); }
+
+    double factor_determinant(Factorization* handle) { return factorization_determinant(handle); }
+
+    /**
+     * @brief Writes the inverse of the factored matrix to `inverse` (n x n).
+     * 
+     * @return int  0 on success, 1 if the matrix is singular
+     */
+    int factor_inverse(Factorization* handle, double* inverse) { return factorization_inverse_into(handle, inverse); }
+
+    void factor_free(Factorization* handle) { delete handle; }
+
+    /**
+     * @brief Inverts an n x n matrix given in compressed sparse row form (see
+     * SparseMatrix) with the sparse LU, writing the dense inverse to `inverse`. Falls back
+     * to the dense LU if the factors fill in too much.
+     * 
+     * @return int  0 on success, 1 if the matrix is singular
+     */
+    int invert_sparse(int n, const int* row_start, const int* columns, const double* values, double* inverse)
+    {
+        SparseMatrix sparse;
+        sparse.size = n;
+        sparse.row_start.assign(row_start, row_start + n + 1);
+        sparse.columns.assign(columns, columns + row_start[n]);
+        sparse.values.assign(values, values + row_start[n]);
+        double scale = 0;
+        for (double value : sparse.values) scale = max(scale, fabs(value));
+        int status = sparse_inverse_into(&sparse, inverse, lu_tolerance(scale, n), (size_t)n * n / SPARSE_FILL_RATIO);
+        if (status >= 0) return status;
+        vector<double> dense((size_t)n * n, 0.0);
+        for (int i = 0; i < n; ++i)
+        {
+            for (int e = row_start[i]; e < row_start[i + 1]; ++e) dense[(size_t)i * n + columns[e]] = values[e];
+        }
+        return structured_inverse_into(dense.data(), n, inverse, MATRIX_STRUCTURE_GENERAL);
+    }
+
+    /**
+     * @brief Binary interface to matrix_inverse_batch(): `count` n x n matrices in
+     * structure-of-arrays layout in, their inverses out, one singular flag per matrix.
+     * 
+     * @return int  Number of singular matrices
+     */
+    int invert_batch(const double* matrices, int n, int count, double* inverses, unsigned char* singular)
+    {
+        return matrix_inverse_batch(n, count, matrices, inverses, singular);
+    }
+
+    /**
+     * @brief Binary interface to inverse_update_low_rank(): given the n x n matrix at
+     * `matrix` and its inverse at `inverse`, adds U V^T (u and v are n x k, row-major)
+     * to the matrix and updates the inverse to match, both in place.
+     * 
+     * @return int  0 updated, 1 singular (nothing is changed), 2 updated by recomputing
+     */
+    int invert_update(double* matrix, double* inverse, int n, const double* u, const double* v, int k)
+    {
+        size_t count = (size_t)n * n;
+        Matrix m(n, vector<double>(matrix, matrix + count));
+        Matrix x(n, vector<double>(inverse, inverse + count));
+        int status = inverse_update_low_rank(&m, &x, u, v, k);
+        if (status == INVERSE_UPDATE_SINGULAR) return status;
+        copy(m.matrix.begin(), m.matrix.end(), matrix);
+        copy(x.matrix.begin(), x.matrix.end(), inverse);
+        return status;
+    }
 }
 
-int main()
+#ifndef MATRIX_INVERSE_NO_MAIN // define when including this file from a benchmark
+int main(int argc, char** argv)
 {
+    if (argc >= 4 && string(argv[1]) == "--invert-file") // --invert-file INPUT OUTPUT [MEMORY_MB]
+    {
+        size_t budget = argc >= 5 ? (size_t)atoll(argv[4]) << 20 : OUT_OF_CORE_MEMORY_BUDGET;
+        int status = invert_matrix_file(argv[2], argv[3], budget);
+        if (status == 1) cerr<< "Matrix is singular.\n";
+        if (status == -1) cerr<< "Could not read " << argv[2] << " or write " << argv[3] << ".\n";
+        return status == 0 ? 0 : 1;
+    }
+    if (argc >= 3 && string(argv[1]) == "--exact") // --exact "1,2,\n,3,4,\n,"
+    {
+        // The shell passes "\n" through as a backslash and an n, so turn those into newlines.
+        string input;
+        for (const char* c = argv[2]; *c; ++c)
+        {
+            if (c[0] == '\\' && c[1] == 'n') { input += '\n'; ++c; }
+            else input += *c;
+        }
+        const char* inverse = matrix_inverse_exact_JS_interact(input.c_str());
+        if (!*inverse) { cerr<< "Matrix is singular or the input is invalid.\n"; return 1; }
+        cout<< inverse;
+        return 0;
+    }
     const char* matrix_str = "1,2,3.5,\n,2.5,-1,0,\n,0,0,-1.3,\n,";
     Matrix* matrix_m = matrix_inverse(decode_input_string(matrix_str));
     return 1;
 }
-
+#endif
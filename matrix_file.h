@@ -0,0 +1,194 @@
+/*
+A binary file format for matrices, read and written through memory mappings, used by
+inverse_real_valued.cpp for matrices that are too large to load into memory.
+
+Layout: a 4096-byte header, then the entries. The header starts with MatrixFileHeader
+(the rest is zero); the data begins on a page boundary so it can be mapped and used in
+place.
+
+  dtype   MATRIX_FILE_FLOAT64 or MATRIX_FILE_FLOAT32, little-endian IEEE 754
+  layout  MATRIX_FILE_ROW_MAJOR: rows one after another
+          MATRIX_FILE_TILED: tile x tile blocks, each stored row-major, blocks in
+          row-major order. Edge blocks are padded to full size, so every block has the
+          same size and the offset of any entry is simple arithmetic.
+
+Only float64 row-major data can be used in place by the inverse; the other layouts
+are converted when read.
+
+Author: Evan Lauer
+*/
+
+#ifndef MATRIX_FILE_H
+#define MATRIX_FILE_H
+
+#include <memory>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+const char MATRIX_FILE_MAGIC[8] = { 'M', 'I', 'M', 'A', 'T', 'R', 'X', '1' };
+const size_t MATRIX_FILE_HEADER_SIZE = 4096;
+
+const uint32_t MATRIX_FILE_FLOAT64 = 1;
+const uint32_t MATRIX_FILE_FLOAT32 = 2;
+
+const uint32_t MATRIX_FILE_ROW_MAJOR = 0;
+const uint32_t MATRIX_FILE_TILED = 1;
+
+class MatrixFileHeader
+{
+    public:
+    char magic[8];
+    uint32_t dtype;
+    uint32_t layout;
+    uint32_t tile; // block size for MATRIX_FILE_TILED, 0 otherwise
+    uint32_t reserved;
+    uint64_t rows;
+    uint64_t cols;
+};
+
+/**
+ * @brief A file mapped into memory; unmapped when the last owner lets go of it.
+ *
+ */
+class MatrixMapping
+{
+    public:
+    void* base;
+    size_t length;
+    MatrixFileHeader header;
+
+    MatrixMapping(void* _base, size_t _length, const MatrixFileHeader& _header)
+    {
+        base = _base;
+        length = _length;
+        header = _header;
+    }
+
+    ~MatrixMapping() { munmap(base, length); }
+
+    void* data() { return (char*)base + MATRIX_FILE_HEADER_SIZE; }
+};
+
+size_t matrix_file_element_size(const MatrixFileHeader& header) { return header.dtype == MATRIX_FILE_FLOAT32 ? 4 : 8; }
+
+/**
+ * @brief Bytes of entry data that follow the header (including tile padding).
+ *
+ */
+size_t matrix_file_data_bytes(const MatrixFileHeader& header)
+{
+    size_t rows = header.rows;
+    size_t cols = header.cols;
+    if (header.layout == MATRIX_FILE_TILED)
+    {
+        rows = (rows + header.tile - 1) / header.tile * header.tile;
+        cols = (cols + header.tile - 1) / header.tile * header.tile;
+    }
+    return rows * cols * matrix_file_element_size(header);
+}
+
+/**
+ * @brief Position of entry (row, col) among the entries, counted in elements.
+ *
+ */
+size_t matrix_file_offset(const MatrixFileHeader& header, size_t row, size_t col)
+{
+    if (header.layout != MATRIX_FILE_TILED) return row * header.cols + col;
+    size_t tile = header.tile;
+    size_t tiles_per_row = (header.cols + tile - 1) / tile;
+    size_t block = (row / tile) * tiles_per_row + col / tile;
+    return block * tile * tile + (row % tile) * tile + col % tile;
+}
+
+double matrix_file_get(const MatrixFileHeader& header, const void* data, size_t row, size_t col)
+{
+    size_t offset = matrix_file_offset(header, row, col);
+    if (header.dtype == MATRIX_FILE_FLOAT32) return ((const float*)data)[offset];
+    return ((const double*)data)[offset];
+}
+
+void matrix_file_set(const MatrixFileHeader& header, void* data, size_t row, size_t col, double value)
+{
+    size_t offset = matrix_file_offset(header, row, col);
+    if (header.dtype == MATRIX_FILE_FLOAT32) ((float*)data)[offset] = (float)value;
+    else ((double*)data)[offset] = value;
+}
+
+/**
+ * @brief Returns a header for a rows x cols matrix.
+ *
+ */
+MatrixFileHeader matrix_file_header(size_t rows, size_t cols, uint32_t dtype = MATRIX_FILE_FLOAT64, uint32_t layout = MATRIX_FILE_ROW_MAJOR, uint32_t tile = 0)
+{
+    MatrixFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MATRIX_FILE_MAGIC, sizeof(header.magic));
+    header.dtype = dtype;
+    header.layout = layout;
+    header.tile = layout == MATRIX_FILE_TILED ? (tile ? tile : 256) : 0;
+    header.rows = rows;
+    header.cols = cols;
+    return header;
+}
+
+/**
+ * @brief Maps an existing matrix file. With `writable`, changes to the entries are
+ * written back to the file; otherwise the mapping is copy-on-write, so the entries can
+ * still be modified in memory without touching the file. Returns nullptr if the file
+ * cannot be opened or is not a valid matrix file.
+ *
+ * @param path const char*
+ * @param writable bool
+ * @return shared_ptr<MatrixMapping>
+ */
+shared_ptr<MatrixMapping> matrix_file_map(const char* path, bool writable)
+{
+    int fd = open(path, writable ? O_RDWR : O_RDONLY);
+    if (fd < 0) return nullptr;
+    MatrixFileHeader header;
+    struct stat info;
+    bool valid = fstat(fd, &info) == 0 && (size_t)info.st_size >= MATRIX_FILE_HEADER_SIZE
+                 && pread(fd, &header, sizeof(header), 0) == (ssize_t)sizeof(header)
+                 && memcmp(header.magic, MATRIX_FILE_MAGIC, sizeof(header.magic)) == 0
+                 && (header.dtype == MATRIX_FILE_FLOAT64 || header.dtype == MATRIX_FILE_FLOAT32)
+                 && (header.layout == MATRIX_FILE_ROW_MAJOR || (header.layout == MATRIX_FILE_TILED && header.tile > 0))
+                 && (size_t)info.st_size >= MATRIX_FILE_HEADER_SIZE + matrix_file_data_bytes(header);
+    void* base = valid ? mmap(nullptr, info.st_size, PROT_READ | PROT_WRITE, writable ? MAP_SHARED : MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd); // the mapping keeps the file open
+    if (base == MAP_FAILED) return nullptr;
+    return make_shared<MatrixMapping>(base, (size_t)info.st_size, header);
+}
+
+/**
+ * @brief Creates (or replaces) a matrix file with the given header and maps it
+ * read-write. The entries start out zero. The disk space is allocated up front, so a
+ * full disk is reported here instead of as a fault on some later write to the mapping.
+ * Returns nullptr on failure.
+ *
+ * @param path const char*
+ * @param header const MatrixFileHeader&
+ * @return shared_ptr<MatrixMapping>
+ */
+shared_ptr<MatrixMapping> matrix_file_create(const char* path, const MatrixFileHeader& header)
+{
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return nullptr;
+    size_t length = MATRIX_FILE_HEADER_SIZE + matrix_file_data_bytes(header);
+    bool written = posix_fallocate(fd, 0, length) == 0 && pwrite(fd, &header, sizeof(header), 0) == (ssize_t)sizeof(header);
+    void* base = written ? mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (base == MAP_FAILED)
+    {
+        unlink(path);
+        return nullptr;
+    }
+    return make_shared<MatrixMapping>(base, length, header);
+}
+
+#endif
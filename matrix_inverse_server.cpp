@@ -0,0 +1,353 @@
+/*
+Non-interactive native front end for inverse_real_valued.cpp: reads a stream of
+matrices and writes their inverses, for batch jobs that should not go through the
+WASM build.
+
+Input comes from stdin (the default), a file (--input FILE) or, as a daemon, from any
+number of clients connecting to a Unix domain socket (--socket PATH). Matrices are
+inverted on the shared work-stealing pool; responses are written in request order.
+
+Framings:
+
+  text (default), one matrix per line, whitespace separated:
+      request:   n a11 a12 ... ann
+      response:  n x11 x12 ... xnn        (entries printed by matrix_text_format_double(), in
+                                           the shortest form that reads back as the same double)
+                 singular
+                 error <reason>
+
+  binary (--binary), little-endian:
+      request:   uint32 n, then n*n doubles (row-major)
+      response:  uint32 status (0 = ok, 1 = singular, 2 = error), uint32 n,
+                 then n*n doubles when status is 0
+
+Build (natively, not with emcc):
+
+    g++ -O2 -pthread matrix_inverse_server.cpp -o matrix_inverse_server
+
+Usage: ./matrix_inverse_server [--binary] [--input FILE | --socket PATH] [--threads N]
+
+Author: Evan Lauer
+*/
+
+#define MATRIX_INVERSE_NO_MAIN
+#include "inverse_real_valued.cpp"
+#include "formula_sink.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <csignal>
+#include <cerrno>
+#include <thread>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+// Largest dimension accepted; larger requests are answered with an error.
+const int SERVER_MAX_DIMENSION = 16384;
+
+// Most requests inverted together. Only requests that have already arrived are
+// grouped, so a client that waits for each answer is never held up.
+const int SERVER_CHUNK = 256;
+
+/**
+ * @brief Buffered reads from a file descriptor.
+ *
+ */
+class FdReader
+{
+    public:
+    int fd;
+    vector<char> buffer;
+    size_t begin;
+    size_t end;
+
+    FdReader(int _fd) : buffer(1 << 16)
+    {
+        fd = _fd;
+        begin = 0;
+        end = 0;
+    }
+};
+
+/**
+ * @brief Reads more input into the buffer. Returns false at end of input.
+ *
+ */
+bool reader_fill(FdReader* reader)
+{
+    if (reader->begin == reader->end) reader->begin = reader->end = 0;
+    if (reader->end == reader->buffer.size())
+    {
+        if (reader->begin > 0)
+        {
+            memmove(reader->buffer.data(), reader->buffer.data() + reader->begin, reader->end - reader->begin);
+            reader->end -= reader->begin;
+            reader->begin = 0;
+        } else
+        {
+            reader->buffer.resize(reader->buffer.size() * 2);
+        }
+    }
+    ssize_t count;
+    do count = read(reader->fd, reader->buffer.data() + reader->end, reader->buffer.size() - reader->end);
+    while (count < 0 && errno == EINTR);
+    if (count <= 0) return false;
+    reader->end += count;
+    return true;
+}
+
+/**
+ * @brief Whether a read would return data right away (buffered, or waiting on the fd).
+ *
+ */
+bool reader_ready(FdReader* reader)
+{
+    if (reader->begin < reader->end) return true;
+    pollfd waiting = { reader->fd, POLLIN, 0 };
+    return poll(&waiting, 1, 0) > 0;
+}
+
+bool read_exact(FdReader* reader, void* out, size_t length)
+{
+    char* destination = (char*)out;
+    while (length > 0)
+    {
+        if (reader->begin == reader->end && !reader_fill(reader)) return false;
+        size_t count = min(length, reader->end - reader->begin);
+        memcpy(destination, reader->buffer.data() + reader->begin, count);
+        reader->begin += count;
+        destination += count;
+        length -= count;
+    }
+    return true;
+}
+
+bool read_line(FdReader* reader, string& line)
+{
+    line.clear();
+    while (true)
+    {
+        char* start = reader->buffer.data() + reader->begin;
+        char* newline = (char*)memchr(start, '\n', reader->end - reader->begin);
+        if (newline)
+        {
+            line.append(start, newline - start);
+            reader->begin += newline - start + 1;
+            return true;
+        }
+        line.append(start, reader->end - reader->begin);
+        reader->begin = reader->end;
+        if (!reader_fill(reader)) return !line.empty(); // last line without a newline
+    }
+}
+
+/**
+ * @brief One matrix to invert and, once processed, its answer.
+ *
+ */
+class InverseRequest
+{
+    public:
+    int n;
+    vector<double> entries; // the matrix, then the inverse in place
+    int status; // 0 = inverted, 1 = singular, 2 = error
+    string error;
+};
+
+/**
+ * @brief Reads one request. Returns false at end of input. A binary request with a bad
+ * dimension comes back with status 2; the stream cannot be resynchronized after it.
+ *
+ */
+bool read_request(FdReader* reader, bool binary, InverseRequest& request)
+{
+    request.status = 0;
+    request.error.clear();
+    if (binary)
+    {
+        uint32_t n;
+        if (!read_exact(reader, &n, sizeof(n))) return false;
+        if (n == 0 || n > (uint32_t)SERVER_MAX_DIMENSION)
+        {
+            request.n = 0;
+            request.status = 2; // answered, then the stream is closed
+            request.error = "bad dimension";
+            return true;
+        }
+        request.n = (int)n;
+        request.entries.resize((size_t)n * n);
+        return read_exact(reader, request.entries.data(), request.entries.size() * sizeof(double));
+    }
+
+    string line;
+    do
+    {
+        if (!read_line(reader, line)) return false;
+    } while (line.find_first_not_of(" \t\r") == string::npos); // skip blank lines
+    const char* cursor = line.c_str();
+    char* next;
+    long n = strtol(cursor, &next, 10);
+    request.n = 0;
+    request.entries.clear();
+    if (next == cursor || n <= 0 || n > SERVER_MAX_DIMENSION)
+    {
+        request.status = 2;
+        request.error = "bad dimension";
+        return true;
+    }
+    request.n = (int)n;
+    request.entries.resize((size_t)n * n);
+    cursor = next;
+    for (double& entry : request.entries)
+    {
+        entry = strtod(cursor, &next);
+        if (next == cursor)
+        {
+            request.status = 2;
+            request.error = "expected " + to_string(n * n) + " entries";
+            return true;
+        }
+        cursor = next;
+    }
+    while (*cursor == ' ' || *cursor == '\t' || *cursor == '\r') ++cursor;
+    if (*cursor != '\0')
+    {
+        request.status = 2;
+        request.error = "too many entries";
+    }
+    return true;
+}
+
+void write_response(FormulaSink& out, bool binary, const InverseRequest& request)
+{
+    if (binary)
+    {
+        uint32_t header[2] = { (uint32_t)request.status, request.status == 0 ? (uint32_t)request.n : 0u };
+        out.write((const char*)header, sizeof(header));
+        if (request.status == 0) out.write((const char*)request.entries.data(), request.entries.size() * sizeof(double));
+        return;
+    }
+    if (request.status == 1) { out.write("singular\n", 9); return; }
+    if (request.status == 2) { out.write("error " + request.error + "\n"); return; }
+    char number[MATRIX_TEXT_NUMBER_LENGTH + 1] = { ' ' };
+    out.write(to_string(request.n));
+    for (double entry : request.entries) // shortest text that reads back exactly (matrix_text.h)
+    {
+        char* end = matrix_text_format_double(number + 1, entry);
+        out.write(number, end - number);
+    }
+    out.write("\n", 1);
+}
+
+/**
+ * @brief Answers every request on `in` until it ends, writing to `out`. Requests that
+ * are already waiting are inverted together, spread over the shared pool.
+ *
+ * @return long  Number of requests answered
+ */
+long serve_stream(int in, int out_fd, bool binary)
+{
+    FdReader reader(in);
+    FdSink out(out_fd);
+    vector<InverseRequest> chunk(SERVER_CHUNK);
+    long answered = 0;
+    bool open = true;
+    while (open && !out.failed)
+    {
+        int count = 0;
+        while (count < SERVER_CHUNK && (count == 0 || reader_ready(&reader)))
+        {
+            if (!read_request(&reader, binary, chunk[count])) { open = false; break; }
+            ++count;
+            if (binary && chunk[count - 1].status == 2) { open = false; break; }
+        }
+        parallel_for(0, count, 1, [&](int first, int last)
+        {
+            for (int r = first; r < last; ++r)
+            {
+                InverseRequest& request = chunk[r];
+                if (request.status != 0) continue;
+                request.status = invert(request.entries.data(), request.n, request.entries.data());
+            }
+        });
+        for (int r = 0; r < count; ++r) write_response(out, binary, chunk[r]);
+        out.finish(); // answer what has arrived before waiting for more
+        answered += count;
+    }
+    return answered;
+}
+
+/**
+ * @brief Listens on a Unix domain socket and serves each client on its own thread until
+ * the process is stopped.
+ *
+ */
+int serve_socket(const char* path, bool binary)
+{
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) { perror("socket"); return 1; }
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(address.sun_path)) { fprintf(stderr, "socket path too long\n"); return 1; }
+    strcpy(address.sun_path, path);
+    unlink(path); // a stale socket from an earlier run
+    if (::bind(listener, (sockaddr*)&address, sizeof(address)) != 0 || listen(listener, 64) != 0)
+    {
+        perror(path);
+        return 1;
+    }
+    fprintf(stderr, "listening on %s (%s framing, %d threads)\n", path, binary ? "binary" : "text", shared_thread_pool().size());
+    while (true)
+    {
+        int client = accept(listener, nullptr, nullptr);
+        if (client < 0)
+        {
+            if (errno == EINTR) continue;
+            perror("accept");
+            return 1;
+        }
+        thread([client, binary]()
+        {
+            serve_stream(client, client, binary);
+            close(client);
+        }).detach();
+    }
+}
+
+int main(int argc, char** argv)
+{
+    bool binary = false;
+    const char* input = nullptr;
+    const char* socket_path = nullptr;
+    for (int i = 1; i < argc; ++i)
+    {
+        string option = argv[i];
+        if (option == "--binary") binary = true;
+        else if (option == "--text") binary = false;
+        else if (option == "--input" && i + 1 < argc) input = argv[++i];
+        else if (option == "--socket" && i + 1 < argc) socket_path = argv[++i];
+        else if (option == "--threads" && i + 1 < argc) set_thread_count(atoi(argv[++i]));
+        else
+        {
+            fprintf(stderr, "usage: %s [--binary|--text] [--input FILE | --socket PATH] [--threads N]\n", argv[0]);
+            return 2;
+        }
+    }
+    signal(SIGPIPE, SIG_IGN); // a client hanging up must not stop the server
+
+    if (socket_path) return serve_socket(socket_path, binary);
+    int in = 0;
+    if (input)
+    {
+        in = open(input, O_RDONLY);
+        if (in < 0) { perror(input); return 1; }
+    }
+    serve_stream(in, 1, binary);
+    if (input) close(in);
+    return 0;
+}
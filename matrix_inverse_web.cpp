@@ -10,11 +10,12 @@ this formula, conduct the following operations:
 1) For each entry in the matrix, do the following:
  a) Calculate the formula for the determinant of the minor matrix at the given entry.
     This formula is found through a recursive function, determinant().
-2) Populate a new matrix using the formulas found in step 1a). 
-3) Find the transpose of the new matrix.
+2) Populate a new matrix using the formulas found in step 1a), transposed as it is
+   written: the formula of entry (i, j) goes to (j, i).
 
 In this code, a matrix is represented as a vector<vector<tuple>>, where each entry
-can store both a string and an integer value. 
+stores both the id of its interned name and its value. Formulas are polynomials over
+those ids, kept in a PolynomialArena (see expression.h) and only turned into text on request. 
 
 Because of this data structure, the code is able to return a closed-form equation for
 the inverse of a matrix of any given size, as well as the actual inverse of a real matrix.
@@ -31,155 +32,311 @@ Author: Evan Lauer
 #include <sstream>
 #include <tuple>
 
+#include "expression.h"
+#include "exact_inverse.h"
+#include "profiling.h"
+#include "matrix_text.h"
+
 using namespace std;
 
-// Returns a string representation of the (row, col) entry of a matrix.
+// Entry names ("a11", "a12", ...) are interned once; a matrix entry stores the id.
+//
+VariableTable* entry_names()
+{
+    static VariableTable table;
+    return &table;
+}
+
+// Closed-form formulas built by determinant() and inverse(), as polynomials over the entry ids.
 //
-string* get_entry_name(int row, int col)
+PolynomialArena* formulas()
+{
+    thread_local PolynomialArena arena;
+    return &arena;
+}
+
+// Returns the id of the name of the (row, col) entry of a matrix.
+//
+VariableId get_entry_name(int row, int col)
+{
+    return intern_variable(entry_names(), "a" + std::to_string(row + 1) + std::to_string(col + 1));
+}
+
+// Frees a matrix built from new'd rows (as every matrix in this file is).
+//
+template<class Entry>
+void delete_matrix(vector<vector<Entry>*>* matrix)
+{
+    if (!matrix) return;
+    for (vector<Entry>* row : *matrix) delete row;
+    delete matrix;
+}
+
+// Bump allocator for the row/column index lists of minors. Allocation moves `top` up;
+// scratch_release() moves it back to an earlier mark, freeing everything allocated
+// since in one step. The storage only grows, so after the first few calls taking a
+// minor allocates nothing. Lists are addressed by offset, since storage can move.
+//
+class ScratchArena
+{
+    public:
+    vector<int> storage;
+    size_t top = 0;
+};
+
+ScratchArena* scratch()
 {
-    return new string("a" + std::to_string(row + 1) + std::to_string(col + 1));
+    thread_local ScratchArena arena;
+    return &arena;
 }
 
-// Transposes the given matrix.
+size_t scratch_allocate(ScratchArena* arena, size_t count)
+{
+    size_t offset = arena->top;
+    arena->top += count;
+    if (arena->storage.size() < arena->top) arena->storage.resize(max(arena->top, 2 * arena->storage.size()));
+    return offset;
+}
+
+void scratch_release(ScratchArena* arena, size_t mark) { arena->top = mark; }
+
+// A square submatrix of `matrix`, kept as lists of the parent rows and columns it uses
+// (at offsets `rows` and `cols` in the scratch arena) instead of a copy of the entries.
+//
+class MatrixView
+{
+    public:
+    vector<vector<tuple<VariableId,double>>*>* matrix;
+    int size;
+    size_t rows;
+    size_t cols;
+};
+
+// Returns a view of the whole matrix.
 //
-vector<vector<tuple<string*, double>>*>* transpose(vector<vector<tuple<string*, double>>*>* matrix)
+MatrixView whole_matrix(vector<vector<tuple<VariableId,double>>*>* matrix)
 {
-    vector<vector<tuple<string*, double>>*>* new_matrix = new vector<vector<tuple<string*, double>>*>();
-    for (int col = 0; col < matrix->size(); col++) // traverses by column, appends by row, thus getting the transpose
+    ScratchArena* arena = scratch();
+    MatrixView view;
+    view.matrix = matrix;
+    view.size = (int)matrix->size();
+    view.rows = scratch_allocate(arena, view.size);
+    view.cols = scratch_allocate(arena, view.size);
+    for (int i = 0; i < view.size; i++)
     {
-        vector<tuple<string*, double>>* new_row = new vector<tuple<string*, double>>();
-        for (int row = 0; row < matrix->size(); row++)
-        {
-            new_row->push_back(matrix->at(row)->at(col)); // appends the (row, col) value to the new row
-        }
-        new_matrix->push_back(new_row);
+        arena->storage[view.rows + i] = i;
+        arena->storage[view.cols + i] = i;
     }
-    return new_matrix;
+    return view;
 }
 
-// Creates and returns the <row, col> minor matrix (0 indexed).
+// Returns the (row, col) entry of a view.
 //
-vector<vector<tuple<string*,double>>*>* minor_matrix(vector<vector<tuple<string*,double>>*>* matrix, double row, double col)
+const tuple<VariableId,double>& view_get(const MatrixView& view, int row, int col)
 {
-    vector<vector<tuple<string*,double>>*>* minor = new vector<vector<tuple<string*,double>>*>();
-    for (int i = 0; i < matrix->size(); i++) // row
+    const vector<int>& indices = scratch()->storage;
+    return view.matrix->at(indices[view.rows + row])->at(indices[view.cols + col]);
+}
+
+// Transposes the given matrix in place, swapping the entries rather than copying the
+// rows into a new matrix.
+//
+void transpose(vector<vector<tuple<int, double>>*>* matrix)
+{
+    PROFILE_SCOPE("web.transpose");
+    for (int row = 0; row < matrix->size(); row++)
     {
-        if (i == row) continue; // skip row i
-        vector<tuple<string*,double>>* new_row = new vector<tuple<string*,double>>();
-        for (int j = 0; j < matrix->size(); j++) // col
-        {   
-            if (j == col) continue; // skip column j
-            new_row->push_back(matrix->at(i)->at(j));
-        }
-        minor->push_back(new_row);
+        for (int col = row + 1; col < matrix->size(); col++) swap((*matrix->at(row))[col], (*matrix->at(col))[row]);
+    }
+}
+
+// Returns a view of the <row, col> minor of a view (0 indexed). Only the index lists are
+// allocated, from the scratch arena.
+//
+MatrixView minor_matrix(const MatrixView& parent, int row, int col)
+{
+    PROFILE_SCOPE("web.minor_matrix");
+    ScratchArena* arena = scratch();
+    MatrixView minor;
+    minor.matrix = parent.matrix;
+    minor.size = parent.size - 1;
+    minor.rows = scratch_allocate(arena, minor.size);
+    minor.cols = scratch_allocate(arena, minor.size);
+    vector<int>& indices = arena->storage;
+    for (int i = 0, kept = 0; i < parent.size; i++) // row
+    {
+        if (i != row) indices[minor.rows + kept++] = indices[parent.rows + i]; // skip row i
+    }
+    for (int j = 0, kept = 0; j < parent.size; j++) // col
+    {
+        if (j != col) indices[minor.cols + kept++] = indices[parent.cols + j]; // skip column j
     }
     return minor;
 }
 
 // Returns the determinant of the given 2x2 matrix (tuple<general equation, actual value>).
+// The general equation is the id of a new polynomial in formulas().
 //
-tuple<string*,double> two_by_two_determinant(vector<vector<tuple<string*,double>>*>* matrix)
+tuple<int,double> two_by_two_determinant(const MatrixView& matrix)
 {
-    string determinant_str;
     double determinant_double;
 
-    tuple<string*,double> a11 = matrix->at(0)->at(0);
-    tuple<string*,double> a12 = matrix->at(0)->at(1);
-    tuple<string*,double> a21 = matrix->at(1)->at(0);
-    tuple<string*,double> a22 = matrix->at(1)->at(1);
+    tuple<VariableId,double> a11 = view_get(matrix, 0, 0);
+    tuple<VariableId,double> a12 = view_get(matrix, 0, 1);
+    tuple<VariableId,double> a21 = view_get(matrix, 1, 0);
+    tuple<VariableId,double> a22 = view_get(matrix, 1, 1);
 
     // general equation = a11a22 - a12a21
-    determinant_str = "(" + *(get<0>(a11)) + *(get<0>(a22)) + " - " + *(get<0>(a12)) + *(get<0>(a21)) + ")";
+    int determinant_formula = polynomial_begin(formulas(), 2);
+    VariableId diagonal[2] = { get<0>(a11), get<0>(a22) };
+    VariableId anti_diagonal[2] = { get<0>(a12), get<0>(a21) };
+    polynomial_add_term(formulas(), 1, diagonal);
+    polynomial_add_term(formulas(), -1, anti_diagonal);
 
     // determinant_double = a11a22 - a12a21
     determinant_double = (get<1>(a11) * get<1>(a22)) - (get<1>(a12) * get<1>(a21));
 
-    return make_tuple(new string(determinant_str), determinant_double);
+    return make_tuple(determinant_formula, determinant_double);
 }
 
 // Returns the determinant of the given matrix (tuple<general equation, actual value>).
+// The general equation is the id of a new polynomial in formulas(); the formulas of the
+// minors are dropped once they have been multiplied into it.
 //
 // Uses a 1st row cofactor expansion.
-tuple<string*,double> determinant(vector<vector<tuple<string*,double>>*>* matrix)
+tuple<int,double> determinant(const MatrixView& matrix)
 {
-    if (matrix->size() == 2)    {   return two_by_two_determinant(matrix);  }
+    PROFILE_SCOPE("web.determinant");
+    if (matrix.size == 2)    {   return two_by_two_determinant(matrix);  }
 
-    string determinant_str; // General equation (ie: a11a22-a21a12)
+    PolynomialArena* arena = formulas();
+    int first_minor = (int)arena->polynomials.size(); // minor formulas are stacked from here
     double determinant_double = 0; // Actual value
 
-    for (int col = 0; col < matrix->size(); col++) // Traverse first row
+    for (int col = 0; col < matrix.size; col++) // Traverse first row
     {
-        vector<vector<tuple<string*,double>>*>* minor = minor_matrix(matrix, 0, col);
-
+        size_t mark = scratch()->top;
+        MatrixView minor = minor_matrix(matrix, 0, col);
 
-        tuple<string*,double> det = determinant(minor);
+        double minor_matrix_determinant_double = get<1>(determinant(minor));
+        scratch_release(scratch(), mark); // frees the index lists of this minor and all of its minors
 
+        if (col % 2 == 1) minor_matrix_determinant_double *= -1;
 
-
-        string minor_matrix_determinant_str = *(get<0>(det));
-        double minor_matrix_determinant_double = get<1>(det);
-
-        if (col % 2 == 1)
-        {
-            minor_matrix_determinant_str = "(-" + *(get<0>(matrix->at(0)->at(col))) + ")" + minor_matrix_determinant_str;
-            minor_matrix_determinant_double *= -1;
-        } else
-        { 
-            minor_matrix_determinant_str = "(" + *(get<0>(matrix->at(0)->at(col))) + ")" + minor_matrix_determinant_str;
-        }
-        
-
-        if (col != 0) determinant_str += " + ";
-        determinant_str += minor_matrix_determinant_str;
-
-        minor_matrix_determinant_double *= get<1>(matrix->at(0)->at(col));
+        minor_matrix_determinant_double *= get<1>(view_get(matrix, 0, col));
         determinant_double += minor_matrix_determinant_double;
     }
 
-    return make_tuple(new string(determinant_str),determinant_double);
+    // General equation (ie: a11a22-a21a12): each first-row entry times its minor, signs alternating
+    polynomial_begin(arena, matrix.size);
+    for (int col = 0; col < matrix.size; col++)
+    {
+        polynomial_add_product(arena, col % 2 == 1 ? -1 : 1, get<0>(view_get(matrix, 0, col)), first_minor + col);
+    }
+    int determinant_formula = polynomial_collapse(arena, first_minor);
+
+    return make_tuple(determinant_formula,determinant_double);
 
 }
 
+// Returns the determinant of the given matrix; see determinant(const MatrixView&).
+//
+tuple<int,double> determinant(vector<vector<tuple<VariableId,double>>*>* matrix)
+{
+    size_t mark = scratch()->top;
+    tuple<int,double> result = determinant(whole_matrix(matrix));
+    scratch_release(scratch(), mark);
+    return result;
+}
+
+// inverse() switches to exact arithmetic when |determinant| is at most this fraction of
+// Hadamard's bound, i.e. when the matrix is ill conditioned enough (condition number
+// around 10^8 or more) for rounding to dominate the determinant.
+const double ROUNDED_DETERMINANT_LIMIT = 1e-8;
+
 /**
  * @brief Returns both the value and closed-form equation for theinverse of a given matrix (3x3 or larger).
  * Returns null if matrix has no inverse, or size is < 3.
  * 
- * @param matrix A 2d vector of (string,double) tuples. The string represents the name of the entry (aij)
- * and the double represents the determinant_double. The string is included to allow for calculation of
- * the closed-form equation.
+ * Dividing rounded cofactors by a rounded determinant, and testing that determinant
+ * against zero, goes wrong for nearly singular matrices. So when exact entries are given,
+ * or the rounded determinant is small next to Hadamard's bound (the product of the row
+ * lengths), the values come from the exact inverse (exact_inverse.h) instead, rounded
+ * once, and the matrix is singular only if its exact determinant is zero.
+ * 
+ * @param matrix A 2d vector of (variable id, double) tuples. The id names the entry (aij) and the
+ * double is its value. The id is included to allow for calculation of the closed-form equation.
+ * @param exact_entries The exact values of the entries, row-major, when the doubles are
+ * rounded (e.g. parsed from "0.1"); by default the doubles are taken as exact.
+ * @return Entries of (formula id in formulas(), value).
  */
-vector<vector<tuple<string*,double>>*>* inverse(vector<vector<tuple<string*,double>>*>* matrix)
+vector<vector<tuple<int,double>>*>* inverse(vector<vector<tuple<VariableId,double>>*>* matrix, const vector<Rational>* exact_entries = nullptr)
 {
+    PROFILE_SCOPE("web.inverse");
     if (matrix->size() <= 2) return nullptr;
 
-    double major_determinant = get<1>(determinant(matrix));
-    if (major_determinant == 0) return nullptr;
-    
-    vector<vector<tuple<string*,double>>*>* new_matrix = new vector<vector<tuple<string*,double>>*>();
+    int n = matrix->size();
+    double major_determinant = 0;
+    vector<Rational> converted;
+    if (!exact_entries)
+    {
+        major_determinant = get<1>(determinant(matrix));
+        double bound = 1;
+        for (int row = 0; row < n; row++)
+        {
+            double length = 0;
+            for (int col = 0; col < n; col++) length += get<1>(matrix->at(row)->at(col)) * get<1>(matrix->at(row)->at(col));
+            bound *= sqrt(length);
+        }
+        if (!(fabs(major_determinant) > bound * ROUNDED_DETERMINANT_LIMIT))
+        {
+            for (int row = 0; row < n; row++)
+            {
+                for (int col = 0; col < n; col++) converted.push_back(rational_from_double(get<1>(matrix->at(row)->at(col))));
+            }
+            exact_entries = &converted;
+        }
+    }
+    vector<BigInt> exact; // the exact inverse is exact / exact_denominator
+    BigInt exact_denominator;
+    if (exact_entries)
+    {
+        exact.resize((size_t)n * n);
+        if (exact_inverse_scaled(exact_entries->data(), n, exact.data(), exact_denominator)) return nullptr;
+    }
+
+    size_t mark = scratch()->top;
+    MatrixView whole = whole_matrix(matrix);
+    // The inverse is the transpose of the cofactor matrix, so cofactor (row, col) is
+    // written straight to entry (col, row) and no transpose is needed afterwards.
+    vector<vector<tuple<int,double>>*>* new_matrix = new vector<vector<tuple<int,double>>*>();
+    for (int row = 0; row < matrix->size(); row++) new_matrix->push_back(new vector<tuple<int,double>>(matrix->size()));
 
     for (int row = 0; row < matrix->size(); row++)
     {
-        vector<tuple<string*,double>>* new_row = new vector<tuple<string*,double>>();
         for (int col = 0; col < matrix->size(); col++)
         {
-            vector<vector<tuple<string*,double>>*>* minor = minor_matrix(matrix, row, col);
-            tuple<string*,double> minor_matrix_determinant_tup = determinant(minor);
-            string minor_matrix_determinant_str = *(get<0>(minor_matrix_determinant_tup));
+            size_t minor_mark = scratch()->top;
+            tuple<int,double> minor_matrix_determinant_tup = determinant(minor_matrix(whole, row, col));
+            scratch_release(scratch(), minor_mark);
+            int minor_matrix_determinant_formula = get<0>(minor_matrix_determinant_tup);
             double minor_matrix_determinant_double = get<1>(minor_matrix_determinant_tup);
 
             if ((row + col) % 2 == 1)
             {
                 minor_matrix_determinant_double *= -1;
-                minor_matrix_determinant_str = "(-1)" + minor_matrix_determinant_str;
+                PolynomialArena* arena = formulas();
+                const Polynomial& formula = arena->polynomials[minor_matrix_determinant_formula];
+                for (size_t t = 0; t < formula.term_count; ++t) arena->coefficients[formula.first_term + t] *= -1;
             }
-            minor_matrix_determinant_double /= major_determinant;
+            if (exact.empty()) minor_matrix_determinant_double /= major_determinant;
+            else minor_matrix_determinant_double = bigint_ratio_to_double(exact[(size_t)col * n + row], exact_denominator); // entry (col, row) of the inverse
 
-            new_row->push_back( make_tuple(new string( minor_matrix_determinant_str ), minor_matrix_determinant_double ) );
+            (*new_matrix->at(col))[row] = make_tuple(minor_matrix_determinant_formula, minor_matrix_determinant_double);
         }
-        new_matrix->push_back(new_row);
     }
-
-    return transpose(new_matrix);
+    scratch_release(scratch(), mark);
+    return new_matrix;
 }
 
 
@@ -196,7 +353,10 @@ extern "C"
  * this will be faster than a pure-JS version of the function, due to JS garbage collection.
  * Speed tests would be a good way to validate this.
  * 
- * This method is kind of nasty to read...
+ * The input is read in one pass, each token in place, and the entries are written in
+ * the shortest form that reads back as the same double (matrix_text.h).
+ * 
+ * The returned pointer stays valid until the next call on the same thread.
  * 
  * @param matrix_input string
  * @return string 
@@ -204,73 +364,90 @@ extern "C"
 
 const char* inverse_from_input_string(const char* matrix_input_ch)
 {
-    string matrix_input = matrix_input_ch;
+    PROFILE_SCOPE("web.inverse_from_input_string");
+    const char* matrix_input = matrix_input_ch;
+    const char* matrix_input_end = matrix_input + strlen(matrix_input);
     int row = 0; int col = 0;
-    vector<vector<tuple<string*,double>>*>* matrix = new vector<vector<tuple<string*,double>>*>();
-    vector<tuple<string*,double>>* curr_row = new vector<tuple<string*,double>>();
+    vector<vector<tuple<VariableId,double>>*>* matrix = new vector<vector<tuple<VariableId,double>>*>();
+    vector<tuple<VariableId,double>>* curr_row = new vector<tuple<VariableId,double>>();
+    vector<Rational> exact_entries;
 
     // Set delimiter
-    string delimiter = ",";
-    while (matrix_input.size() != 0)
+    const char delimiter = ',';
+    while (matrix_input != matrix_input_end)
     {
-        int found_delimiter = matrix_input.find(delimiter);
-        if (found_delimiter == -1)
+        const char* found_delimiter = (const char*)memchr(matrix_input, delimiter, matrix_input_end - matrix_input);
+        if (!found_delimiter)
         {
             cerr<< "Inverse_from_input_string() error: Delimiter error--check input string";
+            delete curr_row;
+            delete_matrix(matrix);
             return "";
         }
-        string token = matrix_input.substr(0, matrix_input.find(delimiter));
-        
+        size_t token_length = found_delimiter - matrix_input;
 
-        if (token.compare("\n") == 0)
+        if (token_length == 1 && *matrix_input == '\n')
         {
             matrix->push_back(curr_row);
-            curr_row = new vector<tuple<string*,double>>();
+            curr_row = new vector<tuple<VariableId,double>>();
             col = 0;
             row++;
         } else
         {
-            double token_as_double;
-            try
-            {
-                { token_as_double = stod(token); } // Try to convert token to a double.
-            }
-            catch (const std::exception& e)
+            Rational token_exact; // "0.1" is kept as 1/10, so singularity is decided exactly
+            if (!rational_parse(matrix_input, token_length, token_exact))
             {
                 std::cerr << "An invalid input string was given.\n";
+                delete curr_row;
+                delete_matrix(matrix);
                 return ""; // Returns empty string to Javascript
             }
+            double token_as_double = rational_to_double(token_exact);
+            exact_entries.push_back(token_exact);
 
-            string* entry_name = get_entry_name(row,col);
+            VariableId entry_name = get_entry_name(row,col);
 
             curr_row->push_back(make_tuple(entry_name,token_as_double));
             col++;
         }
-        if (matrix_input.size() - 1 == found_delimiter) // If the last delimiter is found, break out of the loop.
+        if (found_delimiter + 1 == matrix_input_end) // If the last delimiter is found, break out of the loop.
         {
             matrix->push_back(curr_row);
             break;
         }
 
         // If the last delimiter is not found, found_delimiter + 1 must be in range.
-        matrix_input = matrix_input.substr(found_delimiter + 1);
+        matrix_input = found_delimiter + 1;
     }
 
-    vector<vector<tuple<string*,double>>*>* matrix_inverse = inverse(matrix);
+    formulas()->polynomials.clear(); // formulas from the previous call are not needed
+    formulas()->variables.clear();
+    formulas()->coefficients.clear();
+    bool square = exact_entries.size() == matrix->size() * matrix->size();
+    vector<vector<tuple<int,double>>*>* matrix_inverse = square ? inverse(matrix, &exact_entries) : nullptr;
+    delete_matrix(matrix);
 
-    string ret = "";
+    thread_local string ret; // returned to Javascript, so it must outlive this call
+    ret = "";
 
     if (!matrix_inverse) return ""; // If inverse() returned null, matrix has no inverse (or wrong size).
 
+    size_t n = matrix_inverse->size();
+    ret.resize(n * n * (MATRIX_TEXT_NUMBER_LENGTH + 1) + n * 2); // the longest the text can be
+    char* cursor = &ret[0];
     for (int i = 0; i < matrix_inverse->size(); ++i)
     {
         for (int j = 0; j < matrix_inverse->size(); ++j)
         {
             double entry_as_double = get<1>(matrix_inverse->at(i)->at(j));
-            ret += to_string(entry_as_double) + delimiter; // Each entry is added to the return string with a delimiter
+            cursor = matrix_text_format_double(cursor, entry_as_double); // Each entry is added to the return string with a delimiter
+            *cursor++ = delimiter;
         }
-        ret += "\n" + delimiter; // After each row, a newline and a delimiter are added to the return string
+        *cursor++ = '\n'; // After each row, a newline and a delimiter are added to the return string
+        *cursor++ = delimiter;
     }
+    ret.resize(cursor - ret.data());
+    delete_matrix(matrix_inverse);
 
     const char* ret_ch = ret.c_str();
     return ret_ch;
@@ -278,6 +455,7 @@ const char* inverse_from_input_string(const char* matrix_input_ch)
 
 }
 
+#ifndef MATRIX_INVERSE_NO_MAIN // define when including this file from a benchmark
 int main()
 {
     // string s = inverse_from_input_string("1.1,1,0,1,\n,0,0,2,3,\n,1,0,1,.5,\n,3.1,1.1,.5,0,");
@@ -288,28 +466,28 @@ int main()
     // Test code:
     
 
-    vector<vector<tuple<string*,double>>*>* matrix = new vector<vector<tuple<string*, double>>*>();
+    vector<vector<tuple<VariableId,double>>*>* matrix = new vector<vector<tuple<VariableId, double>>*>();
     cout<<"Square matrix dimension (must be an integer >= 3): ";
     int dimension;
     cin>>dimension;
     if (dimension < 3) { cout<< "\nDimension must be an integer >= 3.\n"; exit(-2); }
     for (int i = 0; i < dimension; i++)
     {
-        vector<tuple<string*,double>>* new_row = new vector<tuple<string*,double>>();
+        vector<tuple<VariableId,double>>* new_row = new vector<tuple<VariableId,double>>();
         cout<< "Row " + to_string(i + 1) + ":\n";
         for (int j = 0; j < dimension; j++)
         {
-            cout<< *get_entry_name(i,j) + ": ";
+            VariableId name = get_entry_name(i,j);
+            cout<< entry_names()->names[name] + ": ";
             double val;
             cin >> val;
-            string* name = get_entry_name(i,j);
             new_row->push_back(make_tuple(name, val));
         }
         cout<< "\n";
         matrix->push_back(new_row);
     }
     
-    vector<vector<tuple<string*,double>>*>* inverse_matrix = inverse(matrix);
+    vector<vector<tuple<int,double>>*>* inverse_matrix = inverse(matrix);
     if (!inverse_matrix) { cout<< "\nMatrix has no inverse.\n"; exit(-1); }
     for (int i = 0; i <dimension;i++)
     {
@@ -324,6 +502,7 @@ int main()
     
     return 1;
 }
+#endif
 
 
 
@@ -0,0 +1,258 @@
+/*
+Reading and writing numbers in the text matrix format of the JS interfaces, where
+(1,2),(3,4) is "1,2,\n,3,4,\n,".
+
+Tokens are found with memchr and each number is read in place with from_chars, with no
+temporary strings, so the whole input is one pass. Numbers are written with to_chars,
+which gives the shortest text that reads back as the same double (to_string kept only
+six decimals, so 1e-7 came back as 0). The output is written into a buffer sized once
+for the worst case.
+
+Converting numbers is nearly all of the work, so large matrices are split over the
+thread pool (thread_pool.h): the input into pieces that end at a ',', the output by rows.
+
+Where the standard library has no floating point <charconv> (older libc++, as in some
+Emscripten releases), strtod and snprintf are used instead, with the same results. On
+both paths a number too large for a double is an error, and one too small reads as the
+nearest double (0, or a subnormal), as in strtod and Javascript's parseFloat.
+
+Author: Evan Lauer
+*/
+
+#ifndef MATRIX_TEXT_H
+#define MATRIX_TEXT_H
+
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include <cerrno>
+#include <cmath>
+#include <charconv>
+
+#include "thread_pool.h"
+
+using namespace std;
+
+// Longest text of one double written by matrix_text_format_double(), e.g.
+// "-2.2250738585072014e-308".
+const int MATRIX_TEXT_NUMBER_LENGTH = 24;
+
+// Bytes of input, and entries of output, converted by one task of the thread pool.
+const size_t MATRIX_TEXT_CHUNK = 1 << 18;
+
+/**
+ * @brief Whether c is space, tab, carriage return or newline.
+ *
+ */
+inline bool matrix_text_space(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; }
+
+/**
+ * @brief strtod() on the number in [first, last), which must be all of it. Overflow is
+ * an error; underflow gives the nearest double.
+ *
+ * @return bool  false if the text is not a number or is too large (out is then unchanged)
+ */
+bool matrix_text_strtod(const char* first, const char* last, double& out)
+{
+    char buffer[64];
+    string long_text;
+    const char* text = buffer;
+    size_t length = last - first;
+    if (length < sizeof(buffer))
+    {
+        memcpy(buffer, first, length);
+        buffer[length] = '\0';
+    } else
+    {
+        long_text.assign(first, length);
+        text = long_text.c_str();
+    }
+    char* end;
+    errno = 0;
+    double value = strtod(text, &end);
+    if (end != text + length || (errno == ERANGE && fabs(value) == HUGE_VAL)) return false; // underflow is fine
+    out = value;
+    return true;
+}
+
+/**
+ * @brief Reads the double in [first, last), which may be surrounded by white space and
+ * start with '+'. Anything else in the range makes it invalid.
+ *
+ * @return bool  false if the text is not a number or is too large (out is then unchanged)
+ */
+bool matrix_text_parse_double(const char* first, const char* last, double& out)
+{
+    while (first < last && matrix_text_space(*first)) ++first;
+    while (last > first && matrix_text_space(last[-1])) --last;
+    if (first < last && *first == '+' && last - first > 1 && first[1] != '-') ++first; // from_chars takes no '+'
+    if (first == last) return false;
+#ifdef __cpp_lib_to_chars
+    double value;
+    from_chars_result result = from_chars(first, last, value);
+    if (result.ptr != last) return false;
+    if (result.ec == errc::result_out_of_range) return matrix_text_strtod(first, last, out); // tells underflow from overflow
+    if (result.ec != errc()) return false;
+    out = value;
+    return true;
+#else
+    return matrix_text_strtod(first, last, out);
+#endif
+}
+
+/**
+ * @brief Writes value at out in the shortest form that reads back as the same double
+ * ("0.1", "1e-07", "-2.5"), with no terminator.
+ *
+ * @param out char*  Room for MATRIX_TEXT_NUMBER_LENGTH characters
+ * @return char*  The end of the text written
+ */
+char* matrix_text_format_double(char* out, double value)
+{
+#ifdef __cpp_lib_to_chars
+    return to_chars(out, out + MATRIX_TEXT_NUMBER_LENGTH, value).ptr;
+#else
+    char buffer[32];
+    int length = 0;
+    for (int digits = 15; digits <= 17; ++digits) // the fewest digits that round trip
+    {
+        length = snprintf(buffer, sizeof(buffer), "%.*g", digits, value);
+        if (strtod(buffer, nullptr) == value || value != value) break;
+    }
+    memcpy(out, buffer, length);
+    return out + length;
+#endif
+}
+
+/**
+ * @brief Reads the tokens in [first, last), which must end just after a ',' or at the
+ * end of the text, appending the numbers to entries and, for every newline, the number
+ * of entries read so far (in this range) to row_ends.
+ *
+ * @return bool  false if a token is not a number
+ */
+bool matrix_text_parse_tokens(const char* first, const char* last, vector<double>& entries, vector<size_t>& row_ends)
+{
+    for (const char* token = first; token < last; )
+    {
+        const char* delimiter = (const char*)memchr(token, ',', last - token);
+        if (!delimiter) delimiter = last;
+        const char* number = token;
+        while (number < delimiter && matrix_text_space(*number))
+        {
+            if (*number == '\n') row_ends.push_back(entries.size());
+            ++number;
+        }
+        if (number < delimiter)
+        {
+            double entry;
+            if (!matrix_text_parse_double(number, delimiter, entry)) return false;
+            entries.push_back(entry);
+            const char* newline = number;
+            while ((newline = (const char*)memchr(newline, '\n', delimiter - newline))) { row_ends.push_back(entries.size()); ++newline; }
+        }
+        token = delimiter + 1;
+    }
+    return true;
+}
+
+/**
+ * @brief Reads a matrix in the text format. Every newline ends a row, empty tokens are
+ * skipped, and each other token must be a number.
+ *
+ * @param text const char*
+ * @param length size_t
+ * @param entries vector<double>&  Filled row-major
+ * @return int  The number of rows, or -1 if a token is not a number or the matrix is
+ * not square (every row must have as many entries as there are rows)
+ */
+int matrix_text_parse(const char* text, size_t length, vector<double>& entries)
+{
+    entries.clear();
+    vector<size_t> row_ends; // entries before each newline
+    const char* end = text + length;
+    int pieces = (int)(length / MATRIX_TEXT_CHUNK);
+    if (pieces <= 1)
+    {
+        if (!matrix_text_parse_tokens(text, end, entries, row_ends)) return -1;
+    } else
+    {
+        vector<const char*> starts(pieces + 1, end); // piece p is [starts[p], starts[p + 1])
+        starts[0] = text;
+        for (int p = 1; p < pieces; ++p)
+        {
+            const char* guess = max(starts[p - 1], text + (size_t)p * MATRIX_TEXT_CHUNK);
+            const char* delimiter = (const char*)memchr(guess, ',', end - guess);
+            starts[p] = delimiter ? delimiter + 1 : end;
+        }
+        vector<vector<double>> parsed(pieces);
+        vector<vector<size_t>> piece_row_ends(pieces);
+        vector<char> valid(pieces, 1);
+        parallel_for(0, pieces, 1, [&](int first, int last)
+        {
+            for (int p = first; p < last; ++p) valid[p] = matrix_text_parse_tokens(starts[p], starts[p + 1], parsed[p], piece_row_ends[p]);
+        });
+        size_t count = 0;
+        size_t rows = 0;
+        for (int p = 0; p < pieces; ++p)
+        {
+            if (!valid[p]) return -1;
+            count += parsed[p].size();
+            rows += piece_row_ends[p].size();
+        }
+        entries.reserve(count);
+        row_ends.reserve(rows);
+        for (int p = 0; p < pieces; ++p)
+        {
+            for (size_t row_end : piece_row_ends[p]) row_ends.push_back(entries.size() + row_end);
+            entries.insert(entries.end(), parsed[p].begin(), parsed[p].end());
+        }
+    }
+    size_t rows = row_ends.size();
+    if (rows * rows != entries.size()) return -1;
+    for (size_t i = 0; i < rows; ++i)
+    {
+        if (row_ends[i] != (i + 1) * rows) return -1; // a short or long row
+    }
+    return (int)rows;
+}
+
+/**
+ * @brief Writes the n x n row-major matrix a in the text format into out, replacing
+ * its contents.
+ *
+ */
+void matrix_text_format(const double* a, int n, string& out)
+{
+    size_t row_space = (size_t)n * (MATRIX_TEXT_NUMBER_LENGTH + 1) + 2; // the longest a row can be
+    out.resize(row_space * n);
+    vector<size_t> row_length(n);
+    // Each row is written at the start of its own slot, then the slots are packed.
+    parallel_for(0, n, (int)max<size_t>(1, MATRIX_TEXT_CHUNK / max(n, 1)), [&](int first, int last)
+    {
+        for (int i = first; i < last; ++i)
+        {
+            char* start = &out[0] + row_space * i;
+            char* cursor = start;
+            for (int j = 0; j < n; ++j)
+            {
+                cursor = matrix_text_format_double(cursor, a[(size_t)i * n + j]);
+                *cursor++ = ',';
+            }
+            *cursor++ = '\n';
+            *cursor++ = ',';
+            row_length[i] = cursor - start;
+        }
+    });
+    size_t length = 0;
+    for (int i = 0; i < n; ++i)
+    {
+        memmove(&out[0] + length, out.data() + row_space * i, row_length[i]);
+        length += row_length[i];
+    }
+    out.resize(length);
+}
+
+#endif
@@ -0,0 +1,369 @@
+/*
+Optional instrumentation of the hot paths of all three engines.
+
+Build with -DMATRIX_INVERSE_PROFILE to enable it; without that flag every macro below
+expands to nothing and the engines compile exactly as before.
+
+    PROFILE_SCOPE("name");          // times the rest of the enclosing block
+    PROFILE_COUNT("name", amount);  // adds to a counter, e.g. nodes visited
+
+Each PROFILE_SCOPE site keeps, over all threads: the number of calls, the time spent
+(counted only at the outermost level of a recursion, so recursive functions are not
+counted twice), the longest call, the deepest recursion, and the heap allocations and
+bytes made during the outermost calls. Allocations are counted by replacing the
+global operator new. A program that counts allocations without the flag (as
+benchmark_suite.cpp does) defines PROFILE_COUNT_ALLOCATIONS to get the same replacement,
+and sets profile_allocation_hook to be called with the size of each one.
+
+With tracing on (profile_trace(true)), every call is also logged, up to
+PROFILE_TRACE_LIMIT calls.
+
+The report is JSON, from profile_report_json() or the exported
+matrix_inverse_profile_json() in the WASM builds, which return {"enabled":false} when
+built without the flag. Native programs can also set
+MATRIX_INVERSE_PROFILE_OUTPUT=path to have the report written at exit.
+
+Author: Evan Lauer
+*/
+
+#ifndef PROFILING_H
+#define PROFILING_H
+
+#include <string>
+
+using namespace std;
+
+#ifdef MATRIX_INVERSE_PROFILE
+
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+// Most calls kept by the per-call trace; later calls are only aggregated.
+const size_t PROFILE_TRACE_LIMIT = 1 << 16;
+
+/**
+ * @brief Aggregated statistics of one instrumented site.
+ *
+ */
+class ProfileSite
+{
+    public:
+    const char* name;
+    bool counter; // PROFILE_COUNT rather than PROFILE_SCOPE
+    atomic<long long> calls;
+    atomic<long long> total_ns;
+    atomic<long long> max_ns;
+    atomic<long long> allocations;
+    atomic<long long> allocated_bytes;
+    atomic<int> max_depth;
+};
+
+/**
+ * @brief One call, for the per-call trace.
+ *
+ */
+class ProfileEvent
+{
+    public:
+    const char* name;
+    long long start_ns;
+    long long duration_ns;
+    int depth;
+};
+
+class ProfileRegistry
+{
+    public:
+    mutex lock;
+    vector<ProfileSite*> sites;
+    vector<ProfileEvent> events;
+    atomic<bool> tracing;
+    chrono::steady_clock::time_point epoch;
+
+    ProfileRegistry()
+    {
+        tracing = false;
+        epoch = chrono::steady_clock::now();
+    }
+};
+
+ProfileRegistry& profile_registry()
+{
+    static ProfileRegistry* registry = new ProfileRegistry(); // never destroyed, so usable at exit
+    return *registry;
+}
+
+// Heap allocations made by this thread so far.
+thread_local long long profile_thread_allocations = 0;
+thread_local long long profile_thread_allocated_bytes = 0;
+
+void profile_note_allocation(size_t size)
+{
+    profile_thread_allocations++;
+    profile_thread_allocated_bytes += (long long)size;
+}
+
+ProfileSite* profile_site(const char* name, bool counter)
+{
+    ProfileSite* site = new ProfileSite();
+    site->name = name;
+    site->counter = counter;
+    site->calls = 0;
+    site->total_ns = 0;
+    site->max_ns = 0;
+    site->allocations = 0;
+    site->allocated_bytes = 0;
+    site->max_depth = 0;
+    ProfileRegistry& registry = profile_registry();
+    lock_guard<mutex> guard(registry.lock);
+    registry.sites.push_back(site);
+    return site;
+}
+
+long long profile_now_ns()
+{
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - profile_registry().epoch).count();
+}
+
+template <class T>
+void profile_atomic_max(atomic<T>& target, T value)
+{
+    T current = target.load(memory_order_relaxed);
+    while (value > current && !target.compare_exchange_weak(current, value, memory_order_relaxed)) {}
+}
+
+/**
+ * @brief Times one call of a site. `depth` is the site's recursion depth on this thread.
+ *
+ */
+class ProfileScope
+{
+    public:
+    ProfileSite* site;
+    int* depth;
+    long long start;
+    long long allocations;
+    long long allocated_bytes;
+
+    ProfileScope(ProfileSite* _site, int* _depth)
+    {
+        site = _site;
+        depth = _depth;
+        ++*depth;
+        profile_atomic_max(site->max_depth, *depth);
+        allocations = profile_thread_allocations;
+        allocated_bytes = profile_thread_allocated_bytes;
+        start = profile_now_ns();
+    }
+
+    ~ProfileScope()
+    {
+        long long duration = profile_now_ns() - start;
+        site->calls.fetch_add(1, memory_order_relaxed);
+        if (*depth == 1) // inner calls of a recursion are already inside this time
+        {
+            site->total_ns.fetch_add(duration, memory_order_relaxed);
+            site->allocations.fetch_add(profile_thread_allocations - allocations, memory_order_relaxed);
+            site->allocated_bytes.fetch_add(profile_thread_allocated_bytes - allocated_bytes, memory_order_relaxed);
+        }
+        profile_atomic_max(site->max_ns, duration);
+        ProfileRegistry& registry = profile_registry();
+        if (registry.tracing.load(memory_order_relaxed))
+        {
+            lock_guard<mutex> guard(registry.lock);
+            if (registry.events.size() < PROFILE_TRACE_LIMIT)
+            {
+                ProfileEvent event;
+                event.name = site->name;
+                event.start_ns = start;
+                event.duration_ns = duration;
+                event.depth = *depth;
+                registry.events.push_back(event);
+            }
+        }
+        --*depth;
+    }
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(name) \
+    static ProfileSite* PROFILE_CONCAT(profile_site_, __LINE__) = profile_site(name, false); \
+    static thread_local int PROFILE_CONCAT(profile_depth_, __LINE__) = 0; \
+    ProfileScope PROFILE_CONCAT(profile_scope_, __LINE__)(PROFILE_CONCAT(profile_site_, __LINE__), &PROFILE_CONCAT(profile_depth_, __LINE__))
+#define PROFILE_COUNT(name, amount) \
+    do { static ProfileSite* profile_counter = profile_site(name, true); profile_counter->calls.fetch_add((long long)(amount), memory_order_relaxed); } while (0)
+
+/**
+ * @brief Turns the per-call trace on or off.
+ *
+ */
+void profile_trace(bool enabled) { profile_registry().tracing = enabled; }
+
+/**
+ * @brief Zeroes every statistic and drops the trace.
+ *
+ */
+void profile_reset()
+{
+    ProfileRegistry& registry = profile_registry();
+    lock_guard<mutex> guard(registry.lock);
+    for (ProfileSite* site : registry.sites)
+    {
+        site->calls = 0;
+        site->total_ns = 0;
+        site->max_ns = 0;
+        site->allocations = 0;
+        site->allocated_bytes = 0;
+        site->max_depth = 0;
+    }
+    registry.events.clear();
+}
+
+/**
+ * @brief The statistics as JSON: {"enabled":true,"sites":[...],"trace":[...]}. Times are
+ * in microseconds. Counters only report "count".
+ *
+ */
+string profile_report_json()
+{
+    ProfileRegistry& registry = profile_registry();
+    lock_guard<mutex> guard(registry.lock);
+    string json = "{\"enabled\":true,\"sites\":[";
+    char buffer[512];
+    for (size_t i = 0; i < registry.sites.size(); ++i)
+    {
+        ProfileSite* site = registry.sites[i];
+        if (i) json += ",";
+        if (site->counter)
+        {
+            snprintf(buffer, sizeof(buffer), "{\"name\":\"%s\",\"count\":%lld}", site->name, site->calls.load());
+        } else
+        {
+            long long calls = site->calls.load();
+            snprintf(buffer, sizeof(buffer),
+                     "{\"name\":\"%s\",\"calls\":%lld,\"total_us\":%.3f,\"max_us\":%.3f,\"max_depth\":%d,\"allocations\":%lld,\"allocated_bytes\":%lld}",
+                     site->name, calls, site->total_ns.load() * 1e-3, site->max_ns.load() * 1e-3, site->max_depth.load(),
+                     site->allocations.load(), site->allocated_bytes.load());
+        }
+        json += buffer;
+    }
+    json += "],\"trace\":[";
+    for (size_t i = 0; i < registry.events.size(); ++i)
+    {
+        const ProfileEvent& event = registry.events[i];
+        snprintf(buffer, sizeof(buffer), "%s{\"name\":\"%s\",\"start_us\":%.3f,\"duration_us\":%.3f,\"depth\":%d}", i ? "," : "",
+                 event.name, event.start_ns * 1e-3, event.duration_ns * 1e-3, event.depth);
+        json += buffer;
+    }
+    json += "]}";
+    return json;
+}
+
+/**
+ * @brief Writes profile_report_json() to MATRIX_INVERSE_PROFILE_OUTPUT, if set.
+ *
+ */
+void profile_write_at_exit()
+{
+    const char* path = getenv("MATRIX_INVERSE_PROFILE_OUTPUT");
+    if (!path || !*path) return;
+    FILE* file = fopen(path, "w");
+    if (!file) return;
+    string json = profile_report_json();
+    fwrite(json.data(), 1, json.size(), file);
+    fclose(file);
+}
+
+// Registers profile_write_at_exit() before main() runs.
+const int profile_at_exit_registered = atexit(profile_write_at_exit);
+
+#else
+
+#define PROFILE_SCOPE(name) do {} while (0)
+#define PROFILE_COUNT(name, amount) do {} while (0)
+
+void profile_trace(bool) {}
+void profile_reset() {}
+string profile_report_json() { return "{\"enabled\":false}"; }
+
+#endif
+
+#if defined(MATRIX_INVERSE_PROFILE) || defined(PROFILE_COUNT_ALLOCATIONS)
+
+#include <cstdlib>
+#include <new>
+
+// If set, called with the size of every heap allocation in the process.
+void (*profile_allocation_hook)(size_t size) = nullptr;
+
+/**
+ * @brief Counts one heap allocation of size bytes.
+ *
+ */
+inline void profile_allocation(size_t size)
+{
+#ifdef MATRIX_INVERSE_PROFILE
+    profile_note_allocation(size);
+#endif
+    if (profile_allocation_hook) profile_allocation_hook(size);
+}
+
+// The replacements are kept out of line: once inlined, GCC sees free() on memory from
+// operator new and warns with -Wmismatched-new-delete, though both sides are these
+// malloc/free pairs.
+__attribute__((noinline)) void* operator new(size_t size)
+{
+    profile_allocation(size);
+    void* memory = malloc(size ? size : 1);
+    if (!memory) throw bad_alloc();
+    return memory;
+}
+
+__attribute__((noinline)) void* operator new(size_t size, align_val_t alignment)
+{
+    profile_allocation(size);
+    size_t align = (size_t)alignment < sizeof(void*) ? sizeof(void*) : (size_t)alignment; // posix_memalign needs at least this
+    void* memory = nullptr;
+    if (posix_memalign(&memory, align, size ? size : 1) != 0) throw bad_alloc();
+    return memory;
+}
+
+__attribute__((noinline)) void operator delete(void* memory) noexcept { free(memory); }
+__attribute__((noinline)) void operator delete(void* memory, align_val_t) noexcept { free(memory); }
+void* operator new[](size_t size) { return operator new(size); }
+void* operator new[](size_t size, align_val_t alignment) { return operator new(size, alignment); }
+void operator delete[](void* memory) noexcept { operator delete(memory); }
+void operator delete(void* memory, size_t) noexcept { operator delete(memory); }
+void operator delete[](void* memory, size_t) noexcept { operator delete(memory); }
+void operator delete[](void* memory, align_val_t alignment) noexcept { operator delete(memory, alignment); }
+void operator delete(void* memory, size_t, align_val_t alignment) noexcept { operator delete(memory, alignment); }
+void operator delete[](void* memory, size_t, align_val_t alignment) noexcept { operator delete(memory, alignment); }
+
+#endif
+
+extern "C"
+{
+    /**
+     * @brief profile_report_json() for Javascript. The returned pointer stays valid
+     * until the next call on the same thread.
+     *
+     */
+    const char* matrix_inverse_profile_json()
+    {
+        thread_local string json;
+        json = profile_report_json();
+        return json.c_str();
+    }
+
+    void matrix_inverse_profile_reset() { profile_reset(); }
+
+    void matrix_inverse_profile_trace(int enabled) { profile_trace(enabled != 0); }
+}
+
+#endif
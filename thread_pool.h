@@ -0,0 +1,342 @@
+/*
+A small work-stealing thread pool shared by inverse_real_valued.cpp and
+inverse_closed_form.cpp.
+
+Every worker owns a deque of tasks. A worker pushes and pops tasks at the back of its
+own deque and, when that runs dry, steals from the front of another worker's deque,
+so large jobs spread out while each thread keeps working on what it just produced.
+Tasks belong to a TaskGroup; waiting on a group runs pending tasks instead of
+blocking, so tasks may themselves fan out and wait without deadlocking the pool.
+
+The pool size defaults to the MATRIX_INVERSE_THREADS environment variable, or the
+number of hardware threads, and can be changed with set_thread_count(). The calling
+thread always takes part, so a pool of size N starts N - 1 workers. Builds without
+thread support (plain Emscripten) run every task inline.
+
+Author: Evan Lauer
+*/
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <vector>
+#include <deque>
+#include <functional>
+#include <atomic>
+#include <algorithm>
+#include <cstdlib>
+#include <exception>
+#include <mutex>
+
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+#define THREAD_POOL_SINGLE_THREADED 1
+#else
+#include <thread>
+#include <condition_variable>
+#endif
+
+using namespace std;
+
+/**
+ * @brief Counts the unfinished tasks submitted under it, and keeps the first exception
+ * one of them threw.
+ *
+ */
+class TaskGroup
+{
+    public:
+    atomic<int> pending;
+    atomic<bool> failed;
+    exception_ptr error; // set once, by the task that set failed
+
+    TaskGroup() : pending(0), failed(false) {}
+};
+
+#ifdef THREAD_POOL_SINGLE_THREADED
+
+class ThreadPool
+{
+    public:
+    ThreadPool(int) {}
+
+    int size() { return 1; }
+
+    void submit(TaskGroup*, function<void()> task) { task(); }
+
+    void wait(TaskGroup*) {}
+};
+
+#else
+
+class ThreadPool
+{
+    public:
+    /**
+     * @brief Starts thread_count - 1 workers; the thread that waits is the last one.
+     *
+     * @param thread_count int
+     */
+    ThreadPool(int thread_count)
+    {
+        thread_count = max(1, thread_count);
+        queues = vector<WorkQueue>(thread_count);
+        stopping = false;
+        for (int i = 1; i < thread_count; ++i) workers.emplace_back(&ThreadPool::worker_loop, this, i);
+    }
+
+    ~ThreadPool()
+    {
+        {
+            lock_guard<mutex> lock(sleep_mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (thread& worker : workers) worker.join();
+    }
+
+    int size() { return (int)queues.size(); }
+
+    /**
+     * @brief Queues a task under the given group. Tasks submitted from a worker go to
+     * that worker's own deque; tasks from any other thread go to deque 0.
+     *
+     * @param group TaskGroup*
+     * @param task function<void()>
+     */
+    void submit(TaskGroup* group, function<void()> task)
+    {
+        group->pending++;
+        if (queues.size() == 1)
+        {
+            run(Task{ group, move(task) });
+            return;
+        }
+        int index = current_worker_index(this);
+        WorkQueue& queue = queues[index < 0 ? 0 : index];
+        {
+            lock_guard<mutex> lock(queue.lock);
+            queue.tasks.push_back(Task{ group, move(task) });
+        }
+        {
+            lock_guard<mutex> lock(sleep_mutex); // pairs with the predicate check in worker_loop
+        }
+        wake.notify_one();
+    }
+
+    /**
+     * @brief Returns once every task in the group has finished, running queued tasks
+     * (from any group) in the meantime. If a task of the group threw, its exception is
+     * rethrown here, after the others have finished.
+     *
+     * @param group TaskGroup*
+     */
+    void wait(TaskGroup* group)
+    {
+        int index = max(0, current_worker_index(this));
+        while (group->pending.load() > 0)
+        {
+            Task task;
+            if (find_task(index, task)) run(move(task));
+            else this_thread::yield();
+        }
+        if (group->error) rethrow_exception(group->error);
+    }
+
+    private:
+    class Task
+    {
+        public:
+        TaskGroup* group;
+        function<void()> work;
+    };
+
+    class WorkQueue
+    {
+        public:
+        mutex lock;
+        deque<Task> tasks;
+    };
+
+    vector<WorkQueue> queues;
+    vector<thread> workers;
+    mutex sleep_mutex;
+    condition_variable wake;
+    bool stopping;
+
+    /**
+     * @brief Index of the calling thread's deque in the given pool, or -1 for threads
+     * that are not workers of that pool.
+     *
+     */
+    static int& current_worker_index(ThreadPool* pool)
+    {
+        thread_local ThreadPool* owner = nullptr;
+        thread_local int index = -1;
+        if (owner != pool) { owner = pool; index = -1; }
+        return index;
+    }
+
+    /**
+     * @brief Runs the task and marks it finished in its group, even if it throws; the
+     * exception is kept for wait() rather than escaping a worker or leaving the group
+     * pending forever.
+     *
+     */
+    void run(Task task)
+    {
+        try
+        {
+            task.work();
+        } catch (...)
+        {
+            if (!task.group->failed.exchange(true)) task.group->error = current_exception();
+        }
+        task.group->pending--;
+    }
+
+    bool any_queued()
+    {
+        for (WorkQueue& queue : queues)
+        {
+            lock_guard<mutex> lock(queue.lock);
+            if (!queue.tasks.empty()) return true;
+        }
+        return false;
+    }
+
+    /**
+     * @brief Pops from the back of deque `index`, or steals from the front of another.
+     *
+     */
+    bool find_task(int index, Task& task)
+    {
+        {
+            WorkQueue& own = queues[index];
+            lock_guard<mutex> lock(own.lock);
+            if (!own.tasks.empty())
+            {
+                task = move(own.tasks.back());
+                own.tasks.pop_back();
+                return true;
+            }
+        }
+        for (int offset = 1; offset < (int)queues.size(); ++offset)
+        {
+            WorkQueue& victim = queues[(index + offset) % queues.size()];
+            lock_guard<mutex> lock(victim.lock);
+            if (!victim.tasks.empty())
+            {
+                task = move(victim.tasks.front());
+                victim.tasks.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void worker_loop(int index)
+    {
+        current_worker_index(this) = index;
+        while (true)
+        {
+            Task task;
+            if (find_task(index, task))
+            {
+                run(move(task));
+                continue;
+            }
+            unique_lock<mutex> lock(sleep_mutex);
+            if (stopping) return;
+            if (any_queued()) continue;
+            wake.wait(lock);
+            if (stopping) return;
+        }
+    }
+};
+
+#endif
+
+/**
+ * @brief Thread count used when the shared pool is first created.
+ *
+ * @return int
+ */
+int default_thread_count()
+{
+    const char* configured = getenv("MATRIX_INVERSE_THREADS");
+    if (configured && atoi(configured) > 0) return atoi(configured);
+#ifdef THREAD_POOL_SINGLE_THREADED
+    return 1;
+#else
+    return max(1, (int)thread::hardware_concurrency());
+#endif
+}
+
+ThreadPool*& shared_thread_pool_slot()
+{
+    static ThreadPool* pool = nullptr;
+    return pool;
+}
+
+/**
+ * @brief The pool used by the inverse engines, created on first use. Threads that call
+ * this at the same time get the same pool.
+ *
+ * @return ThreadPool&
+ */
+ThreadPool& shared_thread_pool()
+{
+    static once_flag created;
+    ThreadPool*& pool = shared_thread_pool_slot();
+    call_once(created, [&pool]() { if (!pool) pool = new ThreadPool(default_thread_count()); }); // set_thread_count() may have made it
+    return *pool;
+}
+
+/**
+ * @brief Replaces the shared pool with one of the given size. Must not be called while
+ * the pool is running tasks.
+ *
+ * @param thread_count int
+ */
+void set_thread_count(int thread_count)
+{
+    ThreadPool*& pool = shared_thread_pool_slot();
+    delete pool;
+    pool = new ThreadPool(max(1, thread_count));
+}
+
+extern "C"
+{
+    // Exported so the web page can size the pool (pthread builds only).
+    void matrix_inverse_set_thread_count(int thread_count) { set_thread_count(thread_count); }
+}
+
+/**
+ * @brief Runs body(chunk_begin, chunk_end) over [begin, end) split into chunks of at
+ * most `grain` indices, as tasks on the shared pool, and waits for all of them.
+ *
+ * @param begin int
+ * @param end int
+ * @param grain int  Largest chunk handed to one task
+ * @param body function<void(int, int)>
+ */
+void parallel_for(int begin, int end, int grain, const function<void(int, int)>& body)
+{
+    if (end <= begin) return;
+    grain = max(1, grain);
+    ThreadPool& pool = shared_thread_pool();
+    if (pool.size() == 1 || end - begin <= grain)
+    {
+        body(begin, end);
+        return;
+    }
+    TaskGroup group;
+    for (int chunk = begin; chunk < end; chunk += grain)
+    {
+        int chunk_end = min(end, chunk + grain);
+        pool.submit(&group, [&body, chunk, chunk_end]() { body(chunk, chunk_end); });
+    }
+    pool.wait(&group);
+}
+
+#endif